@@ -1,6 +1,7 @@
 #include "audiostream.h"
 #include "cfg/option.h"
 #include "emulator.h"
+#include <mutex>
 
 static void registerForEvents();
 
@@ -10,6 +11,8 @@ static SoundFrame Buffer[SAMPLE_COUNT];
 static u32 writePtr;  // next sample index
 
 static AudioBackend *currentBackend;
+// Samples may be generated on the aica sound thread
+static std::mutex backendMutex;
 std::vector<AudioBackend *> *AudioBackend::backends;
 
 static bool audio_recording_started;
@@ -55,6 +58,7 @@ void WriteSample(s16 r, s16 l)
 
 	if (++writePtr == SAMPLE_COUNT)
 	{
+		std::lock_guard<std::mutex> _(backendMutex);
 		if (currentBackend != nullptr)
 			currentBackend->push(Buffer, SAMPLE_COUNT, config::LimitFPS);
 		writePtr = 0;
@@ -66,6 +70,7 @@ void InitAudio()
 	registerForEvents();
 	TermAudio();
 
+	std::lock_guard<std::mutex> _(backendMutex);
 	std::string slug = config::AudioBackend;
 	currentBackend = AudioBackend::getBackend(slug);
 	if (currentBackend == nullptr && slug != "auto")
@@ -106,6 +111,7 @@ void InitAudio()
 
 void TermAudio()
 {
+	std::lock_guard<std::mutex> _(backendMutex);
 	if (currentBackend == nullptr)
 		return;
 
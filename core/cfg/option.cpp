@@ -25,6 +25,9 @@ namespace config {
 // Dynarec
 
 Option<bool> DynarecEnabled("Dynarec.Enabled", true);
+Option<bool> DynarecPersistentCache("Dynarec.PersistentCache", false);
+Option<bool> DynarecBackgroundDecoding("Dynarec.BackgroundDecoding", false);
+Option<bool> DynarecBlockProfiler("Dynarec.BlockProfiler", false);
 Option<int> Sh4Clock("Sh4Clock", 200);
 
 // General
@@ -45,6 +48,7 @@ Option<int, false> UITheme("UITheme", 0);
 // Sound
 
 Option<bool> DSPEnabled("aica.DSPEnabled", false);
+Option<bool> ThreadedAudio("aica.ThreadedAudio");
 #if HOST_CPU == CPU_ARM
 Option<int> AudioBufferSize("aica.BufferSize", 5644);	// 128 ms
 #else
@@ -79,6 +83,11 @@ Option<bool> CustomTextures("rend.CustomTextures");
 Option<bool> PreloadCustomTextures("rend.PreloadCustomTextures");
 Option<bool> DumpTextures("rend.DumpTextures");
 Option<bool> DumpReplacedTextures("rend.DumpReplacedTextures");
+Option<bool> DumpDisplayLists("rend.DumpDisplayLists");
+Option<bool> AsyncTextureDecode("rend.AsyncTextureDecode");
+Option<int> DecodedTextureCacheSize("rend.DecodedTextureCacheSize");
+Option<bool> UpscaledTextureDiskCache("rend.UpscaledTextureDiskCache");
+Option<int> TextureDiskCachePreloadSize("rend.TextureDiskCachePreloadSize", 256);
 Option<int> ScreenStretching("rend.ScreenStretching", 100);
 Option<bool> Fog("rend.Fog", true);
 Option<bool> FloatVMUs("rend.FloatVMUs");
@@ -133,6 +142,7 @@ Option<int> GDBPort("Debug.GDBPort", debugger::DEFAULT_PORT);
 Option<bool> GDBWaitForConnection("Debug.GDBWaitForConnection");
 Option<bool> UseReios("UseReios");
 Option<bool> FastGDRomLoad("FastGDRomLoad", false);
+Option<int> CHDCacheSize("CHDCacheSize", 16);
 Option<bool> RamMod32MB("Dreamcast.RamMod32MB", false);
 
 Option<bool> OpenGlChecks("OpenGlChecks", false, "validate");
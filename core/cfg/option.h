@@ -350,6 +350,9 @@ using OptionString = Option<std::string>;
 // Dynarec
 
 extern Option<bool> DynarecEnabled;
+extern Option<bool> DynarecPersistentCache;
+extern Option<bool> DynarecBackgroundDecoding;
+extern Option<bool> DynarecBlockProfiler;
 #ifndef LIBRETRO
 extern Option<int> Sh4Clock;
 #endif
@@ -373,6 +376,7 @@ extern Option<int, false> UITheme;          // 0 -> Dark, 1 -> Light, 2 -> Dream
 
 constexpr bool LimitFPS = true;
 extern Option<bool> DSPEnabled;
+extern Option<bool> ThreadedAudio;
 extern Option<int> AudioBufferSize;	//In samples ,*4 for bytes
 extern Option<bool> AutoLatency;
 
@@ -449,6 +453,11 @@ extern Option<bool> CustomTextures;
 extern Option<bool> PreloadCustomTextures;
 extern Option<bool> DumpTextures;
 extern Option<bool> DumpReplacedTextures;
+extern Option<bool> DumpDisplayLists;
+extern Option<bool> AsyncTextureDecode;
+extern Option<int> DecodedTextureCacheSize;	// in MB, 0 to disable
+extern Option<bool> UpscaledTextureDiskCache;
+extern Option<int> TextureDiskCachePreloadSize;	// in MB
 extern Option<int> ScreenStretching;	// in percent. 150 means stretch from 4/3 to 6/3
 extern Option<bool> Fog;
 extern Option<bool> FloatVMUs;
@@ -489,6 +498,7 @@ extern Option<int> GDBPort;
 extern Option<bool> GDBWaitForConnection;
 extern Option<bool> UseReios;
 extern Option<bool> FastGDRomLoad;
+extern Option<int> CHDCacheSize;	// in MB, 0 disables read-ahead
 extern Option<bool> RamMod32MB;
 
 extern Option<bool> OpenGlChecks;
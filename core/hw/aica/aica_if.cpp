@@ -513,6 +513,7 @@ void sbTerm()
 
 void serialize(Serializer& ser)
 {
+	sgc::sync();
 	ser << arm::aica_interr;
 	ser << arm::aica_reg_L;
 	ser << arm::e68k_out;
@@ -548,6 +549,7 @@ void serialize(Serializer& ser)
 
 void deserialize(Deserializer& deser)
 {
+	sgc::sync();
 	deser >> arm::aica_interr;
 	deser >> arm::aica_reg_L;
 	deser >> arm::e68k_out;
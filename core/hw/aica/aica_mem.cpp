@@ -39,7 +39,12 @@ T readRegInternal(u32 addr)
 	{
 		sgc::ReadCommonReg(addr, sizeof(T) == 1);
 	}
-	else if (addr >= 0x4000 && addr < 0x4580)
+	else if (addr >= 0x3000)
+	{
+		// DSP registers are written by the sound thread
+		sgc::sync();
+	}
+	if (addr >= 0x4000 && addr < 0x4580)
 	{
 		if (addr & 2)
 		{
@@ -84,19 +89,84 @@ template u32 readRegInternal<u32>(u32 addr);
 static void writeCommonReg8(u32 reg, u8 data)
 {
 	WriteMemArr(aica_reg, reg, data);
-	if (reg == 0x2804 || reg == 0x2805)
-	{
-		using namespace dsp;
-		state.RBL = (8192 << CommonData->RBL) - 1;
-		state.RBP = (CommonData->RBP * 2048) & ARAM_MASK;
-		state.dirty = true;
-	}
+	if (reg < 0x2808)	// MVOL, DAC18B, Mono, RBL, RBP
+		sgc::WriteCommonReg(reg, 1);
 	else if (reg == 0x280c) {	// MOBUF
 		if (midiReceiver != nullptr)
 			midiReceiver(data);
 	}
 }
 
+template<typename T>
+void writeDspReg(u32 addr, T data)
+{
+	constexpr size_t sz = sizeof(T);
+	if (addr >= 0x4000 && addr < 0x4580)
+	{
+		// DSP TEMP/MEMS
+		if (addr < 0x4500)
+		{
+			s32 &v = addr < 0x4400 ? dsp::state.TEMP[(addr - 0x4000) / 8] : dsp::state.MEMS[(addr - 0x4400) / 8];
+			if (addr & 4)
+			{
+				if constexpr (sz == 1)
+				{
+					if (addr & 1)
+						v = (v & 0x0000ffff) | (((s32)data << 24) >> 8);
+					else
+						v = (v & 0xffff00ff) | ((data & 0xff) << 8);
+				}
+				else
+				{
+					v = (v & 0xff) | (((s32)data << 16) >> 8);
+				}
+			}
+			else
+			{
+				if (sz != 1 || (addr & 1) == 0)
+					v = (v & ~0xff) | (data & 0xff);
+				// else ignored
+			}
+			DEBUG_LOG(AICA, "DSP TEMP/MEMS register write<%d> @ %x = %d", (int)sz, addr, v);
+		}
+		// DSP MIXS
+		else
+		{
+			s32 &v = dsp::state.MIXS[(addr - 0x4500) / 8];
+			if (addr & 4)
+			{
+				if (sz == 1)
+				{
+					if (addr & 1)
+						v = (v & 0x00000fff) | (((s32)data << 24) >> 12);
+					else
+						v = (v & 0xfffff00f) | ((data & 0xff) << 4);
+				}
+				else
+				{
+					v = (v & 0xf) | (((s32)data << 16) >> 12);
+				}
+			}
+			else
+			{
+				if (sz != 1 || (addr & 1) == 0)
+					v = (v & ~0xf) | (data & 0xf);
+				// else ignored
+			}
+			DEBUG_LOG(AICA, "DSP MIXS register write<%d> @ %x = %d", (int)sz, addr, v);
+		}
+		return;
+	}
+
+	WriteMemArr(aica_reg, addr, data);
+	dsp::writeProg(addr);
+	if constexpr (sz == 2)
+		dsp::writeProg(addr + 1);
+}
+template void writeDspReg<>(u32 addr, u8 data);
+template void writeDspReg<>(u32 addr, u16 data);
+template void writeDspReg<>(u32 addr, u32 data);
+
 template<typename T>
 void writeRegInternal(u32 addr, T data)
 {
@@ -115,7 +185,9 @@ void writeRegInternal(u32 addr, T data)
 
 	if (addr < 0x2800)
 	{
+		//DSP output levels
 		WriteMemArr(aica_reg, addr, data);
+		sgc::WriteCommonReg(addr, sz);
 		return;
 	}
 
@@ -134,67 +206,7 @@ void writeRegInternal(u32 addr, T data)
 			INFO_LOG(AICA, "Unaligned DSP register write @ %x", addr);
 			return;
 		}
-		if (addr >= 0x4000 && addr < 0x4580)
-		{
-			// DSP TEMP/MEMS
-			if (addr < 0x4500)
-			{
-				s32 &v = addr < 0x4400 ? dsp::state.TEMP[(addr - 0x4000) / 8] : dsp::state.MEMS[(addr - 0x4400) / 8];
-				if (addr & 4)
-				{
-					if constexpr (sz == 1)
-					{
-						if (addr & 1)
-							v = (v & 0x0000ffff) | (((s32)data << 24) >> 8);
-						else
-							v = (v & 0xffff00ff) | ((data & 0xff) << 8);
-					}
-					else
-					{
-						v = (v & 0xff) | (((s32)data << 16) >> 8);
-					}
-				}
-				else
-				{
-					if (sz != 1 || (addr & 1) == 0)
-						v = (v & ~0xff) | (data & 0xff);
-					// else ignored
-				}
-				DEBUG_LOG(AICA, "DSP TEMP/MEMS register write<%d> @ %x = %d", (int)sz, addr, v);
-			}
-			// DSP MIXS
-			else
-			{
-				s32 &v = dsp::state.MIXS[(addr - 0x4500) / 8];
-				if (addr & 4)
-				{
-					if (sz == 1)
-					{
-						if (addr & 1)
-							v = (v & 0x00000fff) | (((s32)data << 24) >> 12);
-						else
-							v = (v & 0xfffff00f) | ((data & 0xff) << 4);
-					}
-					else
-					{
-						v = (v & 0xf) | (((s32)data << 16) >> 12);
-					}
-				}
-				else
-				{
-					if (sz != 1 || (addr & 1) == 0)
-						v = (v & ~0xf) | (data & 0xf);
-					// else ignored
-				}
-				DEBUG_LOG(AICA, "DSP MIXS register write<%d> @ %x = %d", (int)sz, addr, v);
-			}
-			return;
-		}
-
-		WriteMemArr(aica_reg, addr, data);
-		dsp::writeProg(addr);
-		if constexpr (sz == 2)
-			dsp::writeProg(addr + 1);
+		sgc::WriteDspReg(addr, sz, data);
 		return;
 	}
 	writeTimerAndIntReg(addr, data);
@@ -6,6 +6,8 @@ namespace aica
 
 template<typename T> T readRegInternal(u32 addr);
 template<typename T> void writeRegInternal(u32 addr, T data);
+// Write to a DSP register (0x3000 and above). Called by the sound thread in threaded mode.
+template<typename T> void writeDspReg(u32 addr, T data);
 
 void initMem();
 void termMem();
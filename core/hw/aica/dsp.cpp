@@ -20,6 +20,17 @@ namespace aica::dsp
 {
 
 DSPState state;
+ProgramInfo program;
+
+// The program and the COEF and MADRS values it was compiled with
+static u32 compiledMpro[128 * 4];
+static u32 compiledCoef[128];
+static u32 compiledMadrs[64];
+// COEF and MADRS registers are read from memory once they have been changed this many times
+// while the program was running
+constexpr u32 MAX_CONST_CHANGES = 2;
+static u8 coefChanges[128];
+static u8 madrsChanges[64];
 
 //float format is ?
 u16 DYNACALL PACK(s32 val)
@@ -106,9 +117,98 @@ void recompile() {
 }
 #endif
 
+void analyzeProgram()
+{
+	if (memcmp(compiledMpro, DSPData->MPRO, sizeof(compiledMpro)) != 0)
+	{
+		// New program: all registers are constant until proven otherwise
+		memcpy(compiledMpro, DSPData->MPRO, sizeof(compiledMpro));
+		memset(coefChanges, 0, sizeof(coefChanges));
+		memset(madrsChanges, 0, sizeof(madrsChanges));
+	}
+	else
+	{
+		for (int i = 0; i < 128; i++)
+			if (program.constCoef[i] && DSPData->COEF[i] != compiledCoef[i])
+				coefChanges[i]++;
+		for (int i = 0; i < 64; i++)
+			if (program.constMadrs[i] && DSPData->MADRS[i] != compiledMadrs[i])
+				madrsChanges[i]++;
+	}
+	memcpy(compiledCoef, DSPData->COEF, sizeof(compiledCoef));
+	memcpy(compiledMadrs, DSPData->MADRS, sizeof(compiledMadrs));
+
+	Instruction ops[128];
+	bool memvalUsed[4] {};
+	for (int step = 0; step < 128; step++)
+	{
+		DecodeInst(&DSPData->MPRO[step * 4], &ops[step]);
+		if (ops[step].IWT)
+			memvalUsed[step & 3] = true;
+	}
+	memset(program.constCoef, 0, sizeof(program.constCoef));
+	memset(program.constMadrs, 0, sizeof(program.constMadrs));
+	program.liveSteps = 0;
+
+	// Backward liveness analysis of the registers passed from one step to the next.
+	// ACC, FRC_REG, Y_REG and ADRS_REG are reset for each sample so nothing is live after the last step.
+	// MEMVAL is the exception and is assumed to be live if any step reads it.
+	bool accLive = false;
+	bool frcLive = false;
+	bool yregLive = false;
+	bool adrsLive = false;
+	for (int step = 127; step >= 0; step--)
+	{
+		const Instruction& op = ops[step];
+		StepInfo& info = program.steps[step];
+		const bool odd = step & 1;	// memory access only allowed on odd steps
+
+		info.acc = accLive;
+		info.frcl = op.FRCL && frcLive;
+		info.yrl = op.YRL && yregLive;
+		info.adrl = op.ADRL && adrsLive;
+		info.mrd = odd && op.MRD && memvalUsed[(step + 2) & 3];
+		info.mwt = odd && op.MWT;
+		info.shifter = op.TWT || op.EWT || info.mwt || info.frcl || (info.adrl && op.SHIFT == 3);
+		info.inputs = (info.acc && op.XSEL) || info.yrl || (info.adrl && op.SHIFT != 3);
+		info.live = info.acc || info.shifter || info.yrl || info.adrl || info.mrd || op.IWT;
+		if (!info.live)
+			continue;
+		program.liveSteps++;
+
+		// Registers written by this step. They are all read before being written.
+		if (op.FRCL)
+			frcLive = false;
+		if (op.YRL)
+			yregLive = false;
+		if (op.ADRL)
+			adrsLive = false;
+		// The shifter uses the ACC value of the previous step
+		accLive = info.shifter || (info.acc && !op.ZERO && op.BSEL);
+		if (info.acc)
+		{
+			if (op.YSEL == 0)
+				frcLive = true;
+			else if (op.YSEL == 1)
+				program.constCoef[step] = coefChanges[step] < MAX_CONST_CHANGES;
+			else
+				yregLive = true;
+		}
+		if (info.mrd || info.mwt)
+		{
+			if (op.ADREB)
+				adrsLive = true;
+			program.constMadrs[op.MASA] = madrsChanges[op.MASA] < MAX_CONST_CHANGES;
+		}
+	}
+	DEBUG_LOG(AICA, "DSP program: %d live steps", program.liveSteps);
+}
+
 void init()
 {
 	memset(&state, 0, sizeof(state));
+	memset(&program, 0, sizeof(program));
+	memset(compiledMpro, 0, sizeof(compiledMpro));
 	state.RBL = 0x8000 - 1;
 	state.RBP = 0;
 	state.MDEC_CT = 1;
@@ -121,6 +221,19 @@ void writeProg(u32 addr)
 {
 	if (addr >= 0x3400 && addr < 0x3C00)
 		state.dirty = true;
+	// Constant COEF and MADRS must be updated
+	else if (addr < 0x3200)
+	{
+		u32 i = (addr - 0x3000) / 4;
+		if (program.constCoef[i] && DSPData->COEF[i] != compiledCoef[i])
+			state.dirty = true;
+	}
+	else if (addr < 0x3300)
+	{
+		u32 i = (addr - 0x3200) / 4;
+		if (program.constMadrs[i] && DSPData->MADRS[i] != compiledMadrs[i])
+			state.dirty = true;
+	}
 }
 
 void term()
@@ -142,7 +255,10 @@ void step()
 				break;
 			}
 		if (!state.stopped)
+		{
+			analyzeProgram();
 			recompile();
+		}
 	}
 	if (state.stopped)
 		return;
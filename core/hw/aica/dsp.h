@@ -100,6 +100,35 @@ struct Instruction
 };
 
 void DecodeInst(const u32 *IPtr, Instruction *i);
+
+// What each step of the program actually needs to compute.
+// Steps whose results are never used are skipped by the recompilers.
+struct StepInfo
+{
+	bool live;		// the step has some effect
+	bool inputs;	// INPUTS is used
+	bool acc;		// X * Y + B is used by the following steps
+	bool shifter;	// SHIFTED is used
+	bool frcl;		// FRC_REG is loaded and used
+	bool yrl;		// Y_REG is loaded and used
+	bool adrl;		// ADRS_REG is loaded and used
+	bool mrd;		// memory read and MEMVAL used
+	bool mwt;		// memory write
+};
+
+struct ProgramInfo
+{
+	StepInfo steps[128];
+	int liveSteps;
+	// COEF and MADRS registers that aren't modified by the game while the program runs.
+	// Their current value can be compiled as a constant.
+	bool constCoef[128];
+	bool constMadrs[64];
+};
+
+extern ProgramInfo program;
+
+void analyzeProgram();
 u16 DYNACALL PACK(s32 val);
 s32 DYNACALL UNPACK(u16 val);
 
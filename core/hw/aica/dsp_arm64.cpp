@@ -103,12 +103,15 @@ public:
 
         for (int step = 0; step < 128; ++step)
         {
+            const StepInfo& info = program.steps[step];
+            if (!info.live)
+                continue;
             u32 *mpro = &DSPData->MPRO[step * 4];
             Instruction op;
             DecodeInst(mpro, &op);
             const u32 COEF = step;
 
-            if (op.XSEL || op.YRL || (op.ADRL && op.SHIFT != 3))
+            if (info.inputs)
             {
                 if (op.IRA <= 0x1f)
                     //INPUTS = DSP->MEMS[op.IRA];
@@ -138,73 +141,7 @@ public:
                 Str(w1, dsp_operand(DSP->MEMS, op.IWA));
             }
 
-            // Operand sel
-            // B
-            if (!op.ZERO)
-            {
-                if (op.BSEL)
-                    //B = ACC;
-                    Mov(B, ACC);
-                else
-                {
-                    //B = DSP->TEMP[(TRA + DSP->MDEC_CT) & 0x7F];
-                    if (op.TRA)
-                        Add(w1, MDEC_CT, op.TRA);
-                    else
-                        Mov(w1, MDEC_CT);
-                    Bfc(w1, 7, 25);
-                    Ldr(B, dsp_operand(DSP->TEMP, x1));
-                }
-                if (op.NEGB)
-                    //B = 0 - B;
-                    Neg(B, B);
-            }
-
-            // X
-            const Register* X_alias = &X;
-            if (op.XSEL)
-                //X = INPUTS;
-                X_alias = &INPUTS;
-            else
-            {
-                //X = DSP->TEMP[(TRA + DSP->MDEC_CT) & 0x7F];
-                if (!op.ZERO && !op.BSEL && !op.NEGB)
-                    X_alias = &B;
-                else
-                {
-                    if (op.TRA)
-                        Add(w1, MDEC_CT, op.TRA);
-                    else
-                        Mov(w1, MDEC_CT);
-                    Bfc(w1, 7, 25);
-                    Ldr(X, dsp_operand(DSP->TEMP, x1));
-                }
-            }
-
-            // Y
-            if (op.YSEL == 0)
-            {
-                //Y = FRC_REG;
-                Mov(Y, FRC_REG);
-            }
-            else if (op.YSEL == 1)
-            {
-                //Y = DSPData->COEF[COEF] >> 3;    //COEF is 16 bits
-                Ldr(Y, dspdata_operand(DSPData->COEF, COEF));
-                Sbfx(Y, Y, 3, 13);
-            }
-            else if (op.YSEL == 2)
-                //Y = Y_REG >> 11;
-                Asr(Y, Y_REG, 11);
-            else if (op.YSEL == 3)
-                //Y = (Y_REG >> 4) & 0x0FFF;
-                Ubfx(Y, Y_REG, 4, 12);
-
-            if (op.YRL)
-                //Y_REG = INPUTS;
-                Mov(Y_REG, INPUTS);
-
-            if (op.TWT || op.FRCL || op.MWT || (op.ADRL && op.SHIFT == 3) || op.EWT)
+            if (info.shifter)
             {
                 // Shifter
                 // There's a 1-step delay at the output of the X*Y + B adder. So we use the ACC value from the previous step.
@@ -244,18 +181,93 @@ public:
                 }
             }
 
-            // ACCUM
-            //ACC = (((s64)X * (s64)Y) >> 12) + B;
-            const Register& X64 = XRegister(X_alias->GetCode());
-            const Register& Y64 = XRegister(Y.GetCode());
-            Sxtw(X64, *X_alias);
-            Sxtw(Y64, Y);
-            Mul(x0, X64, Y64);
-            Asr(x0, x0, 12);
-            if (op.ZERO)
-                Mov(ACC, w0);
-            else
-                Add(ACC, w0, B);
+            // The shifter must read ACC before it's updated
+            if (info.acc)
+            {
+                // Operand sel
+                // B
+                if (!op.ZERO)
+                {
+                    if (op.BSEL)
+                        //B = ACC;
+                        Mov(B, ACC);
+                    else
+                    {
+                        //B = DSP->TEMP[(TRA + DSP->MDEC_CT) & 0x7F];
+                        if (op.TRA)
+                            Add(w1, MDEC_CT, op.TRA);
+                        else
+                            Mov(w1, MDEC_CT);
+                        Bfc(w1, 7, 25);
+                        Ldr(B, dsp_operand(DSP->TEMP, x1));
+                    }
+                    if (op.NEGB)
+                        //B = 0 - B;
+                        Neg(B, B);
+                }
+
+                // X
+                const Register* X_alias = &X;
+                if (op.XSEL)
+                    //X = INPUTS;
+                    X_alias = &INPUTS;
+                else
+                {
+                    //X = DSP->TEMP[(TRA + DSP->MDEC_CT) & 0x7F];
+                    if (!op.ZERO && !op.BSEL && !op.NEGB)
+                        X_alias = &B;
+                    else
+                    {
+                        if (op.TRA)
+                            Add(w1, MDEC_CT, op.TRA);
+                        else
+                            Mov(w1, MDEC_CT);
+                        Bfc(w1, 7, 25);
+                        Ldr(X, dsp_operand(DSP->TEMP, x1));
+                    }
+                }
+
+                // Y
+                if (op.YSEL == 0)
+                {
+                    //Y = FRC_REG;
+                    Mov(Y, FRC_REG);
+                }
+                else if (op.YSEL == 1)
+                {
+                    //Y = DSPData->COEF[COEF] >> 3;    //COEF is 16 bits
+                    if (program.constCoef[COEF])
+                        Mov(Y, (s32)(::s16)DSPData->COEF[COEF] >> 3);
+                    else
+                    {
+                        Ldr(Y, dspdata_operand(DSPData->COEF, COEF));
+                        Sbfx(Y, Y, 3, 13);
+                    }
+                }
+                else if (op.YSEL == 2)
+                    //Y = Y_REG >> 11;
+                    Asr(Y, Y_REG, 11);
+                else if (op.YSEL == 3)
+                    //Y = (Y_REG >> 4) & 0x0FFF;
+                    Ubfx(Y, Y_REG, 4, 12);
+
+                // ACCUM
+                //ACC = (((s64)X * (s64)Y) >> 12) + B;
+                const Register& X64 = XRegister(X_alias->GetCode());
+                const Register& Y64 = XRegister(Y.GetCode());
+                Sxtw(X64, *X_alias);
+                Sxtw(Y64, Y);
+                Mul(x0, X64, Y64);
+                Asr(x0, x0, 12);
+                if (op.ZERO)
+                    Mov(ACC, w0);
+                else
+                    Add(ACC, w0, B);
+            }
+
+            if (info.yrl)
+                //Y_REG = INPUTS;
+                Mov(Y_REG, INPUTS);
 
             if (op.TWT)
             {
@@ -268,7 +280,7 @@ public:
                 Str(SHIFTED, dsp_operand(DSP->TEMP, x1));
             }
 
-            if (op.FRCL)
+            if (info.frcl)
             {
                 if (op.SHIFT == 3)
                     //FRC_REG = SHIFTED & 0x0FFF;
@@ -281,7 +293,7 @@ public:
             if (step & 1)
             {
                 const Register& ADDR = w11;
-                if (op.MRD)            // memory only allowed on odd. DoA inserts NOPs on even
+                if (info.mrd)            // memory only allowed on odd. DoA inserts NOPs on even
                 {
                     //MEMVAL[(step + 2) & 3] = UNPACK(*(u16 *)&aica_ram[ADDR & ARAM_MASK]);
                     CalculateADDR(ADDR, op, ADRS_REG, MDEC_CT);
@@ -292,7 +304,7 @@ public:
                     Mov(w2, w0);
                     Str(w2, dsp_operand(DSP->MEMVAL, (step + 2) & 3));
                 }
-                if (op.MWT)
+                if (info.mwt)
                 {
                     // *(u16 *)&aica_ram[ADDR & ARAM_MASK] = PACK(SHIFTED);
                     Mov(w0, SHIFTED);
@@ -306,7 +318,7 @@ public:
                 }
             }
 
-            if (op.ADRL)
+            if (info.adrl)
             {
                 if (op.SHIFT == 3)
                     //ADRS_REG = SHIFTED >> 12;
@@ -397,17 +409,32 @@ private:
 
     void CalculateADDR(const Register& ADDR, const Instruction& op, const Register& ADRS_REG, const Register& MDEC_CT)
     {
-        //u32 ADDR = DSPData->MADRS[op.MASA];
-        Ldr(ADDR, dspdata_operand(DSPData->MADRS, op.MASA));
+        if (program.constMadrs[op.MASA])
+        {
+            //u32 ADDR = DSPData->MADRS[op.MASA] + NXADR;
+            u32 addr = DSPData->MADRS[op.MASA] + op.NXADR;
+            if (op.TABLE && !op.ADREB)
+            {
+                // Constant address
+                Mov(ADDR, (((addr & 0xFFFF) << 1) + DSP->RBP) & ARAM_MASK);
+                return;
+            }
+            Mov(ADDR, addr);
+        }
+        else
+        {
+            //u32 ADDR = DSPData->MADRS[op.MASA];
+            Ldr(ADDR, dspdata_operand(DSPData->MADRS, op.MASA));
+            if (op.NXADR)
+                //ADDR++;
+                Add(ADDR, ADDR, 1);
+        }
         if (op.ADREB)
         {
             //ADDR += ADRS_REG & 0x0FFF;
             Ubfx(w0, ADRS_REG, 0, 12);
             Add(ADDR, ADDR, w0);
         }
-        if (op.NXADR)
-            //ADDR++;
-            Add(ADDR, ADDR, 1);
         if (!op.TABLE)
         {
             //ADDR += DSP->MDEC_CT;
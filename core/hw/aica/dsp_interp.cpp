@@ -37,6 +37,9 @@ void runStep()
 
 	for (int step = 0; step < 128; ++step)
 	{
+		const StepInfo& info = program.steps[step];
+		if (!info.live)
+			continue;
 		u32 *IPtr = DSPData->MPRO + step * 4;
 
 		if (IPtr[0] == 0 && IPtr[1] == 0 && IPtr[2] == 0 && IPtr[3] == 0)
@@ -179,7 +182,7 @@ void runStep()
 
 				ADDR <<= 1;					// Word -> byte address
 				ADDR += state.RBP;			// RBP is already a byte address
-				if (MRD)			// memory only allowed on odd. DoA inserts NOPs on even
+				if (info.mrd)			// memory only allowed on odd. DoA inserts NOPs on even
 				{
 					//if (NOFL)
 					//	MEMVAL[(step + 2) & 3] = (*(s16 *)&aica_ram[ADDR]) << 8;
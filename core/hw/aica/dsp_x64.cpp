@@ -93,12 +93,15 @@ public:
 
 		for (int step = 0; step < 128; ++step)
 		{
+			const StepInfo& info = program.steps[step];
+			if (!info.live)
+				continue;
 			u32 *mpro = &DSPData->MPRO[step * 4];
 			Instruction op;
 			DecodeInst(mpro, &op);
 			const u32 COEF = step;
 
-			if (op.XSEL || op.YRL || (op.ADRL && op.SHIFT != 3))
+			if (info.inputs)
 			{
 				if (op.IRA <= 0x1f)
 					//INPUTS = DSP->MEMS[op.IRA];
@@ -128,78 +131,7 @@ public:
 				mov(dword[rbx + dsp_operand(DSP->MEMS, op.IWA)], eax);
 			}
 
-			// Operand sel
-			// B
-			if (!op.ZERO)
-			{
-				if (op.BSEL)
-					//B = ACC;
-					mov(B, ACC);
-				else
-				{
-					//B = DSP->TEMP[(TRA + DSP->MDEC_CT) & 0x7F];
-					mov(eax, MDEC_CT);
-					if (op.TRA)
-						add(eax, op.TRA);
-					and_(eax, 0x7f);
-					mov(B, dword[rbx + rax * 4]);
-				}
-				if (op.NEGB)
-					//B = 0 - B;
-					neg(B);
-			}
-
-			// X
-			Xbyak::Reg32 X_alias = X;
-			if (op.XSEL)
-				//X = INPUTS;
-				X_alias = INPUTS;
-			else
-			{
-				//X = DSP->TEMP[(TRA + DSP->MDEC_CT) & 0x7F];
-				if (!op.ZERO && !op.BSEL && !op.NEGB)
-					X_alias = B;
-				else
-				{
-					mov(eax, MDEC_CT);
-					if (op.TRA)
-						add(eax, op.TRA);
-					and_(eax, 0x7f);
-					mov(X, dword[rbx + rax * 4]);
-				}
-			}
-
-			// Y
-			if (op.YSEL == 0)
-			{
-				//Y = FRC_REG;
-				mov(Y, dword[rbx + dsp_operand(&DSP->FRC_REG)]);
-			}
-			else if (op.YSEL == 1)
-			{
-				//Y = DSPData->COEF[COEF] >> 3;	//COEF is 16 bits
-				movsx(Y, word[rbp + dspdata_operand(DSPData->COEF, COEF)]);
-				sar(Y, 3);
-			}
-			else if (op.YSEL == 2)
-			{
-				//Y = Y_REG >> 11;
-				mov(Y, Y_REG);
-				sar(Y, 11);
-			}
-			else if (op.YSEL == 3)
-			{
-				//Y = (Y_REG >> 4) & 0x0FFF;
-				mov(Y, Y_REG);
-				sar(Y, 4);
-				and_(Y, 0x0fff);
-			}
-
-			if (op.YRL)
-				//Y_REG = INPUTS;
-				mov(Y_REG, INPUTS);
-
-			if (op.TWT || op.FRCL || op.MWT || (op.ADRL && op.SHIFT == 3) || op.EWT)
+			if (info.shifter)
 			{
 				// Shifter
 				// There's a 1-step delay at the output of the X*Y + B adder. So we use the ACC value from the previous step.
@@ -240,16 +172,96 @@ public:
 				// edx contains SHIFTED
 			}
 
-			// ACCUM
-			//ACC = (((s64)X * (s64)Y) >> 12) + B;
-			const Xbyak::Reg64 Xlong = X_alias.cvt64();
-			movsxd(Xlong, X_alias);
-			movsxd(rax, Y);
-			imul(rax, Xlong);
-			sar(rax, 12);
-			mov(ACC, eax);
-			if (!op.ZERO)
-				add(ACC, B);
+			// The shifter must read ACC before it's updated
+			if (info.acc)
+			{
+				// Operand sel
+				// B
+				if (!op.ZERO)
+				{
+					if (op.BSEL)
+						//B = ACC;
+						mov(B, ACC);
+					else
+					{
+						//B = DSP->TEMP[(TRA + DSP->MDEC_CT) & 0x7F];
+						mov(eax, MDEC_CT);
+						if (op.TRA)
+							add(eax, op.TRA);
+						and_(eax, 0x7f);
+						mov(B, dword[rbx + rax * 4]);
+					}
+					if (op.NEGB)
+						//B = 0 - B;
+						neg(B);
+				}
+
+				// X
+				Xbyak::Reg32 X_alias = X;
+				if (op.XSEL)
+					//X = INPUTS;
+					X_alias = INPUTS;
+				else
+				{
+					//X = DSP->TEMP[(TRA + DSP->MDEC_CT) & 0x7F];
+					if (!op.ZERO && !op.BSEL && !op.NEGB)
+						X_alias = B;
+					else
+					{
+						mov(eax, MDEC_CT);
+						if (op.TRA)
+							add(eax, op.TRA);
+						and_(eax, 0x7f);
+						mov(X, dword[rbx + rax * 4]);
+					}
+				}
+
+				// Y
+				if (op.YSEL == 0)
+				{
+					//Y = FRC_REG;
+					mov(Y, dword[rbx + dsp_operand(&DSP->FRC_REG)]);
+				}
+				else if (op.YSEL == 1)
+				{
+					//Y = DSPData->COEF[COEF] >> 3;	//COEF is 16 bits
+					if (program.constCoef[COEF])
+						mov(Y, (s32)(s16)DSPData->COEF[COEF] >> 3);
+					else
+					{
+						movsx(Y, word[rbp + dspdata_operand(DSPData->COEF, COEF)]);
+						sar(Y, 3);
+					}
+				}
+				else if (op.YSEL == 2)
+				{
+					//Y = Y_REG >> 11;
+					mov(Y, Y_REG);
+					sar(Y, 11);
+				}
+				else if (op.YSEL == 3)
+				{
+					//Y = (Y_REG >> 4) & 0x0FFF;
+					mov(Y, Y_REG);
+					sar(Y, 4);
+					and_(Y, 0x0fff);
+				}
+
+				// ACCUM
+				//ACC = (((s64)X * (s64)Y) >> 12) + B;
+				const Xbyak::Reg64 Xlong = X_alias.cvt64();
+				movsxd(Xlong, X_alias);
+				movsxd(rax, Y);
+				imul(rax, Xlong);
+				sar(rax, 12);
+				mov(ACC, eax);
+				if (!op.ZERO)
+					add(ACC, B);
+			}
+
+			if (info.yrl)
+				//Y_REG = INPUTS;
+				mov(Y_REG, INPUTS);
 
 			if (op.TWT)
 			{
@@ -261,7 +273,7 @@ public:
 				mov(dword[rbx + rcx * 4], edx);
 			}
 
-			if (op.FRCL)
+			if (info.frcl)
 			{
 				mov(ecx, edx);
 				if (op.SHIFT == 3)
@@ -275,15 +287,15 @@ public:
 
 			if (step & 1)
 			{
-				if (op.MRD || op.MWT)
+				if (info.mrd || info.mwt)
 				{
-					if ((op.ADRL && op.SHIFT == 3) || op.EWT)
+					if ((info.adrl && op.SHIFT == 3) || op.EWT)
 						push(rdx);
-					if (op.ADRL && op.SHIFT != 3)
+					if (info.adrl && op.SHIFT != 3)
 						push(INPUTS.cvt64());
 				}
 				const Xbyak::Reg32 ADDR = Y;
-				if (op.MRD)			// memory only allowed on odd. DoA inserts NOPs on even
+				if (info.mrd)			// memory only allowed on odd. DoA inserts NOPs on even
 				{
 					//MEMVAL[(step + 2) & 3] = UNPACK(*(u16 *)&aica_ram[ADDR & ARAM_MASK]);
 					CalculateADDR(ADDR, op, ADRS_REG, MDEC_CT);
@@ -292,7 +304,7 @@ public:
 					GenCall(UNPACK);
 					mov(dword[rbx + dsp_operand(&DSP->MEMVAL[(step + 2) & 3])], eax);
 				}
-				if (op.MWT)
+				if (info.mwt)
 				{
 					// *(u16 *)&aica_ram[ADDR & ARAM_MASK] = PACK(SHIFTED);
 					mov(call_arg0, edx);	// SHIFTED
@@ -302,16 +314,16 @@ public:
 					mov(rcx, (uintptr_t)&aica_ram[0]);
 					mov(word[rcx + ADDR.cvt64()], ax);
 				}
-				if (op.MRD || op.MWT)
+				if (info.mrd || info.mwt)
 				{
-					if (op.ADRL && op.SHIFT != 3)
+					if (info.adrl && op.SHIFT != 3)
 						pop(INPUTS.cvt64());
-					if ((op.ADRL && op.SHIFT == 3) || op.EWT)
+					if ((info.adrl && op.SHIFT == 3) || op.EWT)
 						pop(rdx);
 				}
 			}
 
-			if (op.ADRL)
+			if (info.adrl)
 			{
 				if (op.SHIFT == 3)
 				{
@@ -370,8 +382,26 @@ private:
 
 	void CalculateADDR(const Xbyak::Reg32 ADDR, const Instruction& op, const Xbyak::Reg32 ADRS_REG, const Xbyak::Reg32 MDEC_CT)
 	{
-		//u32 ADDR = DSPData->MADRS[op.MASA];
-		mov(ADDR, dword[rbp + dspdata_operand(DSPData->MADRS, op.MASA)]);
+		if (program.constMadrs[op.MASA])
+		{
+			//u32 ADDR = DSPData->MADRS[op.MASA] + NXADR;
+			u32 addr = DSPData->MADRS[op.MASA] + op.NXADR;
+			if (op.TABLE && !op.ADREB)
+			{
+				// Constant address
+				mov(ADDR, (((addr & 0xFFFF) << 1) + DSP->RBP) & ARAM_MASK);
+				return;
+			}
+			mov(ADDR, addr);
+		}
+		else
+		{
+			//u32 ADDR = DSPData->MADRS[op.MASA];
+			mov(ADDR, dword[rbp + dspdata_operand(DSPData->MADRS, op.MASA)]);
+			if (op.NXADR)
+				//ADDR++;
+				add(ADDR, 1);
+		}
 		if (op.ADREB)
 		{
 			//ADDR += ADRS_REG & 0x0FFF;
@@ -379,9 +409,6 @@ private:
 			and_(ecx, 0x0FFF);
 			add(ADDR, ecx);
 		}
-		if (op.NXADR)
-			//ADDR++;
-			add(ADDR, 1);
 		if (!op.TABLE)
 		{
 			//ADDR += DSP->MDEC_CT;
@@ -422,11 +449,12 @@ void recompile()
 
 void recInit()
 {
-#if defined(FEAT_NO_RWX_PAGES) || defined(TARGET_IPHONE)
-    bool rc = virtmem::prepare_jit_block(DynCode, CodeSize, (void**)&pCodeBuffer, &rx_offset);
+#ifdef FEAT_NO_RWX_PAGES
+	bool rc = virtmem::prepare_jit_block(CodeBuffer, CodeBufferSize, (void**)&pCodeBuffer, &rx_offset);
 #else
-    bool rc = virtmem::prepare_jit_block(DynCode, CodeSize, (void**)&pCodeBuffer);
+	bool rc = virtmem::prepare_jit_block(CodeBuffer, CodeBufferSize, (void**)&pCodeBuffer);
 #endif
+	if (!rc)
 		die("virtmem::prepare_jit_block failed in x64 dsp");
 }
 
@@ -66,6 +66,8 @@ public:
 
 		for (int step = 0; step < 128; ++step)
 		{
+			if (!program.steps[step].live)
+				continue;
 			u32 *mpro = &DSPData->MPRO[step * 4];
 			Instruction op;
 			DecodeInst(mpro, &op);
@@ -27,9 +27,16 @@
 #include "hw/gdrom/gdrom_if.h"
 #include "cfg/option.h"
 #include "serialize.h"
+#include "log/BitSet.h"
+#include "hw/sh4/sh4_sched.h"
+#include "util/worker_thread.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 
 #undef FAR
 
@@ -47,6 +54,9 @@
 
 namespace aica::sgc
 {
+// Sound is generated on a separate thread
+static bool threaded;
+
 //Sound generation, mixin, and channel regs emulation
 //x.15
 static s32 volume_lut[16];
@@ -417,6 +427,10 @@ enum PCMSType
 struct ChannelEx
 {
 	static ChannelEx Chans[64];
+	// One bit per enabled channel. Disabled channels don't output anything and are skipped.
+	static u64 activeChannels;
+	// Threaded mode: channels released since the emulation thread last checked, whose KYONB bit must be cleared
+	static std::atomic<u64> releasedChannels;
 
 	ChannelCommonData* ccd;
 
@@ -502,6 +516,12 @@ struct ChannelEx
 		u32 Decay2Rate;
 		u32 ReleaseRate;
 		bool active = false;
+		// Filter coefficients for the current value and q
+		u32 coefValue = ~0u;
+		s32 coefQ;
+		s64 a0;
+		s64 b1;
+		s64 b2;
 	} FEG;
 	
 	struct Lfo
@@ -561,6 +581,12 @@ struct ChannelEx
 	bool quiet;
 	int ChannelNumber;
 
+	// Threaded mode: CA, AEG value, AEG state and loop count of the last generated sample
+	std::atomic<u64> monitor;
+	u32 loopCount;
+	// Loop count when LP was last read by the emulation thread
+	u32 loopsRead;
+
 	static void (ChannelEx::*STREAM_STEP_LUT[5][2][2])();
 	static void (ChannelEx::*STREAM_INITAL_STEP_LUT[5])();
 	static void (ChannelEx::*AEG_STEP_LUT[4])();
@@ -595,6 +621,7 @@ struct ChannelEx
 	void disable()
 	{
 		enabled = false;
+		activeChannels &= ~(1ull << ChannelNumber);
 		SetAegState(EG_Release);
 		AEG.SetValue(0x3FF);
 		CA = 0;
@@ -603,6 +630,7 @@ struct ChannelEx
 	void enable()
 	{
 		enabled = true;
+		activeChannels |= 1ull << ChannelNumber;
 	}
 
 	SampleType InterpolateSample()
@@ -621,19 +649,26 @@ struct ChannelEx
 		constexpr u32 COEF_BITS = 30;
 		const u32 fv = FEG.GetValue();
 		const u32 exp = fv >> 9;
-		const u32 mant = (fv & 0x1FF) | 0x200;
-		u64 a0 = ((u64)mant << 30) >> ((15 - exp) * 2);
-		a0 *= (mant - 1) / 8;
-		a0 >>= (47 - COEF_BITS);
-		s64 f = ((s64)mant << exp) << (COEF_BITS - 25);
-		f += (s64)FEG.q * f / 4096;
-		const s64 b1 = 128ll * 1024 * (1 << (COEF_BITS - 16)) - (f + a0);
-		const s64 b2 = 64ll * 1024 * (1 << (COEF_BITS - 16)) - f;
+		if (fv != FEG.coefValue || FEG.q != FEG.coefQ)
+		{
+			// The filter value is constant most of the time
+			const u32 mant = (fv & 0x1FF) | 0x200;
+			u64 a0 = ((u64)mant << 30) >> ((15 - exp) * 2);
+			a0 *= (mant - 1) / 8;
+			a0 >>= (47 - COEF_BITS);
+			s64 f = ((s64)mant << exp) << (COEF_BITS - 25);
+			f += (s64)FEG.q * f / 4096;
+			FEG.a0 = a0;
+			FEG.b1 = 128ll * 1024 * (1 << (COEF_BITS - 16)) - (f + FEG.a0);
+			FEG.b2 = 64ll * 1024 * (1 << (COEF_BITS - 16)) - f;
+			FEG.coefValue = fv;
+			FEG.coefQ = FEG.q;
+		}
 		if (exp == 0)
 			// avoid residual signal
 			FEG.fractSave = 0;
 
-		const s64 mac = -a0 * sample + b1 * FEG.prev1 - b2 * FEG.prev2 - FEG.fractSave;	// 20+COEF_BITS bits
+		const s64 mac = -FEG.a0 * sample + FEG.b1 * FEG.prev1 - FEG.b2 * FEG.prev2 - FEG.fractSave;	// 20+COEF_BITS bits
 		sample = mac >> COEF_BITS;
 		FEG.fractSave = ((s64)sample << COEF_BITS) - mac;
 		FEG.prev2 = FEG.prev1;
@@ -715,8 +750,21 @@ struct ChannelEx
 
 	static void StepAll(SampleType& mixl, SampleType& mixr)
 	{
-		for (ChannelEx& channel : Chans)
-			channel.Step(mixl, mixr);
+		// Channels may be disabled while stepping
+		for (u64 active = activeChannels; active != 0; active &= active - 1)
+			Chans[Common::LeastSignificantSetBit(active)].Step(mixl, mixr);
+	}
+
+	// Make the channel state visible to the emulation thread
+	void publish()
+	{
+		if (loop.looped)
+		{
+			loopCount++;
+			loop.looped = 0;
+		}
+		u64 value = (CA & 0xFFFF) | ((u64)(AEG.GetValue() & 0x3FF) << 16) | ((u64)AEG.state << 26) | ((u64)loopCount << 32);
+		monitor.store(value, std::memory_order_relaxed);
 	}
 
 	void SetAegState(EGState newstate)
@@ -724,7 +772,11 @@ struct ChannelEx
 		StepAEG = AEG_STEP_LUT[newstate];
 		AEG.state = newstate;
 		if (newstate == EG_Release)
+		{
 			ccd->KYONB = 0;
+			if (threaded)
+				releasedChannels.fetch_or(1ull << ChannelNumber, std::memory_order_relaxed);
+		}
 	}
 
 	void SetFegState(EGState newstate)
@@ -1025,9 +1077,9 @@ struct ChannelEx
 		}
 	} 
 
-	static void initAll() {
+	static void initAll(u8 *regs) {
 		for (std::size_t i = 0; i < std::size(Chans); i++)
-			Chans[i].Init(i, aica_reg);
+			Chans[i].Init(i, regs);
 	}
 };
 
@@ -1467,24 +1519,242 @@ static void staticinitialise()
 static OnLoad staticInit(staticinitialise);
 
 ChannelEx ChannelEx::Chans[64];
+u64 ChannelEx::activeChannels;
+std::atomic<u64> ChannelEx::releasedChannels;
 
 #define Chans ChannelEx::Chans
 
+//
+// Threaded sound generation
+// Register writes and VMU beeps are time stamped and queued along with the samples to generate.
+// The queue is sent in batches to the sound thread, which uses a private copy of the channel, DSP output
+// and mixer registers. DSP registers are only written by the sound thread, and the queue is
+// synced before they're read.
+// Sound generation can lag behind emulation by up to MAX_LATENCY plus a partial batch (about 15 ms):
+// - the channel state read by the SH4 and ARM7 (CA, EG, SGC, LP) is the one of the last generated sample,
+// - channel sample data and the DSP ring buffer are read from aica_ram that late, so ARM7 or SH4 writes
+//   to aica_ram aren't seen at the same sample as with inline generation.
+//
+struct SgcEvent
+{
+	enum Type : u8 {
+		Sample,
+		ChannelReg,
+		CommonReg,
+		DspReg,
+		Beep,
+	};
+	Type type;
+	u8 size;
+	u16 addr;	// register address
+	u32 data;	// register value, CDDA sample (left | right << 16) or beep parameters
+	u64 time;	// sh4_sched_now64()
+};
+
+constexpr u32 BATCH_SAMPLES = 128;
+// Maximum delay between emulation and sound generation, in SH4 cycles
+constexpr u64 MAX_LATENCY = 4 * BATCH_SAMPLES * SH4_MAIN_CLOCK / 44100;
+
+// Channel registers, DSP output levels and common registers up to RBL/RBP
+alignas(4) static u8 soundRegs[0x2808];
+// Registers used to generate sound: aica_reg or the private copy of the sound thread
+static const u8 *sgcRegs = aica_reg;
+static std::vector<SgcEvent> events;
+static u32 queuedSamples;
+static u64 flushedBatches;
+static WorkerThread soundThread("AICA sound");
+static std::mutex renderMutex;
+static std::condition_variable renderCond;
+static u64 renderedTime;
+static u64 renderedBatches;
+
+static void generateSample(s32 EXTS0L, s32 EXTS0R);
+
+static void queueEvent(SgcEvent::Type type, u32 addr, u32 size, u32 data)
+{
+	events.push_back({ type, (u8)size, (u16)addr, data, sh4_sched_now64() });
+}
+
+static void commonRegWritten(u32 reg, u32 size)
+{
+	if (reg + size > 0x2804 && reg < 0x2806)
+	{
+		// RBL, RBP
+		const CommonData_struct *commonData = (const CommonData_struct *)&sgcRegs[0x2800];
+		dsp::state.RBL = (8192 << commonData->RBL) - 1;
+		dsp::state.RBP = (commonData->RBP * 2048) & ARAM_MASK;
+		dsp::state.dirty = true;
+	}
+}
+
+static void writeDspReg(u32 addr, u32 size, u32 data)
+{
+	switch (size)
+	{
+	case 1:
+		aica::writeDspReg<u8>(addr, data);
+		break;
+	case 2:
+		aica::writeDspReg<u16>(addr, data);
+		break;
+	default:
+		aica::writeDspReg<u32>(addr, data);
+		break;
+	}
+}
+
+static void generateSamples(const std::vector<SgcEvent>& batch)
+{
+	for (const SgcEvent& event : batch)
+	{
+		switch (event.type)
+		{
+		case SgcEvent::Sample:
+			{
+				const u64 stepped = ChannelEx::activeChannels;
+				generateSample((s16)event.data, (s16)(event.data >> 16));
+				for (u64 active = stepped; active != 0; active &= active - 1)
+					Chans[Common::LeastSignificantSetBit(active)].publish();
+			}
+			break;
+		case SgcEvent::ChannelReg:
+			memcpy(&soundRegs[event.addr], &event.data, event.size);
+			Chans[event.addr >> 7].RegWrite(event.addr & 0x7f, event.size);
+			break;
+		case SgcEvent::CommonReg:
+			memcpy(&soundRegs[event.addr], &event.data, event.size);
+			commonRegWritten(event.addr, event.size);
+			break;
+		case SgcEvent::DspReg:
+			writeDspReg(event.addr, event.size, event.data);
+			break;
+		case SgcEvent::Beep:
+			beep.update(event.data & 0xffff, event.data >> 16);
+			break;
+		}
+	}
+	{
+		std::lock_guard<std::mutex> _(renderMutex);
+		renderedTime = batch.back().time;
+		renderedBatches++;
+	}
+	renderCond.notify_one();
+}
+
+static void flushEvents()
+{
+	if (events.empty())
+		return;
+	soundThread.run([batch = std::move(events)]() {
+		generateSamples(batch);
+	});
+	events.clear();
+	events.reserve(BATCH_SAMPLES * 2);
+	queuedSamples = 0;
+	flushedBatches++;
+
+	// Don't get too far ahead of sound generation
+	std::unique_lock<std::mutex> lock(renderMutex);
+	renderCond.wait(lock, []() {
+		return renderedTime + MAX_LATENCY >= sh4_sched_now64();
+	});
+}
+
+static void resetRenderedTime()
+{
+	// sh4_sched_now64() restarts from 0 on reset and jumps on state load
+	std::lock_guard<std::mutex> _(renderMutex);
+	renderedTime = 0;
+}
+
+static void resetMonitors()
+{
+	for (ChannelEx& channel : Chans)
+	{
+		channel.loopsRead = channel.loopCount;
+		channel.publish();
+	}
+}
+
+void sync()
+{
+	if (!threaded)
+		return;
+	flushEvents();
+	std::unique_lock<std::mutex> lock(renderMutex);
+	renderCond.wait(lock, []() {
+		return renderedBatches == flushedBatches;
+	});
+}
+
 void init()
 {
-	ChannelEx::initAll();
+	threaded = config::ThreadedAudio && !config::GGPOEnable;
+	if (threaded)
+	{
+		memcpy(soundRegs, aica_reg, sizeof(soundRegs));
+		sgcRegs = soundRegs;
+		ChannelEx::initAll(soundRegs);
+	}
+	else
+	{
+		sgcRegs = aica_reg;
+		ChannelEx::initAll(aica_reg);
+	}
+	resetMonitors();
+	resetRenderedTime();
 	beep.init();
 	dsp::init();
 }
 
 void term()
 {
+	soundThread.stop();
+	events.clear();
+	queuedSamples = 0;
 	dsp::term();
 }
 
 void WriteChannelReg(u32 channel, u32 reg, int size)
 {
-	Chans[channel].RegWrite(reg, size);
+	if (!threaded)
+	{
+		Chans[channel].RegWrite(reg, size);
+		return;
+	}
+	u32 data = 0;
+	memcpy(&data, &aica_reg[channel * 0x80 + reg], size);
+	queueEvent(SgcEvent::ChannelReg, channel * 0x80 + reg, size, data);
+
+	ChannelCommonData *ccd = (ChannelCommonData *)&aica_reg[channel * 0x80];
+	if (reg <= 1 && (reg == 1 || size == 2) && ccd->KYONEX)
+	{
+		ccd->KYONEX = 0;
+		// Key on resets LP
+		for (ChannelEx& chan : Chans)
+			if (((ChannelCommonData *)&aica_reg[chan.ChannelNumber * 0x80])->KYONB)
+				chan.loopsRead = chan.monitor.load(std::memory_order_relaxed) >> 32;
+	}
+}
+
+void WriteCommonReg(u32 reg, int size)
+{
+	if (!threaded)
+	{
+		commonRegWritten(reg, size);
+		return;
+	}
+	u32 data = 0;
+	memcpy(&data, &aica_reg[reg], size);
+	queueEvent(SgcEvent::CommonReg, reg, size, data);
+}
+
+void WriteDspReg(u32 addr, int size, u32 data)
+{
+	if (threaded)
+		queueEvent(SgcEvent::DspReg, addr, size, data);
+	else
+		writeDspReg(addr, size, data);
 }
 
 void ReadCommonReg(u32 reg,bool byte)
@@ -1515,27 +1785,42 @@ void ReadCommonReg(u32 reg,bool byte)
 	case 0x2810: // EG, SGC, LP
 	case 0x2811:
 		{
-			u32 chan=CommonData->MSLC;
-			
-			CommonData->LP=Chans[chan].loop.looped;
+			ChannelEx& channel = Chans[CommonData->MSLC];
 			if (CommonData->AFSEL == 1)
 				WARN_LOG(AICA, "FEG monitor (AFSEL=1) not supported");
-			s32 aeg = Chans[chan].AEG.GetValue();
+			s32 aeg;
+			if (threaded)
+			{
+				const u64 monitor = channel.monitor.load(std::memory_order_relaxed);
+				const u32 loops = monitor >> 32;
+				CommonData->LP = loops != channel.loopsRead;
+				aeg = (monitor >> 16) & 0x3FF;
+				CommonData->SGC = (monitor >> 26) & 3;
+				if (!byte || reg == 0x2811)
+					channel.loopsRead = loops;
+			}
+			else
+			{
+				CommonData->LP = channel.loop.looped;
+				aeg = channel.AEG.GetValue();
+				CommonData->SGC = channel.AEG.state;
+				if (!byte || reg == 0x2811)
+					channel.loop.looped = 0;
+			}
 			if (aeg > 0x3BF)
 				CommonData->EG = 0x1FFF;
 			else
 				CommonData->EG = aeg; //AEG is only 10 bits, FEG is 13 bits
-			CommonData->SGC=Chans[chan].AEG.state;
-
-			if (!byte || reg == 0x2811)
-				Chans[chan].loop.looped = 0;
 		}
 		break;
 	case 0x2814: //CA
 	case 0x2815: //CA
 		{
 			u32 chan=CommonData->MSLC;
-			CommonData->CA = Chans[chan].CA;
+			if (threaded)
+				CommonData->CA = Chans[chan].monitor.load(std::memory_order_relaxed) & 0xFFFF;
+			else
+				CommonData->CA = Chans[chan].CA;
 			//printf("[%d] CA read %d\n",chan,Chans[chan].CA);
 		}
 		break;
@@ -1544,7 +1829,10 @@ void ReadCommonReg(u32 reg,bool byte)
 
 void vmuBeep(int on, int period)
 {
-	beep.update(on, period);
+	if (threaded)
+		queueEvent(SgcEvent::Beep, 0, 0, (on & 0xffff) | (period << 16));
+	else
+		beep.update(on, period);
 }
 
 constexpr int CDDA_SIZE = 2352 / 2;
@@ -1553,16 +1841,7 @@ static u32 cdda_index = CDDA_SIZE;
 
 void AICA_Sample()
 {
-	SampleType mixl,mixr;
-	mixl = 0;
-	mixr = 0;
-	memset(dsp::state.MIXS, 0, sizeof(dsp::state.MIXS));
-
-	ChannelEx::StepAll(mixl,mixr);
-	
-	//OK , generated all Channels  , now DSP/ect + final mix ;p
 	//CDDA EXTS input
-	
 	if (cdda_index >= CDDA_SIZE)
 	{
 		cdda_index = 0;
@@ -1572,12 +1851,41 @@ void AICA_Sample()
 	s32 EXTS0R = cdda_sector[cdda_index+1];
 	cdda_index += 2;
 
+	if (!threaded)
+	{
+		generateSample(EXTS0L, EXTS0R);
+		return;
+	}
+	if (ChannelEx::releasedChannels.load(std::memory_order_relaxed) != 0)
+	{
+		u64 released = ChannelEx::releasedChannels.exchange(0);
+		for (; released != 0; released &= released - 1)
+			((ChannelCommonData *)&aica_reg[Common::LeastSignificantSetBit(released) * 0x80])->KYONB = 0;
+	}
+	queueEvent(SgcEvent::Sample, 0, 0, (u16)EXTS0L | ((u32)EXTS0R << 16));
+	if (++queuedSamples == BATCH_SAMPLES)
+		flushEvents();
+}
+
+static void generateSample(s32 EXTS0L, s32 EXTS0R)
+{
+	const DSP_OUT_VOL_REG *outVol = (const DSP_OUT_VOL_REG *)&sgcRegs[0x2000];
+	const CommonData_struct *commonData = (const CommonData_struct *)&sgcRegs[0x2800];
+	SampleType mixl,mixr;
+	mixl = 0;
+	mixr = 0;
+	memset(dsp::state.MIXS, 0, sizeof(dsp::state.MIXS));
+
+	ChannelEx::StepAll(mixl,mixr);
+	
+	//OK , generated all Channels  , now DSP/ect + final mix ;p
+
 	//Final MIX ..
 	//Add CDDA / DSP effect(s)
 
 	//CDDA
-	VolumePan(EXTS0L, dsp_out_vol[16].EFSDL, dsp_out_vol[16].EFPAN, mixl, mixr);
-	VolumePan(EXTS0R, dsp_out_vol[17].EFSDL, dsp_out_vol[17].EFPAN, mixl, mixr);
+	VolumePan(EXTS0L, outVol[16].EFSDL, outVol[16].EFPAN, mixl, mixr);
+	VolumePan(EXTS0R, outVol[17].EFSDL, outVol[17].EFPAN, mixl, mixr);
 
 	DSPData->EXTS[0] = EXTS0L;
 	DSPData->EXTS[1] = EXTS0R;
@@ -1587,7 +1895,7 @@ void AICA_Sample()
 		dsp::step();
 
 		for (int i = 0; i < 16; i++)
-			VolumePan(*(s16*)&DSPData->EFREG[i], dsp_out_vol[i].EFSDL, dsp_out_vol[i].EFPAN, mixl, mixr);
+			VolumePan(*(s16*)&DSPData->EFREG[i], outVol[i].EFSDL, outVol[i].EFPAN, mixl, mixr);
 	}
 
 #ifdef LIBRETRO
@@ -1605,17 +1913,17 @@ void AICA_Sample()
 	}
 
 	// Mono
-	if (CommonData->Mono)
+	if (commonData->Mono)
 		mixl = mixr = FPs(mixl + mixr, 1);
 	
 	//MVOL !
 	//we want to make sure mix* is *At least* 23 bits wide here, so 64 bit mul !
-	u32 mvol = CommonData->MVOL;
+	u32 mvol = commonData->MVOL;
 	s32 val = volume_lut[mvol];
 	mixl = (s32)FPMul<s64>(mixl, val, 15);
 	mixr = (s32)FPMul<s64>(mixr, val, 15);
 
-	if (CommonData->DAC18B)
+	if (commonData->DAC18B)
 	{
 		//If 18 bit output , make it 16b :p
 		mixl = FPs(mixl, 2);
@@ -1646,7 +1954,10 @@ void serialize(Serializer& ser)
 		ser << channel.step;
 		ser << channel.s0;
 		ser << channel.s1;
-		ser << channel.loop.looped;
+		if (threaded)
+			ser << (u8)((u32)(channel.monitor.load(std::memory_order_relaxed) >> 32) != channel.loopsRead);
+		else
+			ser << channel.loop.looped;
 		ser << channel.adpcm.last_quant;
 		ser << channel.adpcm.loopstart_quant;
 		ser << channel.adpcm.loopstart_prev_sample;
@@ -1675,6 +1986,11 @@ void serialize(Serializer& ser)
 
 void deserialize(Deserializer& deser)
 {
+	if (threaded)
+	{
+		memcpy(soundRegs, aica_reg, sizeof(soundRegs));
+		resetRenderedTime();
+	}
 	for (ChannelEx& channel : Chans)
 	{
 		channel.quiet = true;
@@ -1722,6 +2038,10 @@ void deserialize(Deserializer& deser)
 		deser >> channel.lfo.state;
 		channel.UpdateLFO(true);
 		deser >> channel.enabled;
+		if (channel.enabled)
+			ChannelEx::activeChannels |= 1ull << channel.ChannelNumber;
+		else
+			ChannelEx::activeChannels &= ~(1ull << channel.ChannelNumber);
 		channel.quiet = false;
 	}
 	beep.deserialize(deser);
@@ -1739,6 +2059,7 @@ void deserialize(Deserializer& deser)
 			midiSendBuffer.push_back(b);
 		}
 	}
+	resetMonitors();
 }
 
 } // namespace aica::sgc
@@ -7,9 +7,15 @@ namespace aica::sgc
 void AICA_Sample();
 
 void WriteChannelReg(u32 channel, u32 reg, int size);
+// DSP output levels and common registers up to RBL/RBP. The new value is in aica_reg.
+void WriteCommonReg(u32 reg, int size);
+// DSP program, COEF, MADRS, TEMP, MEMS and MIXS registers
+void WriteDspReg(u32 addr, int size, u32 data);
 
 void init();
 void term();
+// Wait until all queued samples have been generated. No-op unless sound is generated on a separate thread.
+void sync();
 
 union fp_22_10
 {
@@ -1,5 +1,6 @@
 #include "Renderer_if.h"
 #include "spg.h"
+#include "ta_capture.h"
 #include "rend/texconv.h"
 #include "rend/transform_matrix.h"
 #include "cfg/option.h"
@@ -265,6 +266,7 @@ bool rend_single_frame(const bool& enabled)
 Renderer* rend_GLES2();
 Renderer* rend_GL4();
 Renderer* rend_norend();
+Renderer* rend_softrend();
 Renderer* rend_Vulkan();
 Renderer* rend_OITVulkan();
 Renderer* rend_DirectX9();
@@ -274,7 +276,10 @@ Renderer* rend_OITDirectX11();
 static void rend_create_renderer()
 {
 #ifdef NO_REND
-	renderer	 = rend_norend();
+	if (config::RendererType == RenderType::Software)
+		renderer = rend_softrend();
+	else
+		renderer = rend_norend();
 #else
 	switch (config::RendererType)
 	{
@@ -413,6 +418,7 @@ void rend_start_render()
 		}
 		ggpo::endOfFrame();
 	}
+	tacapture::startRender(ctx);
 
 	if (QueueRender(ctx))
 	{
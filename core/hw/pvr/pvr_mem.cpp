@@ -11,8 +11,6 @@
 #include "hw/holly/holly_intc.h"
 #include "serialize.h"
 
-static u32 pvr_map32(u32 offset32);
-
 RamRegion vram;
 
 // YUV converter code
@@ -288,7 +286,7 @@ void DYNACALL TAWriteSQ(u32 address, const SQBuffer *sqb)
 
 #define VRAM_BANK_BIT 0x400000
 
-static u32 pvr_map32(u32 offset32)
+u32 pvr_map32(u32 offset32)
 {
 	//64b wide bus is achieved by interleaving the banks every 32 bits
 	const u32 static_bits = VRAM_MASK - (VRAM_BANK_BIT * 2 - 1) + 3;
@@ -24,3 +24,5 @@ template<typename T, bool Internal = false> void DYNACALL pvr_write32p(u32 addr,
 // Area 4 handlers
 template<typename T, bool upper> T DYNACALL pvr_read_area4(u32 addr);
 template<typename T, bool upper> void DYNACALL pvr_write_area4(u32 addr, T data);
+// Convert a 32-bit vram path offset to a 64-bit vram offset
+u32 pvr_map32(u32 offset32);
@@ -15,6 +15,9 @@ void DYNACALL ta_vtx_data32(const SQBuffer *data);
 void ta_vtx_data(const SQBuffer *data, u32 size);
 
 void ta_parse(TA_context *ctx, bool primRestart);
+// Decode the TA data without sorting and building the vertex index.
+// Polygon first and count are vertex indices. Not supported on Naomi 2.
+void ta_parse_vertices(TA_context *ctx);
 
 class TaTypeLut
 {
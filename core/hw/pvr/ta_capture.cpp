@@ -0,0 +1,405 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "ta_capture.h"
+#include "pvr_regs.h"
+#include "pvr_mem.h"
+#include "ta.h"
+#include "Renderer_if.h"
+#include "rend/TexCache.h"
+#include "rend/texconv.h"
+#include "rend/transform_matrix.h"
+#include "cfg/option.h"
+#include "stdclass.h"
+#include "util/worker_thread.h"
+#include <nowide/cstdio.hpp>
+#include <atomic>
+#include <memory>
+#include <cstring>
+
+extern bool pal_needs_update;
+
+namespace tacapture
+{
+
+// Bump when the file layout changes
+constexpr u32 FORMAT_VERSION = 1;
+constexpr u32 MAGIC = 0x43504154;	// TAPC
+// Maximum number of frames waiting to be saved. Newer ones are dropped.
+constexpr size_t MAX_PENDING = 4;
+
+struct FileHeader
+{
+	u32 magic;
+	u32 version;
+	u32 platform;
+	u32 regsSize;
+	u32 passCount;
+	u32 pageCount;
+};
+
+bool Capture::save(const std::string& path) const
+{
+	FILE *fp = nowide::fopen(path.c_str(), "wb");
+	if (fp == nullptr)
+		return false;
+	FileHeader header{};
+	header.magic = MAGIC;
+	header.version = FORMAT_VERSION;
+	header.platform = platform;
+	header.regsSize = pvrRegs.size();
+	header.passCount = taData.size();
+	header.pageCount = vramPages.size();
+	bool ok = std::fwrite(&header, sizeof(header), 1, fp) == 1
+			&& std::fwrite(&state, sizeof(state), 1, fp) == 1
+			&& std::fwrite(pvrRegs.data(), 1, pvrRegs.size(), fp) == pvrRegs.size();
+	for (size_t i = 0; ok && i < taData.size(); i++)
+	{
+		u32 size = taData[i].size();
+		ok = std::fwrite(&size, sizeof(size), 1, fp) == 1
+				&& std::fwrite(taData[i].data(), 1, size, fp) == size;
+	}
+	ok = ok && std::fwrite(vramPages.data(), sizeof(u32), vramPages.size(), fp) == vramPages.size()
+			&& std::fwrite(vramData.data(), 1, vramData.size(), fp) == vramData.size();
+	ok = std::fclose(fp) == 0 && ok;
+	if (!ok)
+		nowide::remove(path.c_str());
+
+	return ok;
+}
+
+bool Capture::load(const std::string& path)
+{
+	FILE *fp = nowide::fopen(path.c_str(), "rb");
+	if (fp == nullptr)
+		return false;
+	FileHeader header;
+	bool ok = std::fread(&header, sizeof(header), 1, fp) == 1
+			&& header.magic == MAGIC
+			&& header.version == FORMAT_VERSION
+			&& header.regsSize == pvr_RegSize
+			&& header.passCount <= MAX_PASSES
+			&& std::fread(&state, sizeof(state), 1, fp) == 1;
+	if (ok)
+	{
+		platform = header.platform;
+		pvrRegs.resize(header.regsSize);
+		ok = std::fread(pvrRegs.data(), 1, pvrRegs.size(), fp) == pvrRegs.size();
+	}
+	taData.clear();
+	for (u32 i = 0; ok && i < header.passCount; i++)
+	{
+		u32 size;
+		ok = std::fread(&size, sizeof(size), 1, fp) == 1 && size <= TA_DATA_SIZE;
+		if (ok)
+		{
+			taData.emplace_back(size);
+			ok = std::fread(taData.back().data(), 1, size, fp) == size;
+		}
+	}
+	if (ok)
+	{
+		vramPages.resize(header.pageCount);
+		vramData.resize(header.pageCount * VRAM_PAGE_SIZE);
+		ok = std::fread(vramPages.data(), sizeof(u32), vramPages.size(), fp) == vramPages.size()
+				&& std::fread(vramData.data(), 1, vramData.size(), fp) == vramData.size();
+	}
+	std::fclose(fp);
+	if (!ok)
+		WARN_LOG(PVR, "Invalid TA capture file %s", path.c_str());
+
+	return ok;
+}
+
+TA_context *Capture::restore() const
+{
+	if (platform != (u32)settings.platform.system || taData.empty())
+		return nullptr;
+	memcpy(pvr_regs, pvrRegs.data(), pvr_RegSize);
+	vram.zero();
+	for (size_t i = 0; i < vramPages.size(); i++)
+	{
+		if ((vramPages[i] + 1) * VRAM_PAGE_SIZE > VRAM_SIZE)
+			continue;
+		memcpy(&vram[vramPages[i] * VRAM_PAGE_SIZE], &vramData[i * VRAM_PAGE_SIZE], VRAM_PAGE_SIZE);
+	}
+	pal_needs_update = true;
+	palette_update();
+
+	TA_context *ctx = nullptr;
+	TA_context *last = nullptr;
+	for (const std::vector<u8>& data : taData)
+	{
+		TA_context *pass = new TA_context();
+		pass->Alloc();
+		memcpy(pass->tad.thd_root, data.data(), data.size());
+		pass->tad.thd_data = pass->tad.thd_root + data.size();
+		if (last == nullptr)
+			ctx = pass;
+		else
+			last->nextContext = pass;
+		last = pass;
+	}
+	FillBGP(ctx);
+
+	rend_context& rend = ctx->rend;
+	rend.isRTT = state.isRTT != 0;
+	rend.clearFramebuffer = state.clearFramebuffer != 0;
+	rend.fb_W_SOF1 = state.fb_W_SOF1;
+	rend.fb_W_CTRL.full = state.fb_W_CTRL;
+	rend.ta_GLOB_TILE_CLIP.full = state.ta_GLOB_TILE_CLIP;
+	rend.scaler_ctl.full = state.scaler_ctl;
+	rend.fb_X_CLIP.full = state.fb_X_CLIP;
+	rend.fb_Y_CLIP.full = state.fb_Y_CLIP;
+	rend.fb_W_LINESTRIDE = state.fb_W_LINESTRIDE;
+	rend.fog_clamp_min.full = state.fog_clamp_min;
+	rend.fog_clamp_max.full = state.fog_clamp_max;
+	if (!rend.isRTT)
+	{
+		int width, height;
+		getScaledFramebufferSize(rend, width, height);
+		rend.framebufferWidth = width;
+		rend.framebufferHeight = height;
+	}
+
+	return ctx;
+}
+
+void freeContext(TA_context *ctx)
+{
+	while (ctx != nullptr)
+	{
+		TA_context *next = ctx->nextContext;
+		delete ctx;
+		ctx = next;
+	}
+}
+
+// Only used to compute the vram range of textures
+class TextureRange final : public BaseTextureCacheData
+{
+public:
+	TextureRange(TSP tsp, TCW tcw) : BaseTextureCacheData(tsp, tcw, 0) {}
+
+	std::string GetId() override { return ""; }
+	void UploadToGPU(int width, int height, const u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) override {}
+};
+
+// VRAM pages referenced by a frame
+class PageSet
+{
+public:
+	PageSet() : pages(VRAM_SIZE / VRAM_PAGE_SIZE) {}
+
+	// Mark a range of the 32-bit vram path
+	void addRange32(u32 addr, u32 size)
+	{
+		for (u32 offset = addr & ~3; offset < addr + size; offset += 4)
+			pages[pvr_map32(offset & VRAM_MASK) / VRAM_PAGE_SIZE] = true;
+	}
+
+	// Mark a range of the 64-bit vram path
+	void addRange64(u32 start, u32 end)
+	{
+		end = std::min(end, VRAM_SIZE);
+		for (u32 page = start / VRAM_PAGE_SIZE; page * VRAM_PAGE_SIZE < end; page++)
+			pages[page] = true;
+	}
+
+	void addTexture(TSP tsp, TCW tcw)
+	{
+		TextureRange texture(tsp, tcw);
+		addRange64(texture.startAddress, texture.mmStartAddress + texture.size);
+	}
+
+	// Mark the textures used by TA display lists. Only the global parameters are decoded,
+	// the vertex parameters are skipped. See BaseTAParser::ta_main()
+	void addTextures(const Ta_Dma *data, const Ta_Dma *end)
+	{
+		constexpr u32 NoList = ~0u;
+		u32 listType = NoList;
+		u32 vertexSize = SZ32;
+		while (data < end)
+		{
+			const PCW pcw = data->pcw;
+			switch (pcw.ParaType)
+			{
+			case ParamType_End_Of_List:
+				listType = NoList;
+				data += SZ32;
+				break;
+
+			case ParamType_User_Tile_Clip:
+			case ParamType_Object_List_Set:
+				data += SZ32;
+				break;
+
+			case ParamType_Polygon_or_Modifier_Volume:
+				if (listType == NoList)
+					listType = pcw.ListType;
+				if (IsModVolList(listType))
+				{
+					vertexSize = SZ64;
+					data += SZ32;
+				}
+				else
+				{
+					const u32 uid = TaTypeLut::instance().table[pcw.obj_ctrl];
+					if (uid == TaTypeLut::INVALID_TYPE)
+					{
+						data += SZ32;
+						break;
+					}
+					// All polygon types start with the same fields. Types 3 and 4 have a second volume.
+					const TA_PolyParam3 *pp = (const TA_PolyParam3 *)data;
+					const u32 polyType = (u8)(uid >> 8);
+					if (pcw.Texture)
+					{
+						addTexture(pp->tsp, pp->tcw);
+						if (polyType == 3 || polyType == 4)
+							addTexture(pp->tsp1, pp->tcw1);
+					}
+					const u32 vertexType = (u8)uid;
+					vertexSize = vertexType == 5 || vertexType == 6 || (vertexType >= 11 && vertexType <= 14) ? SZ64 : SZ32;
+					data += uid >> 30;
+				}
+				break;
+
+			case ParamType_Sprite:
+				if (listType == NoList)
+					listType = pcw.ListType;
+				if (pcw.Texture)
+				{
+					const TA_SpriteParam *sp = (const TA_SpriteParam *)data;
+					addTexture(sp->tsp, sp->tcw);
+				}
+				vertexSize = SZ64;
+				data += SZ32;
+				break;
+
+			case ParamType_Vertex_Parameter:
+				data += vertexSize;
+				break;
+
+			default:
+				// The parser stops here too
+				return;
+			}
+		}
+	}
+
+	std::vector<bool> pages;
+};
+
+static WorkerThread saveThread("TA capture");
+// Number of captures waiting to be saved
+static std::atomic<size_t> pendingSaves;
+
+void startRender(const TA_context *ctx)
+{
+	if (!config::DumpDisplayLists || settings.platform.isNaomi2() || settings.content.gameId.empty())
+		return;
+	if (pendingSaves >= MAX_PENDING)
+	{
+		// Saving can't keep up
+		DEBUG_LOG(PVR, "TA capture dropped");
+		return;
+	}
+
+	std::unique_ptr<Capture> capture = std::make_unique<Capture>();
+	capture->platform = settings.platform.system;
+	capture->state.isRTT = ctx->rend.isRTT;
+	capture->state.clearFramebuffer = ctx->rend.clearFramebuffer;
+	capture->state.fb_W_SOF1 = ctx->rend.fb_W_SOF1;
+	capture->state.fb_W_CTRL = ctx->rend.fb_W_CTRL.full;
+	capture->state.ta_GLOB_TILE_CLIP = ctx->rend.ta_GLOB_TILE_CLIP.full;
+	capture->state.scaler_ctl = ctx->rend.scaler_ctl.full;
+	capture->state.fb_X_CLIP = ctx->rend.fb_X_CLIP.full;
+	capture->state.fb_Y_CLIP = ctx->rend.fb_Y_CLIP.full;
+	capture->state.fb_W_LINESTRIDE = ctx->rend.fb_W_LINESTRIDE;
+	capture->state.fog_clamp_min = ctx->rend.fog_clamp_min.full;
+	capture->state.fog_clamp_max = ctx->rend.fog_clamp_max.full;
+	capture->pvrRegs.assign(pvr_regs, pvr_regs + pvr_RegSize);
+	PageSet pages;
+	for (const TA_context *pass = ctx; pass != nullptr; pass = pass->nextContext)
+	{
+		const u8 *begin = pass->tad.thd_root;
+		const u8 *end = const_cast<TA_context *>(pass)->getTADataEnd();
+		capture->taData.emplace_back(begin, end);
+		pages.addTextures((const Ta_Dma *)begin, (const Ta_Dma *)end);
+	}
+
+	// Background polygon, see FillBGP()
+	u32 stripBase = ((PARAM_BASE & 0xF00000) + ISP_BACKGND_T.tag_address * 4) & VRAM_MASK;
+	u32 vertexSize = 3 + ISP_BACKGND_T.skip;
+	if (FPU_SHAD_SCALE.intensity_shadow == 1 && ISP_BACKGND_T.shadow == 1)
+		vertexSize += ISP_BACKGND_T.skip;
+	vertexSize *= 4;
+	pages.addRange32(stripBase, 3 * 4 + (ISP_BACKGND_T.tag_offset + 3) * vertexSize);
+	ISP_TSP bgIsp;
+	bgIsp.full = pvr_read32p<u32>(stripBase);
+	if (bgIsp.Texture)
+	{
+		TSP tsp;
+		tsp.full = pvr_read32p<u32>(stripBase + 4);
+		TCW tcw;
+		tcw.full = pvr_read32p<u32>(stripBase + 8);
+		pages.addTexture(tsp, tcw);
+	}
+
+	// Region array, see getRegionTileClipping()
+	u32 addr;
+	u32 tileSize;
+	getRegionTileAddrAndSize(addr, tileSize);
+	pages.addRange32(REGION_BASE, addr - REGION_BASE);
+	RegionArrayTile tile;
+	int maxTiles = 3000;
+	do {
+		tile.full = pvr_read32p<u32>(addr);
+		pages.addRange32(addr, tileSize);
+		addr += tileSize;
+	} while (!tile.LastRegion && --maxTiles >= 0);
+
+	for (u32 page = 0; page < pages.pages.size(); page++)
+		if (pages.pages[page])
+		{
+			capture->vramPages.push_back(page);
+			const u8 *data = &vram[page * VRAM_PAGE_SIZE];
+			capture->vramData.insert(capture->vramData.end(), data, data + VRAM_PAGE_SIZE);
+		}
+
+	std::string path = get_writable_data_path("tacapture/");
+	if (!file_exists(path))
+		make_directory(path);
+	path += get_game_id_file_name(settings.content.gameId) + "/";
+	if (!file_exists(path))
+		make_directory(path);
+	path += std::to_string(FrameCount) + ".tac";
+
+	pendingSaves++;
+	saveThread.run([capture = std::shared_ptr<Capture>(std::move(capture)), path]() {
+		if (capture->save(path))
+			NOTICE_LOG(PVR, "Saved TA capture %s: %d passes, %d vram pages", path.c_str(),
+					(int)capture->taData.size(), (int)capture->vramPages.size());
+		else
+			WARN_LOG(PVR, "Cannot save TA capture to %s", path.c_str());
+		pendingSaves--;
+	});
+}
+
+}
@@ -0,0 +1,77 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+#include "ta_ctx.h"
+#include <string>
+#include <vector>
+
+//
+// Capture of the TA display lists of a frame, along with the PVR registers and VRAM pages
+// needed to parse and render them. Captures can be replayed offline without running the SH4.
+// Frames are saved into data/tacapture/<game id>/ while the rend.DumpDisplayLists option is set.
+//
+namespace tacapture
+{
+
+constexpr u32 VRAM_PAGE_SIZE = 4_KB;
+
+struct Capture
+{
+	// rend_context state set from the PVR registers when the render starts
+	struct RenderState
+	{
+		u32 isRTT;
+		u32 clearFramebuffer;
+		u32 fb_W_SOF1;
+		u32 fb_W_CTRL;
+		u32 ta_GLOB_TILE_CLIP;
+		u32 scaler_ctl;
+		u32 fb_X_CLIP;
+		u32 fb_Y_CLIP;
+		u32 fb_W_LINESTRIDE;
+		u32 fog_clamp_min;
+		u32 fog_clamp_max;
+	};
+
+	u32 platform = 0;
+	RenderState state {};
+	std::vector<u8> pvrRegs;
+	// TA data of each render pass
+	std::vector<std::vector<u8>> taData;
+	// VRAM page numbers and their content
+	std::vector<u32> vramPages;
+	std::vector<u8> vramData;
+
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+	// Restore the PVR registers and VRAM, and create the TA context(s) ready to be parsed.
+	// VRAM pages that aren't part of the capture are zeroed.
+	// Returns nullptr if the capture is for a different platform.
+	// The returned context must be released with freeContext().
+	TA_context *restore() const;
+};
+
+void freeContext(TA_context *ctx);
+
+// Snapshot the state and VRAM pages needed to replay a frame, and save it in the background.
+// Called by the emulation thread when a render starts.
+void startRender(const TA_context *ctx);
+
+}
@@ -428,11 +428,23 @@ void ta_set_list_type(u32 listType);
 void ta_parse_reset();
 void getRegionTileAddrAndSize(u32& address, u32& size);
 
-void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previousPass);
+// The following functions append the vertex indices they create to idx.
+// The resulting index offsets are relative to the start of idx.
+void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previousPass, std::vector<u32>& idx);
+void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, const rend_context& ctx, std::vector<u32>& idx);
+void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, const rend_context& ctx, std::vector<u32>& idx);
+
+inline void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previousPass) {
+	sortTriangles(ctx, pass, previousPass, ctx.idx);
+}
+inline void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, rend_context& ctx) {
+	makeIndex(polys, first, end, merge, ctx, ctx.idx);
+}
+inline void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, rend_context& ctx) {
+	makePrimRestartIndex(polys, first, end, merge, ctx, ctx.idx);
+}
 void sortPolyParams(std::vector<PolyParam>& polys, int first, int end, rend_context& ctx);
 void fix_texture_bleeding(const std::vector<PolyParam>& polys, int first, int end, rend_context& ctx);
-void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, rend_context& ctx);
-void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, rend_context& ctx);
 
 class TAParserException : public FlycastException
 {
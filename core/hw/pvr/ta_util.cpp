@@ -18,6 +18,7 @@
  */
 #include "ta_ctx.h"
 #include "pvr_mem.h"
+#include "util/worker_thread.h"
 #include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -57,13 +58,107 @@ static bool operator<(const IndexTrig& left, const IndexTrig& right)
 	return left.z < right.z;
 }
 
+// Triangle count above which a radix sort is used instead of std::stable_sort
+constexpr size_t RADIX_SORT_MIN_TRIANGLES = 256;
+// Triangle count above which both halves are sorted in parallel and then merged
+constexpr size_t PARALLEL_SORT_MIN_TRIANGLES = 16384;
+static WorkerThread sortWorker("TA sort");
+
+// Map a float to an unsigned key with the same ordering. -0 and +0 must compare equal.
+static u32 sortKey(float z)
+{
+	if (z == 0.f)
+		return 0x80000000;
+	u32 bits;
+	memcpy(&bits, &z, sizeof(bits));
+	return (bits & 0x80000000) ? ~bits : bits | 0x80000000;
+}
+
+//
+// Stable LSB radix sort of 64-bit items on their upper 32 bits (the key) using 8-bit digits.
+// Digits that are the same for all keys are skipped.
+// The sorted items are always written back to data.
+//
+static void radixSort(u64 *data, u64 *tmp, size_t count)
+{
+	u32 histo[4][256] {};
+	for (size_t i = 0; i < count; i++)
+	{
+		const u32 key = (u32)(data[i] >> 32);
+		histo[0][key & 0xff]++;
+		histo[1][(key >> 8) & 0xff]++;
+		histo[2][(key >> 16) & 0xff]++;
+		histo[3][key >> 24]++;
+	}
+	u64 *src = data;
+	u64 *dst = tmp;
+	for (int digit = 0; digit < 4; digit++)
+	{
+		const int shift = 32 + digit * 8;
+		u32 *h = histo[digit];
+		if (h[(src[0] >> shift) & 0xff] == count)
+			continue;
+		u32 offset = 0;
+		for (int i = 0; i < 256; i++)
+		{
+			const u32 n = h[i];
+			h[i] = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < count; i++)
+			dst[h[(src[i] >> shift) & 0xff]++] = src[i];
+		std::swap(src, dst);
+	}
+	if (src != data)
+		memcpy(data, src, count * sizeof(u64));
+}
+
+// Stable sort of the triangles by increasing z
+static void sortByDepth(std::vector<IndexTrig>& triangles)
+{
+	const size_t count = triangles.size();
+	if (count < RADIX_SORT_MIN_TRIANGLES)
+	{
+		std::stable_sort(triangles.begin(), triangles.end());
+		return;
+	}
+	// Scratch buffers reused across frames
+	static std::vector<u64> keys;
+	static std::vector<u64> tmp;
+	static std::vector<IndexTrig> sorted;
+	keys.resize(count);
+	tmp.resize(count);
+	for (size_t i = 0; i < count; i++)
+		keys[i] = ((u64)sortKey(triangles[i].z) << 32) | i;
+
+	if (count < PARALLEL_SORT_MIN_TRIANGLES)
+	{
+		radixSort(keys.data(), tmp.data(), count);
+	}
+	else
+	{
+		// Items of the first half all have lower indices, so a stable merge keeps the sort stable
+		const size_t half = count / 2;
+		std::future<void> future = sortWorker.runFuture(radixSort, keys.data(), tmp.data(), half);
+		radixSort(keys.data() + half, tmp.data() + half, count - half);
+		future.get();
+		std::merge(keys.begin(), keys.begin() + half, keys.begin() + half, keys.end(), tmp.begin(),
+				[](u64 a, u64 b) { return (a >> 32) < (b >> 32); });
+		keys.swap(tmp);
+	}
+	sorted.resize(count);
+	for (size_t i = 0; i < count; i++)
+		sorted[i] = triangles[(u32)keys[i]];
+	triangles.swap(sorted);
+}
+
 static float getProjectedZ(const Vertex *v, const float *mat)
 {
 	// -1 / z
 	return -1 / (mat[2] * v->x + mat[1 * 4 + 2] * v->y + mat[2 * 4 + 2] * v->z + mat[3 * 4 + 2]);
 }
 
-void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previousPass)
+void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previousPass, std::vector<u32>& idx)
 {
 	int first = previousPass.tr_count;
 	int count = pass.tr_count - first;
@@ -130,7 +225,7 @@ void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previo
 	}
 
 	//sort them
-	std::stable_sort(triangleList.begin(), triangleList.end());
+	sortByDepth(triangleList);
 
 	//Merge pids/draw cmds if two different pids are actually equal
 	for (size_t k = 1; k < triangleList.size(); k++)
@@ -145,30 +240,30 @@ void sortTriangles(rend_context& ctx, RenderPass& pass, const RenderPass& previo
 
 	//re-assemble them into drawing commands
 
-	int idx = -1;
-	int idxSize = ctx.idx.size();
+	int lastPid = -1;
+	int idxSize = idx.size();
 
 	for (size_t i = 0; i < triangleList.size(); i++)
 	{
 		int pid = triangleList[i].pid;
 		u32* midx = triangleList[i].vid;
 
-		ctx.idx.emplace_back(midx[0]);
-		ctx.idx.emplace_back(midx[1]);
-		ctx.idx.emplace_back(midx[2]);
+		idx.emplace_back(midx[0]);
+		idx.emplace_back(midx[1]);
+		idx.emplace_back(midx[2]);
 
-		if (idx != pid)
+		if (lastPid != pid)
 		{
 			SortedTriangle cur = { (u32)(&pp_base[pid] - &ctx.global_param_tr[0]), (u32)(idxSize + i * 3), 0 };
 
-			if (idx != -1)
+			if (lastPid != -1)
 			{
 				SortedTriangle& last = ctx.sortedTriangles.back();
 				last.count = cur.first - last.first;
 			}
 
 			ctx.sortedTriangles.push_back(cur);
-			idx = pid;
+			lastPid = pid;
 		}
 	}
 
@@ -365,7 +460,7 @@ void fix_texture_bleeding(const std::vector<PolyParam>& polys, int first, int en
 // Create the vertex index, eliminating invalid vertices and merging strips when possible.
 // Use primitive restart when merging strips.
 //
-void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, rend_context& ctx)
+void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, const rend_context& ctx, std::vector<u32>& idx)
 {
 	if (first >= (int)polys.size())
 		return;
@@ -380,14 +475,14 @@ void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, boo
 				&& last_poly->count != 0
 				&& poly->equivalentIgnoreCullingDirection(*last_poly))
 		{
-			ctx.idx.push_back(~0);
+			idx.push_back(~0);
 			dupe_next_vtx = poly->isp.CullMode >= 2 && poly->isp.CullMode != last_poly->isp.CullMode;
 			first_index = last_poly->first;
 		}
 		else
 		{
 			last_poly = poly;
-			first_index = ctx.idx.size();
+			first_index = idx.size();
 		}
 		int last_good_vtx = -1;
 		for (u32 i = 0; i < poly->count; i++)
@@ -409,7 +504,7 @@ void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, boo
 						{
 							if (last_good_vtx >= 0)
 								// reset the strip
-								ctx.idx.push_back(~0);
+								idx.push_back(~0);
 							if (odd && poly->isp.CullMode >= 2)
 								// repeat next vertex to get culling right
 								dupe_next_vtx = true;
@@ -424,20 +519,20 @@ void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, boo
 				last_good_vtx = poly->first + i;
 				if (dupe_next_vtx)
 				{
-					ctx.idx.push_back(last_good_vtx);
+					idx.push_back(last_good_vtx);
 					dupe_next_vtx = false;
 				}
-				ctx.idx.push_back(last_good_vtx);
+				idx.push_back(last_good_vtx);
 			}
 		}
 		if (last_poly == poly)
 		{
 			poly->first = first_index;
-			poly->count = ctx.idx.size() - first_index;
+			poly->count = idx.size() - first_index;
 		}
 		else
 		{
-			last_poly->count = ctx.idx.size() - last_poly->first;
+			last_poly->count = idx.size() - last_poly->first;
 			poly->count = 0;
 		}
 	}
@@ -447,7 +542,7 @@ void makePrimRestartIndex(std::vector<PolyParam>& polys, int first, int end, boo
 // Create the vertex index, eliminating invalid vertices and merging strips when possible.
 // Use degenerate triangles to link strips.
 //
-void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, rend_context& ctx)
+void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, const rend_context& ctx, std::vector<u32>& idx)
 {
 	if (first >= (int)polys.size())
 		return;
@@ -463,18 +558,18 @@ void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, re
 				&& last_poly->count != 0
 				&& poly->equivalentIgnoreCullingDirection(*last_poly))
 		{
-			const u32 last_vtx = ctx.idx[last_poly->first + last_poly->count - 1];
-			ctx.idx.push_back(last_vtx);
+			const u32 last_vtx = idx[last_poly->first + last_poly->count - 1];
+			idx.push_back(last_vtx);
 			if (poly->isp.CullMode < 2 || poly->isp.CullMode == last_poly->isp.CullMode)
 			{
 				if (cullingReversed)
-					ctx.idx.push_back(last_vtx);
+					idx.push_back(last_vtx);
 				cullingReversed = false;
 			}
 			else
 			{
 				if (!cullingReversed)
-					ctx.idx.push_back(last_vtx);
+					idx.push_back(last_vtx);
 				cullingReversed = true;
 			}
 			dupe_next_vtx = true;
@@ -483,7 +578,7 @@ void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, re
 		else
 		{
 			last_poly = poly;
-			first_index = ctx.idx.size();
+			first_index = idx.size();
 			cullingReversed = false;
 		}
 		int last_good_vtx = -1;
@@ -501,7 +596,7 @@ void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, re
 						if (last_good_vtx >= 0)
 						{
 							verify(!dupe_next_vtx);
-							ctx.idx.push_back(last_good_vtx);
+							idx.push_back(last_good_vtx);
 							dupe_next_vtx = true;
 						}
 						break;
@@ -514,23 +609,23 @@ void makeIndex(std::vector<PolyParam>& polys, int first, int end, bool merge, re
 				last_good_vtx = poly->first + i;
 				if (dupe_next_vtx)
 				{
-					ctx.idx.push_back(last_good_vtx);
+					idx.push_back(last_good_vtx);
 					dupe_next_vtx = false;
 				}
-				const u32 count = ctx.idx.size() - first_index;
+				const u32 count = idx.size() - first_index;
 				if (((i ^ count) & 1) ^ cullingReversed)
-					ctx.idx.push_back(last_good_vtx);
-				ctx.idx.push_back(last_good_vtx);
+					idx.push_back(last_good_vtx);
+				idx.push_back(last_good_vtx);
 			}
 		}
 		if (last_poly == poly)
 		{
 			poly->first = first_index;
-			poly->count = ctx.idx.size() - first_index;
+			poly->count = idx.size() - first_index;
 		}
 		else
 		{
-			last_poly->count = ctx.idx.size() - last_poly->first;
+			last_poly->count = idx.size() - last_poly->first;
 			poly->count = 0;
 		}
 	}
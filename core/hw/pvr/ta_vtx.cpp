@@ -9,10 +9,20 @@
 #include "pvr_mem.h"
 #include "Renderer_if.h"
 #include "cfg/option.h"
+#include "util/worker_thread.h"
 
 #include <algorithm>
+#include <exception>
 #include <utility>
 
+#if HOST_CPU == CPU_X64
+#include <emmintrin.h>
+#define TA_VTX_SSE2
+#elif HOST_CPU == CPU_ARM64
+#include <arm_neon.h>
+#define TA_VTX_NEON
+#endif
+
 #define TACALL DYNACALL
 #ifdef NDEBUG
 #undef verify
@@ -25,6 +35,36 @@ static u8 float_to_satu8(float val) {
 	return f32_su8_tbl[(u32&)val >> 16];
 }
 
+//
+// Convert 4 consecutive A, R, G, B floats to saturated bytes, returned in the same order (A in the low byte).
+// Gives the same result as float_to_satu8: the low 16 bits of each float are ignored and NaN maps to 255.
+//
+static u32 float_to_satu8_argb(const f32 *argb)
+{
+#if defined(TA_VTX_SSE2)
+	__m128 f = _mm_castsi128_ps(_mm_and_si128(_mm_loadu_si128((const __m128i *)argb), _mm_set1_epi32(0xffff0000)));
+	const __m128i nan = _mm_castps_si128(_mm_cmpunord_ps(f, f));
+	// max returns the second operand if either is NaN
+	f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.f));
+	__m128i i = _mm_cvttps_epi32(_mm_mul_ps(f, _mm_set1_ps(255.f)));
+	i = _mm_or_si128(i, _mm_and_si128(nan, _mm_set1_epi32(255)));
+	i = _mm_packs_epi32(i, i);
+	i = _mm_packus_epi16(i, i);
+	return _mm_cvtsi128_si32(i);
+#elif defined(TA_VTX_NEON)
+	float32x4_t f = vreinterpretq_f32_u32(vandq_u32(vld1q_u32((const u32 *)argb), vdupq_n_u32(0xffff0000)));
+	const uint32x4_t notNan = vceqq_f32(f, f);
+	f = vminq_f32(vmaxq_f32(f, vdupq_n_f32(0.f)), vdupq_n_f32(1.f));
+	uint32x4_t i = vcvtq_u32_f32(vmulq_f32(f, vdupq_n_f32(255.f)));
+	i = vbslq_u32(notNan, i, vdupq_n_u32(255));
+	const uint16x4_t h = vmovn_u32(i);
+	return vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(h, h))), 0);
+#else
+	return float_to_satu8(argb[0]) | (float_to_satu8(argb[1]) << 8)
+			| (float_to_satu8(argb[2]) << 16) | ((u32)float_to_satu8(argb[3]) << 24);
+#endif
+}
+
 static TA_context *vd_ctx;
 #define vd_rc (vd_ctx->rend)
 
@@ -318,6 +358,33 @@ case num : {\
 					//If SZ64  && 32 bytes
 #define IS_FIST_HALF (poly_size != SZ32 && data == data_end - SZ32)
 
+		if constexpr (poly_size == SZ32)
+		{
+			// Allocate the vertices up to the end of the strip at once and decode them in a tight loop
+			Ta_Dma *run_end = data;
+			while (run_end < data_end && !run_end->pcw.EndOfStrip)
+				run_end++;
+			const bool end_of_strip = run_end < data_end;
+			if (end_of_strip)
+				run_end++;
+			const size_t first = vd_rc.verts.size();
+			vd_rc.verts.resize(first + (run_end - data));
+			runVertex = &vd_rc.verts[first];
+			runVertexEnd = runVertex + (run_end - data);
+			for (; data < run_end; data += SZ32)
+			{
+				verify(data->pcw.ParaType == ParamType_Vertex_Parameter);
+				ta_handle_poly<poly_type, 0>(data, 0);
+			}
+			verify(runVertex == runVertexEnd);
+			if (end_of_strip)
+			{
+				TaCmd = ta_main;
+				EndPolyStrip();
+			}
+			return data;
+		}
+
 		if (IS_FIST_HALF)
 			goto fist_half;
 
@@ -548,15 +615,18 @@ private:
 
 	#define glob_param_bdc(pp) glob_param_bdc_( (TA_PolyParam0*)pp)
 
-	#define poly_float_color_(to,a,r,g,b) \
-		to[Red] = float_to_satu8(r);	\
-		to[Green] = float_to_satu8(g);	\
-		to[Blue] = float_to_satu8(b);	\
-		to[Alpha] = float_to_satu8(a);
-
+	// A, R, G, B floats
+	#define float_color_(to,argb) \
+		{ \
+		u32 t = float_to_satu8_argb(argb); \
+		to[Alpha] = (u8)(t);t>>=8;\
+		to[Red] = (u8)(t);t>>=8;\
+		to[Green] = (u8)(t);t>>=8;\
+		to[Blue] = (u8)(t);      \
+		}
 
 	#define poly_float_color(to,src) \
-		poly_float_color_(to,pp->src##A,pp->src##R,pp->src##G,pp->src##B)
+		float_color_(to,&pp->src##A)
 
 	// Poly param handling
 
@@ -641,6 +711,10 @@ private:
 		}
 	}
 	
+	// Vertices allocated by ta_poly_data for the current run of 32B vertices
+	inline static Vertex *runVertex;
+	inline static Vertex *runVertexEnd;
+
 	static inline void update_fz(float z)
 	{
 		if ((s32&)vd_rc.fZ_max<(s32&)z && (s32&)z<0x49800000)
@@ -653,8 +727,16 @@ private:
 	static Vertex* vert_cvt_base_(T* vtx)
 	{
 		f32 invW = vtx->xyz[2];
-		vd_rc.verts.emplace_back();
-		Vertex* cv = &vd_rc.verts.back();
+		Vertex* cv;
+		if (runVertex != runVertexEnd)
+		{
+			cv = runVertex++;
+		}
+		else
+		{
+			vd_rc.verts.emplace_back();
+			cv = &vd_rc.verts.back();
+		}
 		cv->x = vtx->xyz[0];
 		cv->y = vtx->xyz[1];
 		cv->z = invW;
@@ -695,18 +777,12 @@ private:
 		to[Alpha] = (u8)(t);      \
 		}
 
-	#define vert_float_color_(to,a,r,g,b) \
-		to[Red] = float_to_satu8(r); \
-		to[Green] = float_to_satu8(g); \
-		to[Blue] = float_to_satu8(b); \
-		to[Alpha] = float_to_satu8(a);
-
 		//Macros to make thins easier ;)
 	#define vert_packed_color(to,src) \
 		vert_packed_color_(cv->to,vtx->src);
 
 	#define vert_float_color(to,src) \
-		vert_float_color_(cv->to,vtx->src##A,vtx->src##R,vtx->src##G,vtx->src##B)
+		float_color_(cv->to,&vtx->src##A)
 
 		//Intensity handling
 
@@ -1155,48 +1231,111 @@ private:
 static void getRegionTileClipping(u32& xmin, u32& xmax, u32& ymin, u32& ymax);
 static void getRegionSettings(int passNumber, RenderPass& pass);
 
+// Minimum polygon count of a list for its index to be built on a worker thread
+constexpr int PARALLEL_MIN_POLYS = 64;
+static WorkerThread listWorkers[2] { { "TA list" }, { "TA list" } };
+// Per-list index arenas used when building the index in parallel
+static std::vector<u32> opIndex;
+static std::vector<u32> ptIndex;
+static std::vector<u32> trIndex;
+
+// Append an index arena to the context index and rebase the polygons or sorted triangles using it
+template<typename T>
+static void appendIndex(rend_context& ctx, const std::vector<u32>& index, std::vector<T>& items, int first, int end)
+{
+	const u32 base = ctx.idx.size();
+	ctx.idx.insert(ctx.idx.end(), index.begin(), index.end());
+	for (int i = first; i < end; i++)
+		items[i].first += base;
+}
+
 static void parseRenderPass(RenderPass& pass, const RenderPass& previousPass, rend_context& ctx, bool primRestart)
 {
 	const bool perPixel = config::RendererType == RenderType::OpenGL_OIT
 			|| config::RendererType == RenderType::DirectX11_OIT
 			|| config::RendererType == RenderType::Vulkan_OIT;
 	const bool mergeTranslucent = config::PerStripSorting || perPixel;
+	const bool fixBleeding = config::RenderResolution > 480 && !config::EmulateFramebuffer && config::FixUpscaleBleedingEdge;
+	const bool sortTrianglesEnabled = pass.autosort && !perPixel && !config::PerStripSorting;
 
-	if (config::RenderResolution > 480 && !config::EmulateFramebuffer && config::FixUpscaleBleedingEdge)
-	{
-		fix_texture_bleeding(ctx.global_param_op, previousPass.op_count, pass.op_count, ctx);
-		fix_texture_bleeding(ctx.global_param_pt, previousPass.pt_count, pass.pt_count, ctx);
-		fix_texture_bleeding(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, ctx);
-	}
-	if (primRestart)
-	{
-		makePrimRestartIndex(ctx.global_param_op, previousPass.op_count, pass.op_count, true, ctx);
-		makePrimRestartIndex(ctx.global_param_pt, previousPass.pt_count, pass.pt_count, true, ctx);
-	}
-	else
+	// Each list only touches its own polygons and their vertices so lists can be processed concurrently
+	auto buildIndex = [&](std::vector<PolyParam>& polys, int first, int end, bool merge, std::vector<u32>& idx)
 	{
-		makeIndex(ctx.global_param_op, previousPass.op_count, pass.op_count, true, ctx);
-		makeIndex(ctx.global_param_pt, previousPass.pt_count, pass.pt_count, true, ctx);
-	}
-	pass.sorted_tr_count = previousPass.sorted_tr_count;
-	if (pass.autosort && !perPixel)
-	{
-		if (config::PerStripSorting)
-			sortPolyParams(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, ctx);
+		if (fixBleeding)
+			fix_texture_bleeding(polys, first, end, ctx);
+		if (primRestart)
+			makePrimRestartIndex(polys, first, end, merge, ctx, idx);
 		else
-			sortTriangles(ctx, pass, previousPass);
-	}
-	// sortTriangles already created the index
-	if (!pass.autosort || perPixel || config::PerStripSorting)
+			makeIndex(polys, first, end, merge, ctx, idx);
+	};
+	auto opaque = [&](std::vector<u32>& idx) {
+		buildIndex(ctx.global_param_op, previousPass.op_count, pass.op_count, true, idx);
+	};
+	auto punchThrough = [&](std::vector<u32>& idx) {
+		buildIndex(ctx.global_param_pt, previousPass.pt_count, pass.pt_count, true, idx);
+	};
+	auto translucent = [&](std::vector<u32>& idx)
 	{
-		if (primRestart)
-			makePrimRestartIndex(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, mergeTranslucent, ctx);
+		pass.sorted_tr_count = previousPass.sorted_tr_count;
+		if (sortTrianglesEnabled)
+		{
+			if (fixBleeding)
+				fix_texture_bleeding(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, ctx);
+			// sortTriangles creates the index
+			sortTriangles(ctx, pass, previousPass, idx);
+		}
 		else
-			makeIndex(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, mergeTranslucent, ctx);
-	}
+		{
+			if (pass.autosort && !perPixel)
+				sortPolyParams(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, ctx);
+			buildIndex(ctx.global_param_tr, previousPass.tr_count, pass.tr_count, mergeTranslucent, idx);
+		}
+	};
+
+	const int opCount = pass.op_count - previousPass.op_count;
+	const int ptCount = pass.pt_count - previousPass.pt_count;
+	const int trCount = pass.tr_count - previousPass.tr_count;
+	if (opCount < PARALLEL_MIN_POLYS || std::max(ptCount, trCount) < PARALLEL_MIN_POLYS)
+	{
+		opaque(ctx.idx);
+		punchThrough(ctx.idx);
+		translucent(ctx.idx);
+		return;
+	}
+	opIndex.clear();
+	ptIndex.clear();
+	trIndex.clear();
+	std::future<void> opTask = listWorkers[0].runFuture(opaque, std::ref(opIndex));
+	std::future<void> ptTask;
+	std::exception_ptr error;
+	try {
+		if (ptCount >= PARALLEL_MIN_POLYS)
+			ptTask = listWorkers[1].runFuture(punchThrough, std::ref(ptIndex));
+		else
+			punchThrough(ptIndex);
+		translucent(trIndex);
+	} catch (...) {
+		error = std::current_exception();
+	}
+	// The workers must be done with the index buffers before they're reused
+	opTask.wait();
+	if (ptTask.valid())
+		ptTask.wait();
+	if (error)
+		std::rethrow_exception(error);
+	opTask.get();
+	if (ptTask.valid())
+		ptTask.get();
+
+	appendIndex(ctx, opIndex, ctx.global_param_op, previousPass.op_count, pass.op_count);
+	appendIndex(ctx, ptIndex, ctx.global_param_pt, previousPass.pt_count, pass.pt_count);
+	if (sortTrianglesEnabled)
+		appendIndex(ctx, trIndex, ctx.sortedTriangles, previousPass.sorted_tr_count, pass.sorted_tr_count);
+	else
+		appendIndex(ctx, trIndex, ctx.global_param_tr, previousPass.tr_count, pass.tr_count);
 }
 
-static void ta_parse_vdrc(TA_context* ctx, bool primRestart)
+static void ta_parse_vdrc(TA_context* ctx, bool primRestart, bool buildIndex = true)
 {
 	verify(vd_ctx == nullptr);
 	vd_ctx = ctx;
@@ -1248,7 +1387,8 @@ static void ta_parse_vdrc(TA_context* ctx, bool primRestart)
 			render_pass.mvo_count = vd_rc.global_param_mvo.size();
 			render_pass.mvo_tr_count = vd_rc.global_param_mvo_tr.size();
 
-			parseRenderPass(render_pass, previousPass, vd_rc, primRestart);
+			if (buildIndex)
+				parseRenderPass(render_pass, previousPass, vd_rc, primRestart);
 			previousPass = render_pass;
 		}
 		childCtx = childCtx->nextContext;
@@ -1322,6 +1462,12 @@ void ta_parse(TA_context *ctx, bool primRestart)
 		ta_parse_vdrc(ctx, primRestart);
 }
 
+void ta_parse_vertices(TA_context *ctx)
+{
+	verify(!settings.platform.isNaomi2());
+	ta_parse_vdrc(ctx, false, false);
+}
+
 //
 // Naomi 2 stuff
 //
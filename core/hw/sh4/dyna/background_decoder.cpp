@@ -0,0 +1,145 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "types.h"
+
+#if FEAT_SHREC != DYNAREC_NONE
+#include "background_decoder.h"
+#include "shil_cache.h"
+#include "blockmanager.h"
+#include "ngen.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/sh4_sched.h"
+#include "hw/sh4/modules/mmu.h"
+#include "cfg/option.h"
+#include "util/worker_thread.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+void AnalyseBlock(RuntimeBlockInfo* blk);
+
+namespace bgdecoder
+{
+
+// Limits the work queued and the memory used by blocks that are never reached
+constexpr size_t MAX_PENDING = 64;
+constexpr size_t MAX_DECODED = 4096;
+
+static WorkerThread worker("SH4 decoder");
+static std::mutex mutex;
+static std::unordered_set<u64> pending;
+static std::unordered_map<u64, shilcache::DecodedBlock> decoded;
+// Incremented when the block cache is reset to drop the blocks being decoded
+static std::atomic<u32> generation;
+
+static void decode(u32 addr, fpscr_t fpu_cfg, u64 key, u32 gen)
+{
+	RuntimeBlockInfo block{};
+	block.addr = block.vaddr = addr;
+	block.fpu_cfg = fpu_cfg;
+	block.BranchBlock = NullAddress;
+	block.NextBlock = NullAddress;
+	block.BlockType = BET_SCL_Intr;
+
+	shilcache::DecodedBlock result;
+	bool success = false;
+	// The guest code may be modified while being decoded. Make sure it's stable.
+	u64 hashBefore, hashAfter;
+	if (shilcache::hashCode(addr, PAGE_SIZE, hashBefore))
+	{
+		try {
+			if (dec_DecodeBlock(&block, SH4_TIMESLICE / 2, true))
+			{
+				block.read_only = block.CanBeProtected(block.sh4_code_size);
+				AnalyseBlock(&block);
+				success = result.capture(&block)
+						&& shilcache::hashCode(addr, PAGE_SIZE, hashAfter)
+						&& hashBefore == hashAfter;
+			}
+		} catch (...) {
+			// Let the emulation thread handle it
+		}
+	}
+	// This block isn't registered so don't update the block stats on destruction
+	block.sh4_code_size = 0;
+
+	std::lock_guard<std::mutex> _(mutex);
+	pending.erase(key);
+	if (success && gen == generation)
+	{
+		if (decoded.size() >= MAX_DECODED)
+			decoded.clear();
+		decoded[key] = std::move(result);
+	}
+}
+
+void request(u32 addr, fpscr_t fpu_cfg)
+{
+	if (!config::DynarecBackgroundDecoding || mmu_enabled()
+			|| addr == NullAddress || !IsOnRam(addr)
+			|| bm_GetCodeByVAddr(addr) != ngen_FailedToFindBlock)
+		return;
+	u64 key = shilcache::blockKey(addr, fpu_cfg);
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		if (pending.size() >= MAX_PENDING || decoded.count(key) != 0 || !pending.insert(key).second)
+			return;
+	}
+	u32 gen = generation;
+	worker.run([addr, fpu_cfg, key, gen]() {
+		decode(addr, fpu_cfg, key, gen);
+	});
+}
+
+bool restore(RuntimeBlockInfo *block)
+{
+	if (mmu_enabled())
+		return false;
+	shilcache::DecodedBlock result;
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		if (decoded.empty())
+			return false;
+		auto it = decoded.find(shilcache::blockKey(block->addr, block->fpu_cfg));
+		if (it == decoded.end())
+			return false;
+		result = std::move(it->second);
+		decoded.erase(it);
+	}
+	return result.apply(block);
+}
+
+void reset()
+{
+	std::lock_guard<std::mutex> _(mutex);
+	generation++;
+	decoded.clear();
+}
+
+void term()
+{
+	worker.stop();
+	std::lock_guard<std::mutex> _(mutex);
+	pending.clear();
+	decoded.clear();
+}
+
+}	// namespace bgdecoder
+#endif	// FEAT_SHREC != DYNAREC_NONE
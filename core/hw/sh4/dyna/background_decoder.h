@@ -0,0 +1,44 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+#include "hw/sh4/sh4_if.h"
+
+struct RuntimeBlockInfo;
+
+//
+// Speculative decoding of SH4 blocks on a worker thread.
+// When a block is compiled, its static successors are decoded and optimized in the background
+// so that only the host code generation is left to do on the emulation thread when they're reached.
+// Results are validated against the current guest code before being used.
+//
+namespace bgdecoder
+{
+
+// Queue the decoding of the block at the given physical address, if not compiled yet
+void request(u32 addr, fpscr_t fpu_cfg);
+// Retrieve the decoded block if available. The block address, vaddr and fpu_cfg must be set.
+// Returns true if the block is ready to be compiled.
+bool restore(RuntimeBlockInfo *block);
+// Discard all pending and decoded blocks
+void reset();
+// Stop the worker thread
+void term();
+
+}
@@ -4,8 +4,6 @@
 */
 
 #include <algorithm>
-#include <set>
-#include <map>
 #include "blockmanager.h"
 #include "ngen.h"
 
@@ -16,6 +14,9 @@
 #include "hw/sh4/sh4_sched.h"
 #include "hw/sh4/modules/mmu.h"
 #include "oslib/virtmem.h"
+#include "cfg/option.h"
+#include <unordered_map>
+#include <cinttypes>
 
 #if defined(__unix__) && defined(DYNA_OPROF)
 #include <opagent.h>
@@ -26,20 +27,127 @@ op_agent_t          oprofHandle;
 
 
 typedef std::vector<RuntimeBlockInfoPtr> bm_List;
-typedef std::set<RuntimeBlockInfoPtr> bm_Set;
-typedef std::map<void*, RuntimeBlockInfoPtr> bm_Map;
 
-static bm_Set all_temp_blocks;
+// Blocks sorted by host code address.
+// Since the code buffer is filled sequentially, new blocks are usually appended at the end,
+// until the code buffer wraps around and old segments are reused.
+// Removed blocks leave an empty slot behind, which is reclaimed when the index is compacted.
+class bm_Map
+{
+public:
+	void add(const RuntimeBlockInfoPtr& block)
+	{
+		void *code = (void *)block->code;
+		if (entries.empty() || entries.back().code < code)
+		{
+			entries.push_back({ code, block });
+		}
+		else
+		{
+			auto it = lowerBound(code);
+			if (it != entries.end() && it->code == code)
+			{
+				if (it->block != nullptr) {
+					ERROR_LOG(DYNAREC, "DUP: %08X %p %08X %p", it->block->addr, it->block->code, block->addr, block->code);
+					die("Duplicated block");
+				}
+				it->block = block;
+			}
+			else
+			{
+				entries.insert(it, { code, block });
+			}
+		}
+		liveCount++;
+	}
+
+	// Returns the block containing the given host code address, if any
+	const RuntimeBlockInfoPtr& find(void *code) const
+	{
+		static const RuntimeBlockInfoPtr null;
+		auto it = std::upper_bound(entries.begin(), entries.end(), code,
+				[](void *code, const Entry& entry) { return code < entry.code; });
+		if (it == entries.begin())
+			return null;
+		--it;
+		// Blocks don't overlap so if the closest block has been removed, there's no match
+		if (it->block == nullptr || !it->block->containsCode(code))
+			return null;
+		return it->block;
+	}
+
+	// Removes and returns the block starting at the given host code address
+	RuntimeBlockInfoPtr remove(void *code)
+	{
+		auto it = lowerBound(code);
+		verify(it != entries.end() && it->code == code && it->block != nullptr);
+		RuntimeBlockInfoPtr block = std::move(it->block);
+		it->block.reset();
+		liveCount--;
+		if (entries.size() - liveCount > std::max<size_t>(1024, liveCount))
+			compact();
+		return block;
+	}
+
+	// Reclaims the slots of removed blocks.
+	// Must be called before host code addresses are reused.
+	void compact()
+	{
+		entries.erase(std::remove_if(entries.begin(), entries.end(),
+				[](const Entry& entry) { return entry.block == nullptr; }), entries.end());
+	}
+
+	void clear()
+	{
+		entries.clear();
+		liveCount = 0;
+	}
+
+	bool empty() const {
+		return liveCount == 0;
+	}
+
+	template<typename F>
+	void forEach(F&& f) const
+	{
+		for (const Entry& entry : entries)
+			if (entry.block != nullptr)
+				f(entry.block);
+	}
+
+private:
+	struct Entry
+	{
+		void *code;
+		RuntimeBlockInfoPtr block;
+	};
+
+	std::vector<Entry>::iterator lowerBound(void *code)
+	{
+		return std::lower_bound(entries.begin(), entries.end(), code,
+				[](const Entry& entry, void *code) { return entry.code < code; });
+	}
+
+	std::vector<Entry> entries;
+	size_t liveCount = 0;
+};
+
+static bm_List all_temp_blocks;
 static bm_List del_blocks;
 
 static u32 pageCount;
 bool *unprotected_pages;
-static std::set<RuntimeBlockInfo*> *blocks_per_page;
+// Protected blocks in each RAM page. Blocks spanning two pages are in both lists.
+static std::vector<RuntimeBlockInfo*> *blocks_per_page;
 
 static bm_Map blkmap;
 // Stats
 u32 protected_blocks;
 u32 unprotected_blocks;
+// Block profiler: number of times the blocks at each address have been invalidated by a ram write
+static std::unordered_map<u32, u32> smc_invalidations;
+// Memory area accessed by each non-RAM memory access site
+static std::unordered_map<u32, u32> mem_site_areas;
 
 #define FPCA(x) ((DynarecCodeEntryPtr&)p_sh4rcb->fpcb[(x>>1)&FPCB_MASK])
 
@@ -127,18 +235,7 @@ RuntimeBlockInfoPtr bm_GetBlock(void* dynarec_code)
 	if (blkmap.empty())
 		return NULL;
 
-	void *dynarecrw = CC_RX2RW(dynarec_code);
-	// Returns a block who's code addr is bigger than dynarec_code (or end)
-	auto iter = blkmap.upper_bound(dynarecrw);
-	if (iter == blkmap.begin())
-		return NULL;
-	iter--;  // Need to go back to find the potential candidate
-
-	// However it might be out of bounds, check for that
-	if (!iter->second->containsCode(dynarecrw))
-		return NULL;
-
-	return iter->second;
+	return blkmap.find(CC_RX2RW(dynarec_code));
 }
 
 static void bm_CleanupDeletedBlocks()
@@ -168,13 +265,8 @@ void bm_AddBlock(RuntimeBlockInfo* blk)
 {
 	RuntimeBlockInfoPtr block(blk);
 	if (block->temp_block)
-		all_temp_blocks.insert(block);
-	auto iter = blkmap.find((void*)blk->code);
-	if (iter != blkmap.end()) {
-		ERROR_LOG(DYNAREC, "DUP: %08X %p %08X %p", iter->second->addr, iter->second->code, block->addr, block->code);
-		die("Duplicated block");
-	}
-	blkmap[(void*)block->code] = block;
+		all_temp_blocks.push_back(block);
+	blkmap.add(block);
 
 	verify((void*)bm_GetCode(block->addr) == (void*)ngen_FailedToFindBlock);
 	FPCA(block->addr) = (DynarecCodeEntryPtr)CC_RW2RX(block->code);
@@ -198,11 +290,7 @@ void bm_AddBlock(RuntimeBlockInfo* blk)
 void bm_DiscardBlock(RuntimeBlockInfo* block)
 {
 	// Remove from block map
-	auto it = blkmap.find((void*)block->code);
-	verify(it != blkmap.end());
-	RuntimeBlockInfoPtr block_ptr = it->second;
-
-	blkmap.erase(it);
+	RuntimeBlockInfoPtr block_ptr = blkmap.remove((void*)block->code);
 
 	block_ptr->pNextBlock = NULL;
 	block_ptr->pBranchBlock = NULL;
@@ -213,12 +301,41 @@ void bm_DiscardBlock(RuntimeBlockInfo* block)
 	FPCA(block_ptr->addr) = ngen_FailedToFindBlock;
 
 	if (block_ptr->temp_block)
-		all_temp_blocks.erase(block_ptr);
+	{
+		auto it = std::find(all_temp_blocks.begin(), all_temp_blocks.end(), block_ptr);
+		if (it != all_temp_blocks.end())
+		{
+			*it = std::move(all_temp_blocks.back());
+			all_temp_blocks.pop_back();
+		}
+	}
 
 	del_blocks.push_back(block_ptr);
 	block_ptr->Discard();
 }
 
+u32 bm_DiscardCode(void *start, void *end)
+{
+	std::vector<RuntimeBlockInfoPtr> blocks;
+	blkmap.forEach([&blocks, start, end](const RuntimeBlockInfoPtr& block) {
+		if ((void *)block->code >= start && (void *)block->code < end)
+			blocks.push_back(block);
+	});
+	for (const RuntimeBlockInfoPtr& block : blocks)
+	{
+		// The code of this block will be overwritten so its successors must not relink it anymore
+		if (block->pBranchBlock != nullptr)
+			block->pBranchBlock->RemRef(block);
+		if (block->pNextBlock != nullptr)
+			block->pNextBlock->RemRef(block);
+		bm_DiscardBlock(block.get());
+	}
+	// The code area is about to be reused
+	blkmap.compact();
+
+	return (u32)blocks.size();
+}
+
 void bm_Periodical_1s()
 {
 	bm_CleanupDeletedBlocks();
@@ -237,6 +354,8 @@ void bm_Reset()
 	bm_CleanupDeletedBlocks();
 	protected_blocks = 0;
 	unprotected_blocks = 0;
+	smc_invalidations.clear();
+	mem_site_areas.clear();
 
 #ifndef __SWITCH__
 	if (addrspace::virtmemEnabled())
@@ -286,9 +405,7 @@ void bm_ResetCache()
 	sh4Dynarec->reset();
 	addrspace::bm_reset();
 
-	for (const auto& it : blkmap)
-	{
-		RuntimeBlockInfoPtr block = it.second;
+	blkmap.forEach([](const RuntimeBlockInfoPtr& block) {
 		block->relink_data = 0;
 		block->pNextBlock = NULL;
 		block->pBranchBlock = NULL;
@@ -297,7 +414,7 @@ void bm_ResetCache()
 		// Avoid circular references
 		block->Discard();
 		del_blocks.push_back(block);
-	}
+	});
 
 	blkmap.clear();
 	// blkmap includes temp blocks as well
@@ -329,8 +446,10 @@ void bm_ResetTempCache(bool full)
 		for (const auto& block : all_temp_blocks)
 		{
 			FPCA(block->addr) = ngen_FailedToFindBlock;
-			blkmap.erase((void*)block->code);
+			blkmap.remove((void*)block->code);
 		}
+		// The temp code buffer is about to be reused
+		blkmap.compact();
 	}
 	del_blocks.insert(del_blocks.begin(),all_temp_blocks.begin(),all_temp_blocks.end());
 	all_temp_blocks.clear();
@@ -340,7 +459,7 @@ void bm_Init()
 {
 	pageCount = RAM_SIZE_MAX / PAGE_SIZE;
 	unprotected_pages = new bool[pageCount];
-	blocks_per_page = new std::set<RuntimeBlockInfo*>[pageCount];
+	blocks_per_page = new std::vector<RuntimeBlockInfo*>[pageCount];
 
 #ifdef DYNA_OPROF
 	oprofHandle=op_open_agent();
@@ -363,29 +482,93 @@ void bm_Term()
 	delete[] blocks_per_page;
 }
 
+std::vector<BlockProfile> bm_GetHotBlocks(size_t maxCount)
+{
+	std::vector<BlockProfile> profiles;
+	blkmap.forEach([&profiles](const RuntimeBlockInfoPtr& block) {
+		if (block->runs == 0)
+			return;
+		BlockProfile profile;
+		profile.addr = block->addr;
+		profile.runs = block->runs;
+		profile.cycles = block->runs * block->guest_cycles;
+		profile.host_code_size = block->host_code_size;
+		profile.guest_opcodes = block->guest_opcodes;
+		auto it = smc_invalidations.find(block->addr);
+		profile.smc_invalidations = block->blockcheck_failures + (it != smc_invalidations.end() ? it->second : 0);
+		profiles.push_back(profile);
+	});
+	maxCount = std::min(maxCount, profiles.size());
+	std::partial_sort(profiles.begin(), profiles.begin() + maxCount, profiles.end(),
+			[](const BlockProfile& a, const BlockProfile& b) { return a.cycles > b.cycles; });
+	profiles.resize(maxCount);
+
+	return profiles;
+}
+
 void bm_WriteBlockMap(const std::string& file)
 {
 	FILE* f=fopen(file.c_str(),"wb");
 	if (f)
 	{
 		INFO_LOG(DYNAREC, "Writing block map !");
-		for (const auto& [_, block] : blkmap)
+		if (config::DynarecBlockProfiler)
 		{
+			for (const BlockProfile& profile : bm_GetHotBlocks((size_t)-1))
+				fprintf(f, "hot: %08X:%" PRIu64 ":%" PRIu64 ":%d:%d:%d\n", profile.addr, profile.runs, profile.cycles,
+						profile.host_code_size, profile.guest_opcodes, profile.smc_invalidations);
+		}
+		blkmap.forEach([f](const RuntimeBlockInfoPtr& block) {
 			fprintf(f, "block: %d:%08X:%p:%d:%d:%d\n", block->BlockType, block->addr, block->code, block->host_code_size, block->guest_cycles, block->guest_opcodes);
 			for(size_t j = 0; j < block->oplist.size(); j++)
 				fprintf(f,"\top: %zd:%d:%s\n", j, block->oplist[j].guest_offs, block->oplist[j].dissasm().c_str());
-		}
+		});
 		fclose(f);
 		INFO_LOG(DYNAREC, "Finished writing block map");
 	}
 }
 
+// Guest instructions are 2-byte aligned so the lsb is used for the access type
+static u32 memSiteKey(const RuntimeBlockInfo *block, const shil_opcode& op, bool write)
+{
+	return (block->addr + op.guest_offs) | (u32)write;
+}
+
+void RuntimeBlockInfo::AddMemSite(u32 host_offset, const shil_opcode& op, bool write)
+{
+	mem_sites.emplace_back(host_offset, memSiteKey(this, op, write));
+}
+
+void bm_SetMemSiteFeedback(void *host_pc, u32 address)
+{
+	RuntimeBlockInfoPtr block = bm_GetBlock(host_pc);
+	if (block == nullptr)
+		return;
+	u32 offset = (u32)((u8 *)CC_RX2RW(host_pc) - (u8 *)block->code);
+	for (const auto& site : block->mem_sites)
+		if (site.first == offset)
+		{
+			mem_site_areas[site.second] = address >> 26;
+			break;
+		}
+}
+
+bool bm_GetMemSiteFeedback(const RuntimeBlockInfo *block, const shil_opcode& op, bool write, u32& area)
+{
+	if (mem_site_areas.empty())
+		return false;
+	auto it = mem_site_areas.find(memSiteKey(block, op, write));
+	if (it == mem_site_areas.end())
+		return false;
+	area = it->second;
+	return true;
+}
+
 void sh4_jitsym(FILE* out)
 {
-	for (const auto& [_, block] : blkmap)
-	{
+	blkmap.forEach([out](const RuntimeBlockInfoPtr& block) {
 		fprintf(out, "%p %d %08X\n", block->code, block->host_code_size, block->addr);
-	}
+	});
 }
 
 RuntimeBlockInfo::~RuntimeBlockInfo()
@@ -431,29 +614,35 @@ void RuntimeBlockInfo::Discard()
 		for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + this->sh4_code_size; addr += PAGE_SIZE)
 		{
 			auto& block_list = blocks_per_page[(addr & RAM_MASK) / PAGE_SIZE];
-			block_list.erase(this);
+			auto it = std::find(block_list.begin(), block_list.end(), this);
+			if (it != block_list.end())
+			{
+				*it = block_list.back();
+				block_list.pop_back();
+			}
 		}
 	}
 }
 
-void RuntimeBlockInfo::SetProtectedFlags()
+bool RuntimeBlockInfo::CanBeProtected(u32 code_size) const
 {
 	// Don't write protect rom and BIOS/IP.BIN (Grandia II)
 	if (!IsOnRam(addr) || (addr & 0x1FFF0000) == 0x0c000000)
+		return false;
+	for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + code_size; addr += PAGE_SIZE)
+		if (unprotected_pages[(addr & RAM_MASK) / PAGE_SIZE])
+			return false;
+	return true;
+}
+
+void RuntimeBlockInfo::SetProtectedFlags()
+{
+	if (!CanBeProtected(sh4_code_size))
 	{
 		this->read_only = false;
 		unprotected_blocks++;
 		return;
 	}
-	for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + sh4_code_size; addr += PAGE_SIZE)
-	{
-		if (unprotected_pages[(addr & RAM_MASK) / PAGE_SIZE])
-		{
-			this->read_only = false;
-			unprotected_blocks++;
-			return;
-		}
-	}
 	this->read_only = true;
 	protected_blocks++;
 	for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + sh4_code_size; addr += PAGE_SIZE)
@@ -461,7 +650,7 @@ void RuntimeBlockInfo::SetProtectedFlags()
 		auto& block_list = blocks_per_page[(addr & RAM_MASK) / PAGE_SIZE];
 		if (block_list.empty())
 			bm_LockPage(addr);
-		block_list.insert(this);
+		block_list.push_back(this);
 	}
 }
 
@@ -473,15 +662,20 @@ void bm_RamWriteAccess(u32 addr)
 
 	unprotected_pages[addr / PAGE_SIZE] = true;
 	bm_UnlockPage(addr);
-	std::set<RuntimeBlockInfo*>& block_list = blocks_per_page[addr / PAGE_SIZE];
+	std::vector<RuntimeBlockInfo*>& block_list = blocks_per_page[addr / PAGE_SIZE];
 	if (!block_list.empty())
 	{
-		std::vector<RuntimeBlockInfo*> list_copy;
-		list_copy.insert(list_copy.begin(), block_list.begin(), block_list.end());
-		if (!list_copy.empty())
-			DEBUG_LOG(DYNAREC, "bm_RamWriteAccess write access to %08x pc %08x", addr, Sh4cntx.pc);
+		// Discarding blocks updates the page list so work on a copy
+		static std::vector<RuntimeBlockInfo*> list_copy;
+		list_copy.swap(block_list);
+		DEBUG_LOG(DYNAREC, "bm_RamWriteAccess write access to %08x pc %08x", addr, Sh4cntx.pc);
 		for (auto& block : list_copy)
+		{
+			if (config::DynarecBlockProfiler)
+				smc_invalidations[block->addr]++;
 			bm_DiscardBlock(block);
+		}
+		list_copy.clear();
 		verify(block_list.empty());
 	}
 }
@@ -553,8 +747,7 @@ void print_blocks()
 		INFO_LOG(DYNAREC, "Writing blocks to %p", f);
 	}
 
-	for (const auto& [_, blk] : blkmap)
-	{
+	blkmap.forEach([f](const RuntimeBlockInfoPtr& blk) {
 		if (f)
 		{
 			fprintf(f,"block: %p\n",blk.get());
@@ -605,7 +798,7 @@ void print_blocks()
 
 			fprintf(f,"}\n");
 		}
-	}
+	});
 
 	if (f) fclose(f);
 }
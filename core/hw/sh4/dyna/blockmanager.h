@@ -29,6 +29,8 @@ struct RuntimeBlockInfo
 	bool has_fpu_op;
 	bool temp_block;
 	u32 blockcheck_failures;
+	// Number of executions. Only counted if the block profiler was enabled when compiled.
+	u64 runs;
 
 	u32 BranchBlock; //if not 0xFFFFFFFF then jump target
 	u32 NextBlock;   //if not 0xFFFFFFFF then next block (by position)
@@ -45,6 +47,8 @@ struct RuntimeBlockInfo
 	bool read_only;
 
 	std::vector<shil_opcode> oplist;
+	// Fast memory access sites: host code offset and guest site key
+	std::vector<std::pair<u32, u32>> mem_sites;
 	//predecessors references
 	std::vector<RuntimeBlockInfoPtr> pre_refs;
 
@@ -63,11 +67,28 @@ struct RuntimeBlockInfo
 	void RemRef(const RuntimeBlockInfoPtr& other);
 
 	void Discard();
+	// Returns true if the block code of the given size can be write-protected
+	bool CanBeProtected(u32 code_size) const;
 	void SetProtectedFlags();
+	// Record a fast memory access of the given op at the given host code offset
+	void AddMemSite(u32 host_offset, const shil_opcode& op, bool write);
 };
 
 void bm_WriteBlockMap(const std::string& file);
 
+// Block profiler statistics
+struct BlockProfile
+{
+	u32 addr;
+	u64 runs;
+	u64 cycles;		// estimated guest cycles spent in the block
+	u32 host_code_size;
+	u32 guest_opcodes;
+	u32 smc_invalidations;
+};
+// Returns the most executed blocks, sorted by decreasing estimated cycles
+std::vector<BlockProfile> bm_GetHotBlocks(size_t maxCount);
+
 DynarecCodeEntryPtr DYNACALL bm_GetCodeByVAddr(u32 addr);
 RuntimeBlockInfoPtr bm_GetBlock(void* dynarec_code);
 RuntimeBlockInfoPtr bm_GetStaleBlock(void* dynarec_code);
@@ -75,6 +96,9 @@ RuntimeBlockInfoPtr DYNACALL bm_GetBlock(u32 addr);
 
 void bm_AddBlock(RuntimeBlockInfo* blk);
 void bm_DiscardBlock(RuntimeBlockInfo* block);
+// Discard all the blocks whose host code starts in the given range so that it can be reused.
+// Returns the number of blocks discarded.
+u32 bm_DiscardCode(void *start, void *end);
 void bm_Reset();
 void bm_ResetCache();
 void bm_ResetTempCache(bool full);
@@ -84,6 +108,16 @@ void bm_Init();
 void bm_Term();
 
 void bm_vmem_pagefill(void** ptr,u32 size_bytes);
+
+// Memory access type feedback.
+// Fast memory accesses that fault are rewritten to call the memory handlers.
+// The memory area they accessed is recorded so that the right handler is called directly
+// when the block is recompiled.
+
+// Record that the fast memory access at the given host code address accessed a non-RAM address
+void bm_SetMemSiteFeedback(void *host_pc, u32 address);
+// Returns true and the memory area (address >> 26) previously accessed if the given op is known to not access RAM
+bool bm_GetMemSiteFeedback(const RuntimeBlockInfo *block, const shil_opcode& op, bool write, u32& area);
 static inline bool bm_IsRamPageProtected(u32 addr)
 {
 	extern bool *unprotected_pages;
@@ -21,9 +21,12 @@
 
 #define BLOCK_MAX_SH_OPS_SOFT 500
 #define BLOCK_MAX_SH_OPS_HARD 511
+// Max number of bytes skipped by a forward branch inside a superblock
+#define SUPERBLOCK_MAX_GAP 256
 
-static RuntimeBlockInfo* blk;
-static Sh4Cycles cycleCounter;
+// Blocks can be decoded on the emulation thread and the background decoding thread
+static thread_local RuntimeBlockInfo* blk;
+static thread_local Sh4Cycles cycleCounter;
 
 static inline shil_param mk_imm(u32 immv)
 {
@@ -40,7 +43,7 @@ static inline shil_param mk_regi(int reg)
 	return mk_reg((Sh4RegType)reg);
 }
 
-static state_t state;
+static thread_local state_t state;
 
 static void Emit(shilop op, shil_param rd = shil_param(), shil_param rs1 = shil_param(), shil_param rs2 = shil_param(),
 		u32 size = 0, shil_param rs3 = shil_param(), shil_param rd2 = shil_param())
@@ -558,9 +561,9 @@ static void dec_param(DecParam p,shil_param& r1,shil_param& r2, u32 op)
 #define DIV1_KEY 0x3004
 #define ROTCL_KEY 0x4024
 
-static Sh4RegType div_som_reg1;
-static Sh4RegType div_som_reg2;
-static Sh4RegType div_som_reg3;
+static thread_local Sh4RegType div_som_reg1;
+static thread_local Sh4RegType div_som_reg2;
+static thread_local Sh4RegType div_som_reg3;
 
 static u32 MatchDiv32(u32 pc , Sh4RegType &reg1,Sh4RegType &reg2 , Sh4RegType &reg3)
 {
@@ -929,6 +932,7 @@ static void state_Setup(u32 rpc,fpscr_t fpu_cfg)
 {
 	state.cpu.rpc=rpc;
 	state.cpu.is_delayslot=false;
+	state.cpu.delayslot_sets_ctrl=false;
 	state.cpu.FPR64=fpu_cfg.PR;
 	state.cpu.FSZ64=fpu_cfg.SZ;
 	state.cpu.RoundToZero=fpu_cfg.RM==1;
@@ -945,12 +949,31 @@ static void state_Setup(u32 rpc,fpscr_t fpu_cfg)
 	state.info.has_fpu=false;
 }
 
+// A block ending with a short forward unconditional branch (bra) can continue at the branch target.
+// The skipped bytes are included in the block code range so that its SMC detection and page
+// protection still cover a single contiguous range. Only done for code that can be write-protected.
+static bool dec_canExtendBlock(u32 max_cycles)
+{
+	if (state.BlockType != BET_StaticJump || mmu_enabled())
+		return false;
+	// The code at the branch target depends on fpscr.PR/SZ, and an interrupt check is needed after an sr update
+	if (state.cpu.delayslot_sets_ctrl)
+		return false;
+	// Blocks ended by the size limit or an sr/fpscr update jump to the next pc and must stop there.
+	// Backward branches and targets too far ahead aren't followed either.
+	if (state.JumpAddr <= state.cpu.rpc || state.JumpAddr - state.cpu.rpc > SUPERBLOCK_MAX_GAP)
+		return false;
+	if (blk->oplist.size() >= BLOCK_MAX_SH_OPS_SOFT || blk->guest_cycles >= max_cycles)
+		return false;
+	return blk->CanBeProtected(state.JumpAddr + 2 - blk->vaddr);
+}
+
 void dec_updateBlockCycles(RuntimeBlockInfo *block, u16 op)
 {
 	block->guest_cycles += cycleCounter.countCycles(op);
 }
 
-bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
+bool dec_DecodeBlock(RuntimeBlockInfo* rbi, u32 max_cycles, bool background)
 {
 	blk=rbi;
 	state_Setup(blk->vaddr, blk->fpu_cfg);
@@ -984,7 +1007,7 @@ bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 
 					if (!blk->has_fpu_op && OpDesc[op]->IsFloatingPoint())
 					{
-						if (Sh4cntx.sr.FD == 1)
+						if (!background && Sh4cntx.sr.FD == 1)
 						{
 							// We need to know FPSCR to compile the block, so let the exception handler run first
 							// as it may change the fp registers
@@ -996,6 +1019,8 @@ bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 
 					if (state.cpu.is_delayslot && OpDesc[op]->SetPC())
 						throw FlycastException("Fatal: SH4 branch instruction in delay slot");
+					if (state.cpu.is_delayslot && (OpDesc[op]->SetFPSCR() || OpDesc[op]->SetSR()))
+						state.cpu.delayslot_sets_ctrl = true;
 					if (!OpDesc[op]->rec_oph)
 					{
 						if (!dec_generic(op))
@@ -1022,6 +1047,15 @@ bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 			break;
 
 		case NDO_End:
+			if (dec_canExtendBlock(max_cycles))
+			{
+				state.cpu.rpc = state.JumpAddr;
+				state.cpu.is_delayslot = false;
+				state.NextOp = NDO_NextOp;
+				state.BlockType = BET_SCL_Intr;
+				state.JumpAddr = NullAddress;
+				continue;
+			}
 			// Disabled for now since we need to know if the block is read-only,
 			// which isn't determined until after the decoding.
 			// This is a relatively rare optimization anyway
@@ -37,7 +37,9 @@ enum NextDecoderOperation
 };
 
 struct RuntimeBlockInfo;
-bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles);
+// If background is true, the block is decoded speculatively off the emulation thread
+// and no exception is raised if the FPU is disabled.
+bool dec_DecodeBlock(RuntimeBlockInfo* rbi, u32 max_cycles, bool background = false);
 void dec_updateBlockCycles(RuntimeBlockInfo *block, u16 op);
 
 struct state_t
@@ -55,6 +57,7 @@ struct state_t
 		bool RoundToZero; //false -> Round to nearest.
 		u32 rpc;
 		bool is_delayslot;
+		bool delayslot_sets_ctrl;	// a delay slot wrote SR or FPSCR
 	} cpu;
 
 	struct
@@ -11,6 +11,8 @@
 #include "blockmanager.h"
 #include "ngen.h"
 #include "decoder.h"
+#include "shil_cache.h"
+#include "background_decoder.h"
 #include "oslib/virtmem.h"
 
 #if FEAT_SHREC != DYNAREC_NONE
@@ -18,6 +20,11 @@
 constexpr u32 CODE_SIZE = 10_MB;
 constexpr u32 TEMP_CODE_SIZE = 1_MB;
 constexpr u32 FULL_SIZE = CODE_SIZE + TEMP_CODE_SIZE;
+// The main code buffer is filled one segment at a time. When the last segment is full,
+// the oldest one is reused and only the blocks it contains are discarded.
+// The first segment holds the dynarec main loop and is only cleared by a full cache reset.
+constexpr u32 CODE_SEGMENTS = 8;
+constexpr u32 CODE_SEGMENT_SIZE = CODE_SIZE / CODE_SEGMENTS;
 
 #if defined(_WIN32) || FEAT_SHREC != DYNAREC_JIT || defined(TARGET_IPHONE) || defined(TARGET_ARM_MAC)
 static u8 *SH4_TCB;
@@ -39,6 +46,15 @@ static u8* TempCodeCache;
 ptrdiff_t cc_rx_offset;
 
 static std::unordered_set<u32> smc_hotspots;
+static u32 codeSegment;
+
+static struct {
+    u32 fullFlushes;
+    u32 evictions;
+    u32 evictedBlocks;
+    u32 compiledBlocks;
+    u64 compiledBytes;
+} cacheStats;
 
 static Sh4CodeBuffer codeBuffer;
 Sh4Dynarec *sh4Dynarec;
@@ -62,7 +78,7 @@ u32 Sh4CodeBuffer::getFreeSpace()
     if (tempBuffer)
         return TEMP_CODE_SIZE - tempLastAddr;
     else
-        return CODE_SIZE - lastAddr;
+        return endAddr - lastAddr;
 }
 
 void *Sh4CodeBuffer::getBase()
@@ -80,7 +96,13 @@ void Sh4CodeBuffer::reset(bool temporary)
     if (temporary)
         tempLastAddr = 0;
     else
-        lastAddr = 0;
+        setArea(0, CODE_SEGMENT_SIZE);
+}
+
+void Sh4CodeBuffer::setArea(u32 start, u32 end)
+{
+    lastAddr = start;
+    endAddr = end;
 }
 
 void Sh4Recompiler::clear_temp_cache(bool full)
@@ -92,13 +114,36 @@ void Sh4Recompiler::clear_temp_cache(bool full)
 
 void Sh4Recompiler::ResetCache()
 {
-    INFO_LOG(DYNAREC, "recSh4:Dynarec Cache clear at %08X free space %d", getContext()->pc, codeBuffer.getFreeSpace());
+    cacheStats.fullFlushes++;
+    INFO_LOG(DYNAREC, "recSh4:Dynarec Cache clear at %08X segment %d free space %d. Flushes %d evictions %d (%d blocks) compiled %d blocks (%d KB)",
+            getContext()->pc, codeSegment, codeBuffer.getFreeSpace(), cacheStats.fullFlushes, cacheStats.evictions, cacheStats.evictedBlocks,
+            cacheStats.compiledBlocks, (int)(cacheStats.compiledBytes / 1024));
+    codeSegment = 0;
     codeBuffer.reset(false);
     bm_ResetCache();
+    bgdecoder::reset();
     smc_hotspots.clear();
     clear_temp_cache(true);
 }
 
+void Sh4Recompiler::evictCodeSegment()
+{
+    codeSegment++;
+    if (codeSegment == CODE_SEGMENTS)
+        codeSegment = 1;
+    u8 *start = CodeCache + codeSegment * CODE_SEGMENT_SIZE;
+    u32 blocks = bm_DiscardCode(start, start + CODE_SEGMENT_SIZE);
+    if (blocks > 0)
+    {
+        cacheStats.evictions++;
+        cacheStats.evictedBlocks += blocks;
+        INFO_LOG(DYNAREC, "recSh4:Code segment %d evicted at %08X: %d blocks. Flushes %d evictions %d (%d blocks) compiled %d blocks (%d KB)",
+                codeSegment, getContext()->pc, blocks, cacheStats.fullFlushes, cacheStats.evictions, cacheStats.evictedBlocks,
+                cacheStats.compiledBlocks, (int)(cacheStats.compiledBytes / 1024));
+    }
+    codeBuffer.setArea(codeSegment * CODE_SEGMENT_SIZE, (codeSegment + 1) * CODE_SEGMENT_SIZE);
+}
+
 void Sh4Recompiler::Run()
 {
     getContext()->restoreHostRoundingMode();
@@ -127,6 +172,7 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
     BlockType = BET_SCL_Intr;
     has_fpu_op = false;
     temp_block = false;
+    runs = 0;
     
     vaddr = rpc;
     if (vaddr & 1)
@@ -152,17 +198,24 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
     
     oplist.clear();
 
-    try {
-        if (!dec_DecodeBlock(this, SH4_TIMESLICE / 2))
+    if (shilcache::restore(this))
+        return true;
+
+    if (!bgdecoder::restore(this))
+    {
+        try {
+            if (!dec_DecodeBlock(this, SH4_TIMESLICE / 2))
+                return false;
+        }
+        catch (const SH4ThrownException& ex) {
+            Do_Exception(rpc, ex.expEvn);
             return false;
-    }
-    catch (const SH4ThrownException& ex) {
-        Do_Exception(rpc, ex.expEvn);
-        return false;
-    }
-    SetProtectedFlags();
+        }
+        SetProtectedFlags();
 
-    AnalyseBlock(this);
+        AnalyseBlock(this);
+    }
+    shilcache::add(this);
 
     return true;
 }
@@ -171,8 +224,10 @@ DynarecCodeEntryPtr rdv_CompilePC(u32 blockcheck_failures)
 {
     const u32 pc = Sh4cntx.pc;
 
-    if (codeBuffer.getFreeSpace() < 32_KB || pc == 0x8c0000e0 || pc == 0xac010000 || pc == 0xac008300)
+    if (pc == 0x8c0000e0 || pc == 0xac010000 || pc == 0xac008300)
         Sh4Recompiler::Instance->ResetCache();
+    else if (codeBuffer.getFreeSpace() < 32_KB)
+        Sh4Recompiler::Instance->evictCodeSegment();
 
     RuntimeBlockInfo* rbi = sh4Dynarec->allocateBlock();
 
@@ -195,11 +250,19 @@ DynarecCodeEntryPtr rdv_CompilePC(u32 blockcheck_failures)
     bool block_check = !rbi->read_only;
     sh4Dynarec->compile(rbi, block_check, do_opts);
     verify(rbi->code != nullptr);
+    cacheStats.compiledBlocks++;
+    cacheStats.compiledBytes += rbi->host_code_size;
 
     bm_AddBlock(rbi);
 
     codeBuffer.useTempBuffer(false);
 
+    if (!rbi->temp_block)
+    {
+        bgdecoder::request(rbi->BranchBlock, rbi->fpu_cfg);
+        bgdecoder::request(rbi->NextBlock, rbi->fpu_cfg);
+    }
+
     return rbi->code;
 }
 
@@ -299,6 +362,9 @@ void* DYNACALL rdv_LinkBlock(u8* code,u32 dpc)
     }
 
     DynarecCodeEntryPtr rv = rdv_FindOrCompile();  // Returns rx ptr
+    // The block may have been evicted to make room for the new one
+    if (!stale_block && bm_GetBlock(code) != rbi)
+        stale_block = true;
 
     if (!mmu_enabled() && !stale_block)
     {
@@ -346,7 +412,10 @@ void Sh4Recompiler::Reset(bool hard)
     super::Reset(hard);
     ResetCache();
     if (hard)
+    {
         bm_Reset();
+        shilcache::flush();
+    }
 }
 
 // REPLACE the Init() function in driver.cpp starting around line 355:
@@ -375,6 +444,8 @@ void Sh4Recompiler::Init()
     verify(CodeCache != nullptr);
 
     TempCodeCache = CodeCache + CODE_SIZE;
+    codeSegment = 0;
+    codeBuffer.reset(false);
     sh4Dynarec->init(*getContext(), codeBuffer);
     bm_ResetCache();
     
@@ -395,6 +466,8 @@ void Sh4Recompiler::Term()
         virtmem::release_jit_block(CodeCache, FULL_SIZE);
     
     CodeCache = nullptr;
+    bgdecoder::term();
+    shilcache::flush();
     //sh4Dynarec->term();
     super::Term();
 }
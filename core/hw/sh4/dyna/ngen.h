@@ -75,9 +75,12 @@ public:
 	void useTempBuffer(bool enable) { tempBuffer = enable; }
 	// Reset main or temp code buffer position to 0 (internal use)
 	void reset(bool temporary);
+	// Restrict the main buffer to the given area and set the position at its start (internal use)
+	void setArea(u32 start, u32 end);
 
 private:
 	u32 lastAddr = 0;
+	u32 endAddr = 0;
 	u32 tempLastAddr = 0;
 	bool tempBuffer = false;
 };
@@ -142,6 +145,8 @@ public:
 	void Term() override;
 
 	void clear_temp_cache(bool full);
+	// Reuse the next segment of the code buffer
+	void evictCodeSegment();
 
 	static Sh4Recompiler *Instance;
 };
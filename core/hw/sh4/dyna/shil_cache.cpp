@@ -0,0 +1,283 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "types.h"
+
+#if FEAT_SHREC != DYNAREC_NONE
+#include "shil_cache.h"
+#include "blockmanager.h"
+#include "hw/sh4/sh4_core.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/modules/mmu.h"
+#include "cfg/option.h"
+#include "stdclass.h"
+#include "version.h"
+#include <xxhash.h>
+#include <unordered_map>
+#include <cstring>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace shilcache
+{
+
+// Bump when the shil opcode list or the decoder output changes
+constexpr u32 FORMAT_VERSION = 3;
+constexpr u32 MAGIC = 0x4c494853;	// SHIL
+// Blocks are validated against the whole 4 KB pages they span, since the SSA optimizer
+// can fold constant reads and skip branches within these pages.
+constexpr u32 HASH_PAGE_SHIFT = 12;
+// Same as the decoder hard limit
+constexpr u32 MAX_BLOCK_OPCODES = 511;
+
+struct FileHeader
+{
+	u32 magic;
+	u32 version;
+	u32 opcodeSize;
+	u32 sh4Clock;
+	char gitHash[48];
+};
+
+static std::unordered_map<u64, DecodedBlock> entries;
+static std::string loadedGameId;
+static bool loaded;
+static bool dirty;
+
+u64 blockKey(u32 addr, fpscr_t fpu_cfg)
+{
+	u32 fpscr = fpu_cfg.PR | (fpu_cfg.SZ << 1) | (fpu_cfg.RM << 2);
+	return ((u64)fpscr << 32) | addr;
+}
+
+bool hashCode(u32 addr, u32 size, u64& hash)
+{
+	u32 start = addr & ~((1 << HASH_PAGE_SHIFT) - 1);
+	u32 end = ((addr + size - 1) | ((1 << HASH_PAGE_SHIFT) - 1)) + 1;
+	const u8 *p = GetMemPtr(start, end - start);
+	if (p == nullptr)
+		return false;
+	hash = XXH64(p, end - start, 7);
+	return true;
+}
+
+bool DecodedBlock::capture(const RuntimeBlockInfo *block)
+{
+	if (block->sh4_code_size == 0 || !hashCode(block->addr, block->sh4_code_size, info.hash))
+		return false;
+	info.sh4_code_size = block->sh4_code_size;
+	info.guest_cycles = block->guest_cycles;
+	info.guest_opcodes = block->guest_opcodes;
+	info.BranchBlock = block->BranchBlock;
+	info.NextBlock = block->NextBlock;
+	info.BlockType = block->BlockType;
+	info.opcodeCount = block->oplist.size();
+	info.has_fpu_op = block->has_fpu_op;
+	info.has_jcond = block->has_jcond;
+	info.read_only = block->read_only;
+	info.padding = 0;
+	oplist = block->oplist;
+
+	return true;
+}
+
+bool DecodedBlock::apply(RuntimeBlockInfo *block) const
+{
+	u64 hash;
+	if (!hashCode(block->addr, info.sh4_code_size, hash) || hash != info.hash)
+		return false;
+	if (info.has_fpu_op && Sh4cntx.sr.FD == 1)
+		// Let the decoder raise the exception
+		return false;
+	// The SSA optimizer output depends on the block protection
+	if (block->CanBeProtected(info.sh4_code_size) != (bool)info.read_only)
+		return false;
+
+	block->sh4_code_size = info.sh4_code_size;
+	block->guest_cycles = info.guest_cycles;
+	block->guest_opcodes = info.guest_opcodes;
+	block->BranchBlock = info.BranchBlock;
+	block->NextBlock = info.NextBlock;
+	block->BlockType = (BlockEndType)info.BlockType;
+	block->has_fpu_op = info.has_fpu_op;
+	block->has_jcond = info.has_jcond;
+	block->oplist = oplist;
+	block->SetProtectedFlags();
+
+	return true;
+}
+
+static std::string getCachePath(const std::string& gameId)
+{
+	return get_writable_data_path(get_game_id_file_name(gameId) + ".shilcache");
+}
+
+static FileHeader makeHeader()
+{
+	FileHeader header{};
+	header.magic = MAGIC;
+	header.version = FORMAT_VERSION;
+	header.opcodeSize = sizeof(shil_opcode);
+	header.sh4Clock = config::Sh4Clock;
+	strncpy(header.gitHash, GIT_HASH, sizeof(header.gitHash) - 1);
+	return header;
+}
+
+// Read the cache file and add the blocks that aren't known yet. Returns the number of blocks added.
+static int readFile(const std::string& path)
+{
+	FILE *fp = nowide::fopen(path.c_str(), "rb");
+	if (fp == nullptr)
+		return 0;
+	FileHeader header;
+	FileHeader expected = makeHeader();
+	if (std::fread(&header, sizeof(header), 1, fp) != 1
+			|| memcmp(&header, &expected, sizeof(header)) != 0)
+	{
+		INFO_LOG(DYNAREC, "Ignoring outdated shil cache %s", path.c_str());
+		std::fclose(fp);
+		return 0;
+	}
+	int count = 0;
+	while (true)
+	{
+		u64 key;
+		DecodedBlock entry;
+		if (std::fread(&key, sizeof(key), 1, fp) != 1
+				|| std::fread(&entry.info, sizeof(entry.info), 1, fp) != 1)
+			break;
+		if (entry.info.opcodeCount > MAX_BLOCK_OPCODES)
+			break;
+		entry.oplist.resize(entry.info.opcodeCount);
+		if (std::fread(entry.oplist.data(), sizeof(shil_opcode), entry.oplist.size(), fp) != entry.oplist.size())
+			break;
+		if (entries.emplace(key, std::move(entry)).second)
+			count++;
+	}
+	std::fclose(fp);
+
+	return count;
+}
+
+static void load()
+{
+	loaded = true;
+	dirty = false;
+	loadedGameId = settings.content.gameId;
+	if (loadedGameId.empty())
+		return;
+	std::string path = getCachePath(loadedGameId);
+	if (readFile(path) > 0)
+		NOTICE_LOG(DYNAREC, "Loaded %d blocks from shil cache %s", (int)entries.size(), path.c_str());
+}
+
+static bool enabled()
+{
+	if (!config::DynarecPersistentCache || mmu_enabled())
+		return false;
+	if (!loaded || loadedGameId != settings.content.gameId)
+	{
+		flush();
+		load();
+	}
+	return !loadedGameId.empty();
+}
+
+bool restore(RuntimeBlockInfo *block)
+{
+	if (!enabled())
+		return false;
+	auto it = entries.find(blockKey(block->addr, block->fpu_cfg));
+	if (it == entries.end())
+		return false;
+	return it->second.apply(block);
+}
+
+void add(const RuntimeBlockInfo *block)
+{
+	if (!enabled())
+		return;
+	DecodedBlock entry;
+	if (!entry.capture(block))
+		return;
+	entries[blockKey(block->addr, block->fpu_cfg)] = std::move(entry);
+	dirty = true;
+}
+
+void flush()
+{
+	if (dirty && !loadedGameId.empty())
+	{
+		std::string path = getCachePath(loadedGameId);
+		// Other instances running the same game may have updated the cache since it was loaded.
+		// Keep their blocks so that all instances benefit from each other's work.
+		int merged = readFile(path);
+		if (merged > 0)
+			INFO_LOG(DYNAREC, "Merged %d blocks from shil cache %s", merged, path.c_str());
+		// Write to a temporary file and rename it so that other instances never read a partial file.
+		// The process id makes its name unique among instances.
+#ifdef _WIN32
+		std::string tmpPath = path + "." + std::to_string(_getpid());
+#else
+		std::string tmpPath = path + "." + std::to_string(getpid());
+#endif
+		FILE *fp = nowide::fopen(tmpPath.c_str(), "wb");
+		if (fp == nullptr)
+		{
+			WARN_LOG(DYNAREC, "Cannot save shil cache to %s", tmpPath.c_str());
+		}
+		else
+		{
+			FileHeader header = makeHeader();
+			bool ok = std::fwrite(&header, sizeof(header), 1, fp) == 1;
+			for (auto it = entries.begin(); ok && it != entries.end(); ++it)
+			{
+				const DecodedBlock& entry = it->second;
+				ok = std::fwrite(&it->first, sizeof(it->first), 1, fp) == 1
+						&& std::fwrite(&entry.info, sizeof(entry.info), 1, fp) == 1
+						&& std::fwrite(entry.oplist.data(), sizeof(shil_opcode), entry.oplist.size(), fp) == entry.oplist.size();
+			}
+			ok = std::fclose(fp) == 0 && ok;
+			if (ok && nowide::rename(tmpPath.c_str(), path.c_str()) != 0)
+			{
+				// Windows doesn't replace existing files
+				nowide::remove(path.c_str());
+				ok = nowide::rename(tmpPath.c_str(), path.c_str()) == 0;
+			}
+			if (!ok)
+			{
+				WARN_LOG(DYNAREC, "Error saving shil cache to %s", path.c_str());
+				nowide::remove(tmpPath.c_str());
+			}
+			else
+			{
+				NOTICE_LOG(DYNAREC, "Saved %d blocks to shil cache %s", (int)entries.size(), path.c_str());
+			}
+		}
+	}
+	entries.clear();
+	loadedGameId.clear();
+	loaded = false;
+	dirty = false;
+}
+
+}	// namespace shilcache
+#endif	// FEAT_SHREC != DYNAREC_NONE
@@ -0,0 +1,77 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+#include "shil.h"
+#include <vector>
+
+struct RuntimeBlockInfo;
+
+//
+// Persistent cache of decoded and optimized shil blocks.
+// Blocks are keyed by physical address and fpscr config, and validated against a hash
+// of the guest memory pages they span, so that stale or modified code is never reused.
+// The cache is saved per game (gameId) and reloaded on the first lookup.
+// Instances running the same game share the cache file: blocks saved by other instances are merged when saving.
+//
+namespace shilcache
+{
+
+// Snapshot of the decoder and SSA optimizer output for a block
+struct DecodedBlock
+{
+	struct Info
+	{
+		u64 hash;
+		u32 sh4_code_size;
+		u32 guest_cycles;
+		u32 guest_opcodes;
+		u32 BranchBlock;
+		u32 NextBlock;
+		u32 BlockType;
+		u32 opcodeCount;
+		u8 has_fpu_op;
+		u8 has_jcond;
+		u8 read_only;
+		u8 padding;
+	} info;
+	std::vector<shil_opcode> oplist;
+
+	// Save the decoded state of the block. Returns false if the block code isn't in RAM.
+	bool capture(const RuntimeBlockInfo *block);
+	// Restore the decoded state into the block, which must have its address and fpu_cfg set.
+	// Returns false if the guest code has changed or if the block can't be reused as is.
+	bool apply(RuntimeBlockInfo *block) const;
+};
+
+// Key identifying a block decoding: physical address and fpscr bits used by the decoder
+u64 blockKey(u32 addr, fpscr_t fpu_cfg);
+// Hash the guest memory pages spanned by the given range. Returns false if not in RAM.
+bool hashCode(u32 addr, u32 size, u64& hash);
+
+// Restore the decoded shil opcodes of the given block from the cache.
+// The block address, vaddr and fpu_cfg must be set.
+// Returns true if the block was found and is up to date. The block is then ready to be compiled.
+bool restore(RuntimeBlockInfo *block);
+// Add a freshly decoded and optimized block to the cache
+void add(const RuntimeBlockInfo *block);
+// Save the cache to disk if needed and clear it
+void flush();
+
+}
@@ -79,6 +79,14 @@ public:
 		}
 	}
 
+	// Scratch registers used by the decoder within a single instruction.
+	// Their value is never read by another block, the interpreter or exception handlers
+	// so they never need to be written back to the context.
+	static bool IsBlockLocal(Sh4RegType reg)
+	{
+		return reg == reg_temp;
+	}
+
 private:
 	// References a specific version of a register value
 	class RegValue : public std::pair<Sh4RegType, u32>
@@ -325,7 +333,12 @@ private:
 		u32 last_versions[sh4_reg_count];
 		std::set<RegValue> uses;
 
-		memset(last_versions, -1, sizeof(last_versions));
+		// All registers are live at the end of the block, except scratch ones
+		auto resetLastVersions = [&last_versions]() {
+			memset(last_versions, -1, sizeof(last_versions));
+			last_versions[reg_temp] = -2;	// never read after this point
+		};
+		resetLastVersions();
 		for (int opnum = (int)block->oplist.size() - 1; opnum >= 0; opnum--)
 		{
 			shil_opcode& op = block->oplist[opnum];
@@ -335,7 +348,7 @@ private:
 			{
 				// if mmu enabled, mem accesses can throw an exception
 				// so last_versions must be reset so the regs are correctly saved beforehand
-				memset(last_versions, -1, sizeof(last_versions));
+				resetLastVersions();
 				continue;
 			}
 			if (op.op == shop_pref)
@@ -344,13 +357,13 @@ private:
 					dead_code = true;
 				else if (mmu_enabled())
 				{
-					memset(last_versions, -1, sizeof(last_versions));
+					resetLastVersions();
 					continue;
 				}
 			}
 			if (op.op == shop_sync_sr)
 			{
-				last_versions[reg_sr_T] = -1;
+				// UpdateSR() doesn't use the T bit
 				last_versions[reg_sr_status] = -1;
 				for (int i = reg_r0; i <= reg_r7; i++)
 					last_versions[i] = -1;
@@ -411,6 +411,8 @@ private:
 
 	bool NeedsWriteBack(Sh4RegType reg, u32 version)
 	{
+		if (SSAOptimizer::IsBlockLocal(reg))
+			return false;
 		for (size_t i = opnum + 1; i < block->oplist.size(); i++)
 		{
 			shil_opcode* op = &block->oplist[i];
@@ -1,8 +1,11 @@
 #include "common.h"
 #include "stdclass.h"
 #include "oslib/storage.h"
+#include "cfg/option.h"
+#include "hunk_cache.h"
 
 #include <libchdr/chd.h>
+#include <algorithm>
 
 struct CHDDisc : Disc
 {
@@ -13,25 +16,59 @@ struct CHDDisc : Disc
 
 	chd_file *chd = nullptr;
 	FILE *fp = nullptr;
-	u8* hunk_mem = nullptr;
-	u32 old_hunk = 0;
 
 	u32 hunkbytes = 0;
 	u32 sph = 0;
 
 	void tryOpen(const char* file);
+	u32 readSectors(u32 sector, u32 count, u8 *dst, u32 size);
 
 	~CHDDisc() override
 	{
-		delete[] hunk_mem;
+		hunkCache.stop();
 
 		if (chd)
 			chd_close(chd);
 		if (fp)
 			std::fclose(fp);
 	}
+
+private:
+	HunkCache hunkCache { [this](u32 hunk, u8 *dst) {
+		return chd_read(chd, hunk, dst) == CHDERR_NONE;
+	} };
 };
 
+// Copy consecutive sectors from the decompressed hunks. Returns the number of sectors read.
+u32 CHDDisc::readSectors(u32 sector, u32 count, u8 *dst, u32 size)
+{
+	u32 read = 0;
+	while (read < count)
+	{
+		HunkCache::HunkPtr entry = hunkCache.get(sector / sph);
+		if (entry == nullptr)
+			break;
+		for (u32 i = sector % sph; i < sph && read < count; i++, read++, sector++)
+		{
+			memcpy(dst, entry->data.data() + i * (2352 + 96), size);
+			dst += size;
+		}
+	}
+	return read;
+}
+
+// Swap the bytes of 16-bit audio samples, 4 at a time. size must be a multiple of 8.
+static void swapBytes(u8 *data, u32 size)
+{
+	for (u32 i = 0; i < size; i += 8)
+	{
+		u64 v;
+		memcpy(&v, data + i, sizeof(v));
+		v = ((v & 0x00ff00ff00ff00ffull) << 8) | ((v >> 8) & 0x00ff00ff00ff00ffull);
+		memcpy(data + i, &v, sizeof(v));
+	}
+}
+
 struct CHDTrack : TrackFile
 {
 	CHDDisc* disc;
@@ -50,27 +87,11 @@ struct CHDTrack : TrackFile
 	bool Read(u32 FAD, u8* dst, SectorFormat* sector_type, u8* subcode, SubcodeFormat* subcode_type) override
 	{
 		u32 fad_offs = FAD + Offset;
-		u32 hunk=(fad_offs)/disc->sph;
-		if (disc->old_hunk!=hunk)
-		{
-			if (chd_read(disc->chd,hunk,disc->hunk_mem) != CHDERR_NONE)
-				return false;
-			disc->old_hunk = hunk;
-		}
-
-		u32 hunk_ofs = fad_offs%disc->sph;
-
-		memcpy(dst, disc->hunk_mem + hunk_ofs * (2352+96), fmt);
+		if (disc->readSectors(fad_offs, 1, dst, fmt) != 1)
+			return false;
 
 		if (swap_bytes)
-		{
-			for (u32 i = 0; i < fmt; i += 2)
-			{
-				u8 b = dst[i];
-				dst[i] = dst[i + 1];
-				dst[i + 1] = b;
-			}
-		}
+			swapBytes(dst, fmt);
 		switch (fmt)
 		{
 		case 2048:
@@ -86,11 +107,22 @@ struct CHDTrack : TrackFile
 		}
 
 		//While space is reserved for it, the images contain no actual subcodes
-		//memcpy(subcode,disc->hunk_mem+hunk_ofs*(2352+96)+2352,96);
+		//memcpy(subcode,hunk_data+hunk_ofs*(2352+96)+2352,96);
 		*subcode_type = SUBFMT_NONE;
 
 		return true;
 	}
+
+	u32 ReadRange(u32 FAD, u32 count, u8 *dst, u32 sectorSize) override
+	{
+		if (sectorSize != fmt)
+			return 0;
+		u32 read = disc->readSectors(FAD + Offset, count, dst, fmt);
+		if (swap_bytes)
+			swapBytes(dst, read * fmt);
+
+		return read;
+	}
 };
 
 static u32 getSectorSize(const std::string& type)
@@ -128,14 +160,14 @@ void CHDDisc::tryOpen(const char* file)
 	const chd_header* head = chd_get_header(chd);
 
 	hunkbytes = head->hunkbytes;
-	hunk_mem = new u8[hunkbytes];
-	old_hunk=0xFFFFFFF;
 
 	sph = hunkbytes/(2352+96);
 
 	if (hunkbytes % (2352 + 96) != 0)
 		throw FlycastException(std::string("Invalid hunkbytes for CHD file ") + file);
 
+	hunkCache.init(hunkbytes, head->totalhunks, (u32)std::max(0, (int)config::CHDCacheSize) * 1024 * 1024);
+
 	u32 tag;
 	u8 flags;
 	char temp[512];
@@ -27,6 +27,10 @@ constexpr Disc* (*drivers[])(const char* path, std::vector<u8> *digest)
 };
 
 static u8 q_subchannel[96];
+// max number of sectors read at once
+constexpr u32 RANGE_MAX_SECTORS = 256;
+// max number of raw sectors converted at once
+constexpr u32 RANGE_RAW_SECTORS = 32;
 
 static bool convertSector(u8* in_buff , u8* out_buff , int from , int to,int sector)
 {
@@ -280,6 +284,45 @@ bool Disc::readSector(u32 FAD, u8 *dst, SectorFormat *sector_type, u8 *subcode,
 	return false;
 }
 
+// Read consecutive sectors of the given size from the first track that has them
+u32 Disc::readTracks(u32 FAD, u32 count, u8 *dst, u32 sectorSize)
+{
+	for (size_t i = tracks.size(); i-- > 0; )
+	{
+		u32 read = tracks[i].ReadRange(FAD, count, dst, sectorSize);
+		if (read != 0)
+			return read;
+	}
+
+	return 0;
+}
+
+// Read a run of sectors with a single track read. Returns 0 if the sectors must be read one by one.
+u32 Disc::readRange(u32 FAD, u32 count, u8 *dst, u32 fmt)
+{
+	count = std::min(count, RANGE_MAX_SECTORS);
+	if (fmt == 2048 || fmt == 2352)
+	{
+		// No conversion needed
+		u32 read = readTracks(FAD, count, dst, fmt);
+		if (read != 0)
+		{
+			if (fmt == 2352)
+				memset(q_subchannel, 0, sizeof(q_subchannel));
+			return read;
+		}
+	}
+	if (fmt == 2352)
+		return 0;
+	count = std::min(count, RANGE_RAW_SECTORS);
+	rangeBuffer.resize(RANGE_RAW_SECTORS * 2352);
+	u32 read = readTracks(FAD, count, rangeBuffer.data(), 2352);
+	for (u32 i = 0; i < read; i++)
+		convertSector(&rangeBuffer[i * 2352], dst + i * fmt, 2352, fmt, FAD + i);
+
+	return read;
+}
+
 u32 Disc::ReadSectors(u32 FAD, u32 count, u8* dst, u32 fmt, bool stopOnMiss, LoadProgress *progress)
 {
 	u8 temp[2448];
@@ -295,6 +338,14 @@ u32 Disc::ReadSectors(u32 FAD, u32 count, u8* dst, u32 fmt, bool stopOnMiss, Loa
 			progress->label = "Loading...";
 			progress->progress = (float)i / count;
 		}
+		u32 read = readRange(FAD, count - i, dst, fmt);
+		if (read != 0)
+		{
+			dst += read * fmt;
+			FAD += read;
+			i += read - 1;
+			continue;
+		}
 		if (!readSector(FAD, temp, &secfmt, q_subchannel, &subfmt))
 		{
 			WARN_LOG(GDROM, "Sector Read miss FAD: %d", FAD);
@@ -1,5 +1,6 @@
 #pragma once
 #include "types.h"
+#include <algorithm>
 #include <vector>
 
 #include "emulator.h"
@@ -80,6 +81,11 @@ struct Session
 struct TrackFile
 {
 	virtual bool Read(u32 FAD, u8 *dst, SectorFormat *sector_type, u8 *subcode, SubcodeFormat *subcode_type) = 0;
+	// Read count consecutive sectors of sectorSize bytes. Returns the number of sectors read,
+	// or 0 if the track sectors aren't stored with this size.
+	virtual u32 ReadRange(u32 FAD, u32 count, u8 *dst, u32 sectorSize) {
+		return 0;
+	}
 	virtual ~TrackFile() = default;
 };
 
@@ -99,6 +105,14 @@ struct Track
 		else
 			return false;
 	}
+	u32 ReadRange(u32 FAD, u32 count, u8 *dst, u32 sectorSize)
+	{
+		if (FAD < StartFAD || (FAD > EndFAD && EndFAD != 0) || file == nullptr)
+			return 0;
+		if (EndFAD != 0)
+			count = std::min(count, EndFAD - FAD + 1);
+		return file->ReadRange(FAD, count, dst, sectorSize);
+	}
 	void Destroy() {
 		delete file;
 		file = nullptr;
@@ -208,6 +222,11 @@ struct Disc
 
 private:
 	bool readSector(u32 FAD, u8 *dst, SectorFormat *sector_type, u8 *subcode, SubcodeFormat *subcode_type);
+	u32 readTracks(u32 FAD, u32 count, u8 *dst, u32 sectorSize);
+	u32 readRange(u32 FAD, u32 count, u8 *dst, u32 fmt);
+
+	// raw sectors to convert
+	std::vector<u8> rangeBuffer;
 };
 
 Disc* OpenDisc(const std::string& path, std::vector<u8> *digest = nullptr);
@@ -252,6 +271,14 @@ struct RawTrackFile : TrackFile
 		return true;
 	}
 
+	u32 ReadRange(u32 FAD, u32 count, u8 *dst, u32 sectorSize) override
+	{
+		if (sectorSize != fmt)
+			return 0;
+		std::fseek(file, offset + FAD * fmt, SEEK_SET);
+		return (u32)std::fread(dst, fmt, count, file);
+	}
+
 	~RawTrackFile() override
 	{
 		std::fclose(file);
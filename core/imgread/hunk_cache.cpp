@@ -0,0 +1,155 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "hunk_cache.h"
+#include <algorithm>
+
+void HunkCache::init(u32 hunkSize, u32 totalHunks, u32 cacheSize)
+{
+	this->hunkSize = hunkSize;
+	this->totalHunks = totalHunks;
+	readAheadEnabled = cacheSize != 0;
+	// Keep room for the hunks read ahead of each stream
+	maxHunks = std::max(cacheSize / hunkSize, readAheadEnabled ? READ_AHEAD_HUNKS * (MAX_STREAMS + 1) : 1);
+}
+
+void HunkCache::stop()
+{
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		stopping = true;
+	}
+	readAhead.stop();
+}
+
+// Insert a new hunk in the cache. The mutex must be held.
+std::shared_ptr<HunkCache::Hunk> HunkCache::addHunk(u32 hunk)
+{
+	std::shared_ptr<Hunk> entry = std::make_shared<Hunk>();
+	lru.push_front(hunk);
+	entry->lruIt = lru.begin();
+	hunks[hunk] = entry;
+	while (hunks.size() > maxHunks)
+	{
+		hunks.erase(lru.back());
+		lru.pop_back();
+	}
+	return entry;
+}
+
+// Decompress a hunk. Must be called without holding the mutex.
+bool HunkCache::readHunk(u32 hunk, Hunk& entry)
+{
+	entry.data.resize(hunkSize);
+	std::lock_guard<std::mutex> _(readerMutex);
+	return reader(hunk, entry.data.data());
+}
+
+HunkCache::HunkPtr HunkCache::get(u32 hunk)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	std::shared_ptr<Hunk> entry;
+	auto it = hunks.find(hunk);
+	if (it != hunks.end() && (!it->second->ready || it->second->valid))
+	{
+		entry = it->second;
+		lru.splice(lru.begin(), lru, entry->lruIt);
+		// Wait for the read-ahead thread if it's decompressing this hunk
+		hunkReady.wait(lock, [&entry]() { return entry->ready; });
+	}
+	else
+	{
+		if (it != hunks.end())
+		{
+			// Failed read: try again
+			lru.erase(it->second->lruIt);
+			hunks.erase(it);
+		}
+		entry = addHunk(hunk);
+		lock.unlock();
+		const bool valid = readHunk(hunk, *entry);
+		lock.lock();
+		entry->valid = valid;
+		entry->ready = true;
+		hunkReady.notify_all();
+	}
+	if (readAheadEnabled && !stopping)
+		startReadAhead(hunk);
+	lock.unlock();
+	if (!entry->valid)
+		return nullptr;
+
+	return entry;
+}
+
+// Queue the hunks following the current one of its stream that aren't cached yet. The mutex must be held.
+void HunkCache::startReadAhead(u32 hunk)
+{
+	auto sit = std::find_if(streams.begin(), streams.end(), [hunk](const Stream& stream) {
+		return stream.lastUse != 0 && (hunk == stream.hunk || hunk == stream.hunk + 1);
+	});
+	if (sit == streams.end())
+	{
+		// New position: replace the least recently used stream.
+		// Wait for the next read to see if the data is streamed.
+		sit = std::min_element(streams.begin(), streams.end(), [](const Stream& a, const Stream& b) {
+			return a.lastUse < b.lastUse;
+		});
+		sit->hunk = hunk;
+		sit->nextReadAhead = hunk + 1;
+		sit->lastUse = ++useCount;
+		return;
+	}
+	Stream& stream = *sit;
+	stream.hunk = hunk;
+	stream.lastUse = ++useCount;
+	const u32 last = std::min(hunk + READ_AHEAD_HUNKS, totalHunks - 1);
+	if (stream.nextReadAhead <= hunk || stream.nextReadAhead > last + 1)
+		// new position
+		stream.nextReadAhead = hunk + 1;
+	for (; stream.nextReadAhead <= last; stream.nextReadAhead++)
+		if (hunks.count(stream.nextReadAhead) == 0)
+		{
+			const u32 next = stream.nextReadAhead;
+			readAhead.run([this, next]() { prefetch(next); });
+		}
+}
+
+// Returns true if the hunk is still ahead of a stream. The mutex must be held.
+bool HunkCache::isReadAhead(u32 hunk) const
+{
+	for (const Stream& stream : streams)
+		if (stream.lastUse != 0 && hunk > stream.hunk && hunk <= stream.hunk + READ_AHEAD_HUNKS)
+			return true;
+	return false;
+}
+
+void HunkCache::prefetch(u32 hunk)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	// Skip hunks that aren't needed anymore
+	if (stopping || !isReadAhead(hunk) || hunks.count(hunk) != 0)
+		return;
+	std::shared_ptr<Hunk> entry = addHunk(hunk);
+	lock.unlock();
+	const bool valid = readHunk(hunk, *entry);
+	lock.lock();
+	entry->valid = valid;
+	entry->ready = true;
+	hunkReady.notify_all();
+}
@@ -0,0 +1,100 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+#include "util/worker_thread.h"
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//
+// Decompressed CHD hunks, evicted in LRU order.
+// The hunks following sequentially read ones are decompressed ahead on a worker thread.
+// Several streams are followed at once so that CDDA playback interleaved with data reads
+// is read ahead as well.
+//
+class HunkCache
+{
+public:
+	// Decompress the given hunk into dst. May be called from the worker thread.
+	using Reader = std::function<bool(u32 hunk, u8 *dst)>;
+
+	// number of hunks read ahead of the current one of each stream
+	static constexpr u32 READ_AHEAD_HUNKS = 8;
+	// number of sequential streams followed
+	static constexpr u32 MAX_STREAMS = 4;
+
+	struct Hunk
+	{
+		std::vector<u8> data;
+		std::list<u32>::iterator lruIt;
+		bool ready = false;		// false while being decompressed
+		bool valid = false;
+	};
+	using HunkPtr = std::shared_ptr<const Hunk>;
+
+	HunkCache(Reader reader) : reader(reader) {
+	}
+	~HunkCache() {
+		stop();
+	}
+
+	// A cache size of 0 only keeps the last hunk read and disables read ahead
+	void init(u32 hunkSize, u32 totalHunks, u32 cacheSize);
+	// Returns the decompressed hunk, or nullptr if it can't be read
+	HunkPtr get(u32 hunk);
+	// Wait for the worker thread. The reader isn't called anymore.
+	void stop();
+
+private:
+	struct Stream
+	{
+		u32 hunk = 0;			// last hunk read
+		u32 nextReadAhead = 0;	// next hunk to queue for read ahead
+		u64 lastUse = 0;		// 0 if unused
+	};
+
+	std::shared_ptr<Hunk> addHunk(u32 hunk);
+	bool readHunk(u32 hunk, Hunk& entry);
+	void startReadAhead(u32 hunk);
+	bool isReadAhead(u32 hunk) const;
+	void prefetch(u32 hunk);
+
+	Reader reader;
+	u32 hunkSize = 0;
+	u32 totalHunks = 0;
+	u32 maxHunks = 1;
+	bool readAheadEnabled = false;
+
+	std::unordered_map<u32, std::shared_ptr<Hunk>> hunks;
+	std::list<u32> lru;		// most recently used first
+	std::array<Stream, MAX_STREAMS> streams;
+	u64 useCount = 0;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable hunkReady;
+	// the reader isn't thread safe
+	std::mutex readerMutex;
+	WorkerThread readAhead { "CHD read-ahead" };
+};
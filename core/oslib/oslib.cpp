@@ -53,12 +53,7 @@ std::string getVmuPath(const std::string& port, bool save)
 	{
 		if (settings.platform.isConsole() && !settings.content.gameId.empty())
 		{
-			constexpr std::string_view INVALID_CHARS { " /\\:*?|<>\"" };
-			vmuName = settings.content.gameId;
-			for (char &c: vmuName)
-				if (INVALID_CHARS.find(c) != INVALID_CHARS.npos)
-					c = '_';
-			vmuName += "_vmu_save_A1.bin";
+			vmuName = get_game_id_file_name(settings.content.gameId) + "_vmu_save_A1.bin";
 		}
 		else if (!settings.content.path.empty())
 		{
@@ -44,6 +44,7 @@ using namespace vixl::aarch64;
 #include "hw/mem/addrspace.h"
 #include "oslib/virtmem.h"
 #include "emulator.h"
+#include "cfg/option.h"
 
 struct DynaRBI : RuntimeBlockInfo
 {
@@ -298,6 +299,14 @@ public:
 		Sub(w1, w1, block->guest_cycles);
 		Str(w1, sh4_context_mem_operand(&sh4ctx.cycle_counter));
 
+		if (config::DynarecBlockProfiler)
+		{
+			Mov(x0, reinterpret_cast<uintptr_t>(&block->runs));
+			Ldr(x1, MemOperand(x0));
+			Add(x1, x1, 1);
+			Str(x1, MemOperand(x0));
+		}
+
 		for (size_t i = 0; i < block->oplist.size(); i++)
 		{
 			shil_opcode& op  = block->oplist[i];
@@ -1775,6 +1784,10 @@ private:
 		GenMemAddr(op, &w0);
 		genMmuLookup(op, 0);
 
+		u32 area;
+		if (optimise && bm_GetMemSiteFeedback(block, op, false, area))
+			// This access faulted before: call the handler directly
+			optimise = false;
 		if (!optimise || !GenReadMemoryFast(op, opid))
 			GenReadMemorySlow(op.size);
 
@@ -1925,6 +1938,8 @@ private:
 		// Update rewrite (and perhaps read_memory_rewrite_size) if adding or removing code
 		Ubfx(x1, x0, 0, 29);
 		Add(x1, x1, sizeof(Sh4Context), LeaveFlags);
+		// The faulting instruction identifies the site in rewrite()
+		block->AddMemSite(GetBuffer()->GetCursorOffset(), op, false);
 
 		switch (op.size)
 		{
@@ -1961,6 +1976,17 @@ private:
 			shil_param_to_host_reg(op.rs2, w1);
 		else
 			shil_param_to_host_reg(op.rs2, x1);
+		u32 area;
+		if (optimise && bm_GetMemSiteFeedback(block, op, true, area))
+		{
+			// This access faulted before: call the right handler directly
+			if (op.size >= 4 && area == 0x38)
+			{
+				GenWriteStoreQueue(op.size);
+				return;
+			}
+			optimise = false;
+		}
 		if (optimise && GenWriteMemoryFast(op, opid))
 			return;
 
@@ -2067,6 +2093,7 @@ private:
 		// Update rewrite (and perhaps write_memory_rewrite_size) if adding or removing code
 		Ubfx(x7, x0, 0, 29);
 		Add(x7, x7, sizeof(Sh4Context), LeaveFlags);
+		block->AddMemSite(GetBuffer()->GetCursorOffset(), op, true);
 
 		switch(op.size)
 		{
@@ -2417,6 +2444,7 @@ public:
 			}
 		}
 		verify(found);
+		bm_SetMemSiteFeedback((void *)context.pc, context.x0);
 
 		// Skip the preceding ops (add, ubfx)
 		u32 *code_rewrite = code_ptr - 2;
@@ -147,6 +147,11 @@ public:
 		}
 		mov(rax, (uintptr_t)&sh4ctx.cycle_counter);
 		sub(dword[rax], block->guest_cycles);
+		if (config::DynarecBlockProfiler)
+		{
+			mov(rax, (uintptr_t)&block->runs);
+			inc(qword[rax]);
+		}
 
 		regalloc.DoAlloc(block);
 
@@ -233,7 +238,7 @@ public:
 					genMmuLookup(block, op, 0);
 
 					int size = op.size == 1 ? MemSize::S8 : op.size == 2 ? MemSize::S16 : op.size == 4 ? MemSize::S32 : MemSize::S64;
-					GenCall((void (*)())MemHandlers[optimise ? MemType::Fast : MemType::Slow][size][MemOp::R], mmu_enabled());
+					genMemHandlerCall(block, op, size, MemOp::R, optimise);
 
 #if ALLOC_F64 == false
 					if (size == MemSize::S64)
@@ -280,7 +285,7 @@ public:
 						shil_param_to_host_reg(op.rs2, call_regs64[1]);
 
 					int size = op.size == 1 ? MemSize::S8 : op.size == 2 ? MemSize::S16 : op.size == 4 ? MemSize::S32 : MemSize::S64;
-					GenCall((void (*)())MemHandlers[optimise ? MemType::Fast : MemType::Slow][size][MemOp::W], mmu_enabled());
+					genMemHandlerCall(block, op, size, MemOp::W, optimise);
 				}
 			}
 			break;
@@ -782,6 +787,7 @@ public:
 				//found !
 				const u8 *start = getCurr();
 				u32 memAddress = context.r9;
+				bm_SetMemSiteFeedback(retAddr, memAddress);
 				if (op == MemOp::W && size >= MemSize::S32 && (memAddress >> 26) == 0x38)
 					call(MemHandlers[MemType::StoreQueue][size][MemOp::W]);
 				else
@@ -810,6 +816,28 @@ public:
 	}
 
 private:
+	void genMemHandlerCall(RuntimeBlockInfo* block, const shil_opcode& op, int size, int memOp, bool optimise)
+	{
+		int type = optimise ? MemType::Fast : MemType::Slow;
+		u32 area;
+		if (optimise && bm_GetMemSiteFeedback(block, op, memOp == MemOp::W, area))
+		{
+			// This access faulted before: call the right handler directly
+			if (memOp == MemOp::W && size >= MemSize::S32 && area == 0x38)
+				type = MemType::StoreQueue;
+			else
+				type = MemType::Slow;
+		}
+		if (!mmu_enabled())
+			saveXmmRegisters();
+		call(CC_RX2RW(MemHandlers[type][size][memOp]));
+		if (type == MemType::Fast)
+			// The return address identifies the site in rewriteMemAccess()
+			block->AddMemSite((u32)getSize(), op, memOp == MemOp::W);
+		if (!mmu_enabled())
+			restoreXmmRegisters();
+	}
+
 	void genMmuLookup(const RuntimeBlockInfo* block, const shil_opcode& op, u32 write)
 	{
 		if (mmu_enabled())
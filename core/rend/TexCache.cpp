@@ -18,6 +18,8 @@
 #include "deps/xbrz/xbrz.h"
 #include "hw/pvr/pvr_mem.h"
 #include "hw/mem/addrspace.h"
+#include "util/worker_thread.h"
+#include "stdclass.h"
 
 #include <mutex>
 #include <xxhash.h>
@@ -28,6 +30,11 @@
 
 extern bool pal_needs_update;
 
+TextureDecodeStats BaseTextureCacheData::decodeStats;
+DecodedTextureCache BaseTextureCacheData::decodedCache;
+// Textures updated again on the next frame this many times in a row aren't added to the decoded texture cache
+constexpr u32 MAX_CONSECUTIVE_UPDATES = 2;
+
 // Rough approximation of LoD bias from D adjust param, only used to increase LoD
 const std::array<f32, 16> D_Adjust_LoD_Bias = {
 		0.f, -4.f, -2.f, -1.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f
@@ -79,6 +86,9 @@ static void vramlock_list_add(vram_block* block)
  
 static std::mutex vramlist_lock;
 
+// Maximum size of a single write to vram
+constexpr u32 VRAM_WRITE_MARGIN = 64;
+
 bool VramLockedWriteOffset(size_t offset)
 {
 	if (offset >= VRAM_SIZE || VramLocks == nullptr)
@@ -94,7 +104,12 @@ bool VramLockedWriteOffset(size_t offset)
 		{
 			if (lock != nullptr)
 			{
-				lock->texture->invalidate();
+				// The faulting address may be anywhere within a wide store
+				if (lock->start < offset + VRAM_WRITE_MARGIN && lock->end + VRAM_WRITE_MARGIN > offset)
+					lock->texture->invalidate();
+				else
+					// Written outside of the texture data
+					lock->texture->unwatch();
 
 				if (lock != nullptr)
 				{
@@ -228,7 +243,18 @@ void BaseTextureCacheData::PrintTextureName()
 
 //true if : dirty or paletted texture and hashes don't match
 bool BaseTextureCacheData::NeedsUpdate() {
-	bool rc = dirty != 0;
+	if (unwatched)
+	{
+		// Protect the texture data again, then check if it has been modified while it wasn't protected
+		unwatched = false;
+		protectVRam();
+		if (hashVRam() != unwatchedHash)
+		{
+			unprotectVRam();
+			dirty = FrameCount;
+		}
+	}
+	bool rc = dirty != 0 || (asyncDecode != nullptr && asyncDecode->ready);
 	if (tex_type != TextureType::_8)
 	{
 		if (tcw.PixelFmt == PixelPal4 && palette_hash != pal_hash_16[tcw.PalSelect])
@@ -280,11 +306,15 @@ void BaseTextureCacheData::unprotectVRam()
 	if (lock_block)
 		libCore_vramlock_Unlock_block_wb(lock_block);
 	lock_block = nullptr;
+	// Changes to the texture data aren't tracked anymore
+	unwatched = false;
 }
 
 bool BaseTextureCacheData::Delete()
 {
 	unprotectVRam();
+	// The decoding job owns its data so it can safely complete on its own
+	asyncDecode.reset();
 
 	if (custom_load_in_progress > 0)
 		return false;
@@ -308,6 +338,8 @@ BaseTextureCacheData::BaseTextureCacheData(TSP tsp, TCW tcw, int area)
 
 	//Reset state info ..
 	Updates = 0;
+	lastUpdate = 0;
+	consecutiveUpdates = 0;
 	dirty = FrameCount;
 	lock_block = nullptr;
 	custom_image_data = nullptr;
@@ -436,10 +468,36 @@ void BaseTextureCacheData::ComputeHash()
 
 bool BaseTextureCacheData::Update()
 {
+	if (asyncDecode != nullptr)
+	{
+		if (!asyncDecode->ready)
+		{
+			// Keep using the current version until the pending one is decoded.
+			// The texture is still dirty if it has been modified since so it will be decoded again.
+			decodeStats.staleUses++;
+			return true;
+		}
+		std::shared_ptr<TextureDecode> decode = std::move(asyncDecode);
+		uploadDecoded(*decode);
+		if (decode->contentKey != 0)
+			cacheDecoded(decode);
+		u64 latency = getTimeMs() - decode->requestTime;
+		decodeStats.totalLatency += latency;
+		decodeStats.maxLatency = std::max(decodeStats.maxLatency, latency);
+		if (dirty == 0)
+			return true;
+	}
 	//texture state tracking stuff
 	Updates++;
+	if (Updates > 1 && FrameCount - lastUpdate <= 1)
+		consecutiveUpdates++;
+	else
+		consecutiveUpdates = 0;
+	lastUpdate = FrameCount;
 	dirty = 0;
+	unwatched = false;
 	gpuPalette = false;
+	const TextureType previousType = tex_type;
 	tex_type = tex->type;
 
 	bool has_alpha = false;
@@ -471,9 +529,6 @@ bool BaseTextureCacheData::Update()
 		}
 	}
 
-	if (tcw.VQ_Comp)
-		::vq_codebook = &vram[startAddress];
-
 	//texture conversion work
 	u32 stride = width;
 
@@ -519,14 +574,6 @@ bool BaseTextureCacheData::Update()
 		custom_texture.loadCustomTextureAsync(this);
 	}
 
-	void *temp_tex_buffer = NULL;
-	u32 upscaled_w = width;
-	u32 upscaled_h = height;
-
-	PixelBuffer<u16> pb16;
-	PixelBuffer<u32> pb32;
-	PixelBuffer<u8> pb8;
-
 	// Figure out if we really need to use a 32-bit pixel buffer
 	bool textureUpscaling = config::TextureUpscale > 1
 			// Don't process textures that are too big
@@ -541,15 +588,157 @@ bool BaseTextureCacheData::Update()
 		need_32bit_buffer = false;
 	// TODO avoid upscaling/depost. textures that change too often
 
-	bool mipmapped = IsMipmapped() && !config::DumpTextures;
+	std::shared_ptr<TextureDecode> decode = std::make_shared<TextureDecode>();
+	decode->tsp = tsp;
+	decode->tcw = tcw;
+	decode->tex = tex;
+	decode->texconv = texconv;
+	decode->texconv32 = texconv32;
+	decode->texconv8 = texconv8;
+	decode->yuvTexconv32 = pvrTexInfo[Pixel565].TW32;
+	decode->startAddress = startAddress;
+	decode->mmStartAddress = mmStartAddress;
+	decode->width = width;
+	decode->height = height;
+	decode->stride = stride;
+	decode->heightLimit = heightLimit;
+	decode->upscale = textureUpscaling ? (int)config::TextureUpscale : 1;
+	decode->need32bit = need_32bit_buffer;
+	decode->mipmapped = IsMipmapped() && !config::DumpTextures;
+	decode->hasAlpha = has_alpha;
+	decode->texType = tex_type;
+
+	decode->contentKey = getContentKey(*decode);
+	if (decode->contentKey != 0)
+	{
+		std::shared_ptr<const TextureDecode> cached = decodedCache.find(decode->contentKey);
+		if (cached == nullptr && decode->upscale > 1)
+		{
+			// Upscaled in a previous session
+			cached = texdiskcache::find(decode->contentKey);
+			if (cached != nullptr)
+				decodedCache.add(decode->contentKey, cached);
+		}
+		if (cached != nullptr)
+		{
+			// Already decoded for another texture with the same content, or a previous version of this one
+			protectVRam();
+			uploadDecoded(*cached);
+			size = originalSize;
+			return true;
+		}
+	}
+
+	if (canDecodeAsync())
+	{
+		// Decode a copy of the texture data on the worker thread and keep using the current version
+		// until it's done. The new version is uploaded on the next update following its completion.
+		static WorkerThread decoderThread("Texture decoder");
+		const u8 *src = &vram[startAddress];
+		decode->vramCopy.assign(src, src + (mmStartAddress + size - startAddress));
+		decode->vramData = decode->vramCopy.data();
+		decode->vramOffset = startAddress;
+		decode->requestTime = getTimeMs();
+		asyncDecode = decode;
+		decodeStats.asyncDecodes++;
+		// Restore the type of the current version
+		tex_type = previousType;
+		//lock the texture to detect changes in it
+		protectVRam();
+		decoderThread.run([decode]() {
+			decode->decode();
+			decode->ready = true;
+		});
+	}
+	else
+	{
+		decode->vramData = &vram[0];
+		decode->vramOffset = 0;
+		decode->decode();
+		decodeStats.syncDecodes++;
+		//lock the texture to detect changes in it
+		protectVRam();
+		uploadDecoded(*decode);
+		if (decode->contentKey != 0)
+			cacheDecoded(decode);
+	}
+	// Restore the original texture size if it was constrained to VRAM limits above
+	size = originalSize;
+
+	return true;
+}
+
+bool BaseTextureCacheData::canDecodeAsync() const
+{
+	// Paletted textures depend on the palette ram, which may change while decoding.
+	// A previous version must be available to be used in the meantime.
+	return config::AsyncTextureDecode
+			&& Updates > 1
+			&& tcw.PixelFmt != PixelPal4 && tcw.PixelFmt != PixelPal8
+			&& !config::DumpTextures
+			&& !custom_texture.enabled();
+}
+
+u64 BaseTextureCacheData::getContentKey(const TextureDecode& decode)
+{
+	if ((config::DecodedTextureCacheSize <= 0 && !(config::UpscaledTextureDiskCache && decode.upscale > 1))
+			// The data of stride textures isn't contiguous
+			|| decode.stride != decode.width
+			// Textures updated every frame (movies, render to texture) are unlikely to be reused
+			|| consecutiveUpdates >= MAX_CONSECUTIVE_UPDATES)
+		return 0;
+	// Everything but texaddr, reserved and stride. Palette textures don't have ScanOrder
+	const u32 tcwMask = IsPaletted() ? 0xF8000000 : 0xFC000000;
+	const u32 params[] {
+		tcw.full & tcwMask,
+		IsPaletted() && !gpuPalette ? palette_hash : 0,
+		decode.width | (decode.height << 16),
+		decode.heightLimit | (decode.upscale << 16) | ((u32)decode.texType << 24),
+		(u32)decode.need32bit | (decode.mipmapped << 1) | (decode.hasAlpha << 2)
+			| ((pvrTexInfo == directx::pvrTexInfo) << 3),
+	};
+	// Hash the whole texture data including the vq codebook and lower mipmap levels
+	u64 key = XXH3_64bits_withSeed(&vram[startAddress], mmStartAddress + size - startAddress,
+			XXH3_64bits(params, sizeof(params)));
+
+	return key != 0 ? key : 1;
+}
+
+void BaseTextureCacheData::cacheDecoded(const std::shared_ptr<TextureDecode>& decode)
+{
+	std::vector<u8>().swap(decode->vramCopy);
+	decodedCache.add(decode->contentKey, decode);
+	if (decode->upscale > 1)
+		texdiskcache::add(decode->contentKey, decode);
+}
 
-	if (texconv32 != NULL && need_32bit_buffer)
+void BaseTextureCacheData::uploadDecoded(const TextureDecode& decode)
+{
+	tex_type = decode.texType;
+	UploadToGPU(decode.outWidth, decode.outHeight, decode.data, IsMipmapped(), decode.mipmapsIncluded);
+	if (config::DumpTextures)
 	{
-		if (textureUpscaling)
+		ComputeHash();
+		custom_texture.dumpTexture(this, decode.outWidth, decode.outHeight, (void *)decode.data);
+		NOTICE_LOG(RENDERER, "Dumped texture %x.png. Old hash %x", texture_hash, old_texture_hash);
+	}
+	PrintTextureName();
+}
+
+void TextureDecode::decode()
+{
+	if (tcw.VQ_Comp)
+		::vq_codebook = vramPtr(startAddress);
+	outWidth = width;
+	outHeight = height;
+
+	if (texconv32 != NULL && need32bit)
+	{
+		if (upscale > 1)
 			// don't use mipmaps if upscaling
 			mipmapped = false;
 		// Force the texture type since that's the only 32-bit one we know
-		tex_type = TextureType::_8888;
+		texType = TextureType::_8888;
 
 		if (mipmapped)
 		{
@@ -568,7 +757,7 @@ bool BaseTextureCacheData::Update()
 						if (tcw.PixelFmt == PixelYUV)
 							// Use higher LoD mipmap
 							vram_addr = startAddress + VQMipPoint[1];
-						texconv32(&pb0, &vram[vram_addr], 2, 2);
+						texconv32(&pb0, vramPtr(vram_addr), 2, 2);
 						*pb32.data() = *pb0.data(1, 1);
 						continue;
 					}
@@ -577,35 +766,35 @@ bool BaseTextureCacheData::Update()
 					vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
 				if (tcw.PixelFmt == PixelYUV && i == 0)
 					// Special case for YUV at 1x1 LoD
-					pvrTexInfo[Pixel565].TW32(&pb32, &vram[vram_addr], 1, 1);
+					yuvTexconv32(&pb32, vramPtr(vram_addr), 1, 1);
 				else
-					texconv32(&pb32, &vram[vram_addr], 1 << i, 1 << i);
+					texconv32(&pb32, vramPtr(vram_addr), 1 << i, 1 << i);
 			}
 			pb32.set_mipmap(0);
 		}
 		else
 		{
 			pb32.init(width, height);
-			texconv32(&pb32, (u8*)&vram[mmStartAddress], stride, heightLimit);
+			texconv32(&pb32, vramPtr(mmStartAddress), stride, heightLimit);
 
 			// xBRZ scaling
-			if (textureUpscaling)
+			if (upscale > 1)
 			{
 				PixelBuffer<u32> tmp_buf;
-				tmp_buf.init(width * config::TextureUpscale, height * config::TextureUpscale);
+				tmp_buf.init(width * upscale, height * upscale);
 
 				if (tcw.PixelFmt == Pixel1555 || tcw.PixelFmt == Pixel4444)
 					// Alpha channel formats. Palettes with alpha are already handled
-					has_alpha = true;
-				UpscalexBRZ(config::TextureUpscale, pb32.data(), tmp_buf.data(), width, height, has_alpha);
+					hasAlpha = true;
+				UpscalexBRZ(upscale, pb32.data(), tmp_buf.data(), width, height, hasAlpha);
 				pb32.steal_data(tmp_buf);
-				upscaled_w *= config::TextureUpscale;
-				upscaled_h *= config::TextureUpscale;
+				outWidth *= upscale;
+				outHeight *= upscale;
 			}
 		}
-		temp_tex_buffer = pb32.data();
+		data = (const u8 *)pb32.data();
 	}
-	else if (texconv8 != NULL && tex_type == TextureType::_8)
+	else if (texconv8 != NULL && texType == TextureType::_8)
 	{
 		if (mipmapped)
 		{
@@ -615,16 +804,16 @@ bool BaseTextureCacheData::Update()
 			{
 				pb8.set_mipmap(i);
 				u32 vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
-				texconv8(&pb8, &vram[vram_addr], 1 << i, 1 << i);
+				texconv8(&pb8, vramPtr(vram_addr), 1 << i, 1 << i);
 			}
 			pb8.set_mipmap(0);
 		}
 		else
 		{
 			pb8.init(width, height);
-			texconv8(&pb8, &vram[mmStartAddress], stride, height);
+			texconv8(&pb8, vramPtr(mmStartAddress), stride, height);
 		}
-		temp_tex_buffer = pb8.data();
+		data = pb8.data();
 	}
 	else if (texconv != NULL)
 	{
@@ -642,23 +831,23 @@ bool BaseTextureCacheData::Update()
 					{
 						PixelBuffer<u16> pb0;
 						pb0.init(2, 2 ,false);
-						texconv(&pb0, (u8*)&vram[vram_addr], 2, 2);
+						texconv(&pb0, vramPtr(vram_addr), 2, 2);
 						*pb16.data() = *pb0.data(1, 1);
 						continue;
 					}
 				}
 				else
 					vram_addr = startAddress + OtherMipPoint[i] * tex->bpp / 8;
-				texconv(&pb16, (u8*)&vram[vram_addr], 1 << i, 1 << i);
+				texconv(&pb16, vramPtr(vram_addr), 1 << i, 1 << i);
 			}
 			pb16.set_mipmap(0);
 		}
 		else
 		{
 			pb16.init(width, height);
-			texconv(&pb16, (u8*)&vram[mmStartAddress], stride, heightLimit);
+			texconv(&pb16, vramPtr(mmStartAddress), stride, heightLimit);
 		}
-		temp_tex_buffer = pb16.data();
+		data = (const u8 *)pb16.data();
 	}
 	else
 	{
@@ -666,24 +855,58 @@ bool BaseTextureCacheData::Update()
 		WARN_LOG(RENDERER, "UNHANDLED TEXTURE");
 		pb16.init(width, height);
 		memset(pb16.data(), 0x80, width * height * 2);
-		temp_tex_buffer = pb16.data();
+		data = (const u8 *)pb16.data();
 		mipmapped = false;
 	}
-	//lock the texture to detect changes in it
-	protectVRam();
+	mipmapsIncluded = mipmapped;
+
+	const u32 pixelSize = texType == TextureType::_8888 ? 4 : texType == TextureType::_8 ? 1 : 2;
+	dataSize = outWidth * outHeight;
+	if (mipmapsIncluded)
+		for (u32 w = outWidth / 2, h = outHeight / 2; w != 0 && h != 0; w /= 2, h /= 2)
+			dataSize += w * h;
+	dataSize *= pixelSize;
+}
 
-	UploadToGPU(upscaled_w, upscaled_h, (const u8 *)temp_tex_buffer, IsMipmapped(), mipmapped);
-	if (config::DumpTextures)
+std::shared_ptr<const TextureDecode> DecodedTextureCache::find(u64 key)
+{
+	auto it = entries.find(key);
+	if (it == entries.end())
 	{
-		ComputeHash();
-		custom_texture.dumpTexture(this, upscaled_w, upscaled_h, temp_tex_buffer);
-		NOTICE_LOG(RENDERER, "Dumped texture %x.png. Old hash %x", texture_hash, old_texture_hash);
+		misses++;
+		return nullptr;
 	}
-	PrintTextureName();
-	// Restore the original texture size if it was constrained to VRAM limits above
-	size = originalSize;
+	hits++;
+	lru.splice(lru.begin(), lru, it->second.lruIt);
 
-	return true;
+	return it->second.decode;
+}
+
+void DecodedTextureCache::add(u64 key, const std::shared_ptr<const TextureDecode>& decode)
+{
+	if (entries.count(key) != 0)
+		return;
+	lru.push_front(key);
+	entries[key] = { decode, lru.begin() };
+	totalSize += decode->dataSize;
+
+	const size_t maxSize = (size_t)std::max(0, (int)config::DecodedTextureCacheSize) * 1024 * 1024;
+	while (totalSize > maxSize && !lru.empty())
+	{
+		auto it = entries.find(lru.back());
+		totalSize -= it->second.decode->dataSize;
+		entries.erase(it);
+		lru.pop_back();
+	}
+}
+
+void DecodedTextureCache::clear()
+{
+	entries.clear();
+	lru.clear();
+	totalSize = 0;
+	hits = 0;
+	misses = 0;
 }
 
 void BaseTextureCacheData::CheckCustomTexture()
@@ -1225,6 +1448,25 @@ void BaseTextureCacheData::invalidate()
 	lock_block = nullptr;
 }
 
+void BaseTextureCacheData::unwatch()
+{
+	// The vram page is about to be unprotected so writes to the texture data won't be detected anymore.
+	// Hash the data before it's modified and compare when the texture is used again.
+	unwatchedHash = hashVRam();
+	unwatched = true;
+
+	libCore_vramlock_Unlock_block_wb(lock_block);
+	lock_block = nullptr;
+}
+
+u64 BaseTextureCacheData::hashVRam() const
+{
+	u32 end = std::min<u32>(mmStartAddress + size, VRAM_SIZE);
+	if (startAddress >= end)
+		return 0;
+	return XXH3_64bits(&vram[startAddress], end - startAddress);
+}
+
 void getRenderToTextureDimensions(u32& width, u32& height, u32& pow2Width, u32& pow2Height)
 {
 	pow2Width = 8;
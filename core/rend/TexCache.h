@@ -20,10 +20,13 @@
 #include "cfg/option.h"
 #include "texconv.h"
 #include "CustomTexture.h"
+#include "TextureDiskCache.h"
 
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <list>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -44,6 +47,94 @@ bool VramLockedWrite(u8* address);
 
 void UpscalexBRZ(int factor, u32* source, u32* dest, int width, int height, bool has_alpha);
 
+//
+// Texture conversion job.
+// Holds a copy of everything needed to convert a texture so that it can run on a worker thread.
+//
+struct TextureDecode
+{
+	// Input
+	TSP tsp;
+	TCW tcw;
+	const PvrTexInfo *tex;
+	TexConvFP texconv;
+	TexConvFP32 texconv32;
+	TexConvFP8 texconv8;
+	TexConvFP32 yuvTexconv32;	// used for the 1x1 LoD of YUV mipmaps
+	const u8 *vramData;			// texture data. VRAM address a is at vramData[a - vramOffset]
+	u32 vramOffset;
+	u32 startAddress;
+	u32 mmStartAddress;
+	u32 width;
+	u32 height;
+	u32 stride;
+	u32 heightLimit;
+	int upscale;				// xBRZ scaling factor, 1 if none
+	bool need32bit;
+	bool mipmapped;
+	bool hasAlpha;
+	TextureType texType;
+
+	// Output
+	PixelBuffer<u32> pb32;
+	PixelBuffer<u16> pb16;
+	PixelBuffer<u8> pb8;
+	const u8 *data = nullptr;
+	u32 outWidth = 0;
+	u32 outHeight = 0;
+	bool mipmapsIncluded = false;
+	size_t dataSize = 0;		// in bytes
+
+	u64 contentKey = 0;			// decoded texture cache key, 0 if not cacheable
+
+	// Asynchronous decoding
+	std::vector<u8> vramCopy;
+	u64 requestTime = 0;
+	std::atomic_bool ready { false };
+
+	void decode();
+
+private:
+	const u8 *vramPtr(u32 address) const {
+		return &vramData[address - vramOffset];
+	}
+};
+
+struct TextureDecodeStats
+{
+	u64 syncDecodes;	// textures decoded on the render thread
+	u64 asyncDecodes;	// textures decoded on the worker thread while the stale version was used
+	u64 staleUses;		// updates skipped because the new version wasn't decoded yet
+	u64 totalLatency;	// total time between async decode requests and their upload, in ms
+	u64 maxLatency;		// in ms
+};
+
+//
+// Decoded textures shared by all the textures with the same content, whatever their vram address.
+// Entries are keyed by a hash of the texture data and decoding parameters, and evicted in LRU order
+// when the total size exceeds config::DecodedTextureCacheSize.
+//
+class DecodedTextureCache
+{
+public:
+	std::shared_ptr<const TextureDecode> find(u64 key);
+	void add(u64 key, const std::shared_ptr<const TextureDecode>& decode);
+	void clear();
+
+	u64 hits = 0;
+	u64 misses = 0;
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<const TextureDecode> decode;
+		std::list<u64>::iterator lruIt;
+	};
+	std::unordered_map<u64, Entry> entries;
+	std::list<u64> lru;		// most recently used first
+	size_t totalSize = 0;
+};
+
 class BaseTextureCacheData
 {
 protected:
@@ -57,6 +148,8 @@ public:
 		tex_type = other.tex_type;
 		startAddress = other.startAddress;
 		dirty = other.dirty;
+		unwatched = other.unwatched;
+		unwatchedHash = other.unwatchedHash;
 		std::swap(lock_block, other.lock_block);
 		mmStartAddress = other.mmStartAddress;
 		width = other.width;
@@ -67,6 +160,8 @@ public:
 		texconv32 = other.texconv32;
 		texconv8 = other.texconv8;
 		Updates = other.Updates;
+		lastUpdate = other.lastUpdate;
+		consecutiveUpdates = other.consecutiveUpdates;
 		palette_hash = other.palette_hash;
 		texture_hash = other.texture_hash;
 		old_vqtexture_hash = other.old_vqtexture_hash;
@@ -75,6 +170,7 @@ public:
 		custom_width = other.custom_width;
 		custom_height = other.custom_height;
 		custom_load_in_progress = 0;
+		std::swap(asyncDecode, other.asyncDecode);
 		gpuPalette = other.gpuPalette;
 		area = other.area;
 	}
@@ -88,6 +184,8 @@ public:
 
 	u32 dirty;			// frame number at which texture was overwritten
 	vram_block* lock_block;
+	bool unwatched = false;	// vram page written outside of the texture, and no longer protected
+	u64 unwatchedHash = 0;	// hash of the texture data when it was unprotected
 
 	u32 mmStartAddress; // pixel data start address of max level mipmap
 	u16 width, height;	// width & height of the texture
@@ -99,6 +197,8 @@ public:
 	TexConvFP8 texconv8;
 
 	u32 Updates;
+	u32 lastUpdate;			// frame number of the last update
+	u32 consecutiveUpdates;	// number of updates in a row on consecutive frames
 
 	//used for palette updates
 	u32 palette_hash;			// Palette hash at time of last update
@@ -109,6 +209,7 @@ public:
 	u32 custom_width;
 	u32 custom_height;
 	std::atomic_int custom_load_in_progress;
+	std::shared_ptr<TextureDecode> asyncDecode;	// pending asynchronous decoding
 	bool gpuPalette;
 	u8 area;
 
@@ -157,6 +258,7 @@ public:
 	void protectVRam();
 	void unprotectVRam();
 	void invalidate();
+	void unwatch();
 
 	static bool IsGpuHandledPaletted(TSP tsp, TCW tcw, int area)
 	{
@@ -173,6 +275,16 @@ public:
 				&& area == 0;
 	}
 	static void SetDirectXColorOrder(bool enabled);
+
+	static TextureDecodeStats decodeStats;
+	static DecodedTextureCache decodedCache;
+
+private:
+	bool canDecodeAsync() const;
+	u64 getContentKey(const TextureDecode& decode);
+	void cacheDecoded(const std::shared_ptr<TextureDecode>& decode);
+	u64 hashVRam() const;
+	void uploadDecoded(const TextureDecode& decode);
 };
 
 template<typename Texture>
@@ -267,6 +379,17 @@ public:
 
 		cache.clear();
 		INFO_LOG(RENDERER, "Texture cache cleared");
+		const TextureDecodeStats& stats = BaseTextureCacheData::decodeStats;
+		if (stats.asyncDecodes != 0)
+			INFO_LOG(RENDERER, "Texture decoding: %d sync, %d async, %d stale uses, latency avg %d ms max %d ms",
+					(int)stats.syncDecodes, (int)stats.asyncDecodes, (int)stats.staleUses,
+					(int)(stats.totalLatency / stats.asyncDecodes), (int)stats.maxLatency);
+		DecodedTextureCache& decodedCache = BaseTextureCacheData::decodedCache;
+		if (decodedCache.hits != 0)
+			INFO_LOG(RENDERER, "Decoded texture cache: %d hits, %d misses",
+					(int)decodedCache.hits, (int)decodedCache.misses);
+		decodedCache.clear();
+		texdiskcache::close();
 	}
 
 protected:
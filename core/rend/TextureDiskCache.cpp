@@ -0,0 +1,316 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TextureDiskCache.h"
+#include "TexCache.h"
+#include "cfg/option.h"
+#include "stdclass.h"
+#include "util/worker_thread.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace texdiskcache
+{
+
+constexpr u32 MAGIC = 0x43584554;	// TEXC
+// Bump when the texture conversion or xBRZ output changes
+constexpr u32 FORMAT_VERSION = 1;
+// Textures aren't added past this file size
+constexpr u64 MAX_FILE_SIZE = 1024_MB;
+constexpr u32 MAX_TEXTURE_SIZE = 8192;
+
+struct FileHeader
+{
+	u32 magic;
+	u32 version;
+};
+
+struct EntryHeader
+{
+	u64 key;
+	u32 width;
+	u32 height;
+};
+
+struct Entry
+{
+	u64 offset;	// of the texture data
+	u32 width;
+	u32 height;
+	bool loading;	// queued for reading
+	// Texture read from the file
+	std::shared_ptr<const TextureDecode> decode;
+};
+
+// Only contains entries that are fully written to the file.
+// The file and fileSize are only accessed by the worker thread, without holding the mutex.
+static std::mutex mutex;
+static std::unordered_map<u64, Entry> entries;
+static std::string loadedGameId;
+static bool loaded;
+static FILE *file;
+static u64 fileSize;		// end of the last valid entry
+static std::atomic_bool closing;
+static WorkerThread worker("Texture disk cache");
+
+static std::string getCachePath(const std::string& gameId)
+{
+	return get_writable_data_path(get_game_id_file_name(gameId) + ".texcache");
+}
+
+// Read the texture data of the given entry
+static std::shared_ptr<const TextureDecode> readEntry(const Entry& entry)
+{
+	if (file == nullptr)
+		return nullptr;
+	std::shared_ptr<TextureDecode> decode = std::make_shared<TextureDecode>();
+	decode->pb32.init(entry.width, entry.height);
+	if (std::fseek(file, (long)entry.offset, SEEK_SET) != 0
+			|| std::fread(decode->pb32.data(), entry.width * 4, entry.height, file) != entry.height)
+	{
+		WARN_LOG(RENDERER, "Error reading texture cache at offset %d", (int)entry.offset);
+		return nullptr;
+	}
+	decode->data = (const u8 *)decode->pb32.data();
+	decode->outWidth = entry.width;
+	decode->outHeight = entry.height;
+	decode->texType = TextureType::_8888;
+	decode->dataSize = entry.width * entry.height * 4;
+
+	return decode;
+}
+
+// Read the texture with the given key into memory. Runs on the worker thread.
+static void loadEntry(u64 key)
+{
+	Entry entry;
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		auto it = entries.find(key);
+		if (it == entries.end())
+			return;
+		if (it->second.decode != nullptr || closing)
+		{
+			it->second.loading = false;
+			return;
+		}
+		entry = it->second;
+	}
+	std::shared_ptr<const TextureDecode> decode = readEntry(entry);
+	std::lock_guard<std::mutex> _(mutex);
+	auto it = entries.find(key);
+	if (it == entries.end())
+		return;
+	if (decode == nullptr)
+		entries.erase(it);
+	else
+	{
+		it->second.decode = decode;
+		it->second.loading = false;
+	}
+}
+
+static void preload()
+{
+	std::vector<std::pair<u64, size_t>> keys;
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		for (const auto& [key, entry] : entries)
+			keys.emplace_back(key, entry.width * entry.height * 4);
+	}
+	const size_t maxSize = (size_t)std::max(0, (int)config::TextureDiskCachePreloadSize) * 1024 * 1024;
+	size_t size = 0;
+	int count = 0;
+	for (const auto& [key, dataSize] : keys)
+	{
+		if (closing)
+			break;
+		size += dataSize;
+		if (size > maxSize)
+			break;
+		loadEntry(key);
+		count++;
+	}
+	if (count > 0)
+		INFO_LOG(RENDERER, "Preloaded %d upscaled textures", count);
+}
+
+// Open the cache file and read its index. Runs on the worker thread.
+static void openFile(const std::string& gameId)
+{
+	std::string path = getCachePath(gameId);
+	file = nowide::fopen(path.c_str(), "r+b");
+	FileHeader header;
+	if (file != nullptr
+			&& (std::fread(&header, sizeof(header), 1, file) != 1 || header.magic != MAGIC || header.version != FORMAT_VERSION))
+	{
+		INFO_LOG(RENDERER, "Ignoring outdated texture cache %s", path.c_str());
+		std::fclose(file);
+		file = nullptr;
+	}
+	if (file == nullptr)
+	{
+		file = nowide::fopen(path.c_str(), "w+b");
+		header = { MAGIC, FORMAT_VERSION };
+		if (file == nullptr || std::fwrite(&header, sizeof(header), 1, file) != 1)
+		{
+			WARN_LOG(RENDERER, "Cannot create texture cache %s", path.c_str());
+			if (file != nullptr)
+				std::fclose(file);
+			file = nullptr;
+		}
+		fileSize = sizeof(header);
+		return;
+	}
+	// Read the index. New entries are written after the last valid one.
+	fileSize = sizeof(header);
+	std::unordered_map<u64, Entry> index;
+	EntryHeader entryHeader;
+	while (std::fread(&entryHeader, sizeof(entryHeader), 1, file) == 1
+			&& entryHeader.width != 0 && entryHeader.width <= MAX_TEXTURE_SIZE
+			&& entryHeader.height != 0 && entryHeader.height <= MAX_TEXTURE_SIZE)
+	{
+		u64 dataSize = entryHeader.width * entryHeader.height * 4;
+		u64 offset = fileSize + sizeof(entryHeader);
+		if (std::fseek(file, (long)(offset + dataSize), SEEK_SET) != 0 || (u64)std::ftell(file) != offset + dataSize)
+			break;
+		// Seeking past the end of the file doesn't fail
+		u8 lastByte;
+		if (std::fseek(file, -1, SEEK_CUR) != 0 || std::fread(&lastByte, 1, 1, file) != 1)
+			break;
+		index[entryHeader.key] = { offset, entryHeader.width, entryHeader.height, false, nullptr };
+		fileSize = offset + dataSize;
+	}
+	NOTICE_LOG(RENDERER, "Texture cache %s: %d textures", path.c_str(), (int)index.size());
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		entries = std::move(index);
+	}
+	preload();
+}
+
+static void load()
+{
+	loaded = true;
+	loadedGameId = settings.content.gameId;
+	if (loadedGameId.empty())
+		return;
+	closing = false;
+	// The index is read in the background. Lookups fail until it's done.
+	worker.run([gameId = loadedGameId]() {
+		openFile(gameId);
+	});
+}
+
+static bool enabled()
+{
+	if (!config::UpscaledTextureDiskCache)
+		return false;
+	if (!loaded || loadedGameId != settings.content.gameId)
+	{
+		close();
+		load();
+	}
+	return !loadedGameId.empty();
+}
+
+std::shared_ptr<const TextureDecode> find(u64 key)
+{
+	if (!enabled())
+		return nullptr;
+	std::lock_guard<std::mutex> _(mutex);
+	auto it = entries.find(key);
+	if (it == entries.end())
+		return nullptr;
+	if (it->second.decode == nullptr)
+	{
+		// Read it in the background so that it's available next time
+		if (!it->second.loading)
+		{
+			it->second.loading = true;
+			worker.run([key]() {
+				loadEntry(key);
+			});
+		}
+		return nullptr;
+	}
+	// The texture cache now owns the preloaded texture
+	return std::move(it->second.decode);
+}
+
+void add(u64 key, const std::shared_ptr<const TextureDecode>& decode)
+{
+	if (decode->texType != TextureType::_8888 || decode->mipmapsIncluded
+			|| decode->outWidth > MAX_TEXTURE_SIZE || decode->outHeight > MAX_TEXTURE_SIZE
+			|| !enabled())
+		return;
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		if (entries.count(key) != 0)
+			return;
+	}
+	// The worker thread writes the entries in order
+	worker.run([key, decode]() {
+		if (file == nullptr)
+			return;
+		{
+			std::lock_guard<std::mutex> _(mutex);
+			// Added twice before being written
+			if (entries.count(key) != 0)
+				return;
+		}
+		Entry entry { fileSize + sizeof(EntryHeader), decode->outWidth, decode->outHeight, false, nullptr };
+		if (entry.offset + entry.width * entry.height * 4 > MAX_FILE_SIZE)
+			return;
+		EntryHeader header { key, entry.width, entry.height };
+		if (std::fseek(file, (long)fileSize, SEEK_SET) != 0
+				|| std::fwrite(&header, sizeof(header), 1, file) != 1
+				|| std::fwrite(decode->data, entry.width * 4, entry.height, file) != entry.height)
+		{
+			WARN_LOG(RENDERER, "Error writing texture cache");
+			// Stop using the cache for this session
+			std::fclose(file);
+			file = nullptr;
+			std::lock_guard<std::mutex> _(mutex);
+			entries.clear();
+			return;
+		}
+		fileSize = entry.offset + entry.width * entry.height * 4;
+		// Don't keep the texture in memory now that it's saved
+		std::lock_guard<std::mutex> _(mutex);
+		entries[key] = entry;
+	});
+}
+
+void close()
+{
+	closing = true;
+	worker.stop();
+	if (file != nullptr)
+	{
+		std::fclose(file);
+		file = nullptr;
+	}
+	entries.clear();
+	loadedGameId.clear();
+	loaded = false;
+}
+
+}	// namespace texdiskcache
@@ -0,0 +1,43 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+#include <memory>
+
+struct TextureDecode;
+
+//
+// Persistent cache of upscaled textures.
+// Textures are keyed by their decoded texture cache key (hash of the texture data and decoding parameters)
+// and appended to a pack file per game (gameId). The index is read in the background on the first lookup
+// and the textures are then preloaded, up to config::TextureDiskCachePreloadSize.
+// All file accesses are done by the worker thread.
+//
+namespace texdiskcache
+{
+
+// Returns the cached texture with the given key, or nullptr if not found or not loaded yet.
+// Textures that aren't loaded are read in the background.
+std::shared_ptr<const TextureDecode> find(u64 key);
+// Save an upscaled texture in the background
+void add(u64 key, const std::shared_ptr<const TextureDecode>& decode);
+// Wait for pending writes and close the cache file
+void close();
+
+}
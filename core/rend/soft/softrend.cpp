@@ -0,0 +1,1154 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//
+// CPU renderer for headless builds, selected with pvr.rend = 7 (RenderType::Software).
+// Triangles are set up and binned into 32x32 tiles, then the tiles are rasterized in parallel
+// by a pool of worker threads. Each tile has its own depth and stencil buffers so no synchronization
+// is needed between workers. Edge functions and depth tests are evaluated for 4 pixels at once.
+//
+#include "hw/pvr/ta.h"
+#include "hw/pvr/ta_ctx.h"
+#include "hw/pvr/Renderer_if.h"
+#include "hw/pvr/pvr_mem.h"
+#include "rend/TexCache.h"
+#include "rend/transform_matrix.h"
+#include "rend/tileclip.h"
+#include "util/worker_thread.h"
+#include "stdclass.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if HOST_CPU == CPU_X86 || HOST_CPU == CPU_X64
+#include <xmmintrin.h>
+#define SOFTREND_SSE
+#elif HOST_CPU == CPU_ARM64 || (HOST_CPU == CPU_ARM && defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define SOFTREND_NEON
+#endif
+
+// 4 float lanes. Comparisons return a 4-bit mask with bit i set if true for lane i.
+struct Vec4
+{
+#if defined(SOFTREND_SSE)
+	__m128 v;
+
+	static Vec4 set(float f) { return { _mm_set1_ps(f) }; }
+	static Vec4 set(float a, float b, float c, float d) { return { _mm_setr_ps(a, b, c, d) }; }
+	static Vec4 load(const float *p) { return { _mm_loadu_ps(p) }; }
+	Vec4 operator+(const Vec4& o) const { return { _mm_add_ps(v, o.v) }; }
+	Vec4 operator*(const Vec4& o) const { return { _mm_mul_ps(v, o.v) }; }
+	int gt(const Vec4& o) const { return _mm_movemask_ps(_mm_cmpgt_ps(v, o.v)); }
+	int ge(const Vec4& o) const { return _mm_movemask_ps(_mm_cmpge_ps(v, o.v)); }
+	int eq(const Vec4& o) const { return _mm_movemask_ps(_mm_cmpeq_ps(v, o.v)); }
+	float operator[](int i) const {
+		alignas(16) float f[4];
+		_mm_store_ps(f, v);
+		return f[i];
+	}
+
+#elif defined(SOFTREND_NEON)
+	float32x4_t v;
+
+	static Vec4 set(float f) { return { vdupq_n_f32(f) }; }
+	static Vec4 set(float a, float b, float c, float d) {
+		const float f[4] { a, b, c, d };
+		return { vld1q_f32(f) };
+	}
+	static Vec4 load(const float *p) { return { vld1q_f32(p) }; }
+	Vec4 operator+(const Vec4& o) const { return { vaddq_f32(v, o.v) }; }
+	Vec4 operator*(const Vec4& o) const { return { vmulq_f32(v, o.v) }; }
+	int gt(const Vec4& o) const { return mask(vcgtq_f32(v, o.v)); }
+	int ge(const Vec4& o) const { return mask(vcgeq_f32(v, o.v)); }
+	int eq(const Vec4& o) const { return mask(vceqq_f32(v, o.v)); }
+	float operator[](int i) const {
+		float f[4];
+		vst1q_f32(f, v);
+		return f[i];
+	}
+
+private:
+	static int mask(uint32x4_t m)
+	{
+		static const u32 bits[4] { 1, 2, 4, 8 };
+		uint32x4_t r = vandq_u32(m, vld1q_u32(bits));
+		return vgetq_lane_u32(r, 0) | vgetq_lane_u32(r, 1) | vgetq_lane_u32(r, 2) | vgetq_lane_u32(r, 3);
+	}
+
+#else
+	float v[4];
+
+	static Vec4 set(float f) { return { { f, f, f, f } }; }
+	static Vec4 set(float a, float b, float c, float d) { return { { a, b, c, d } }; }
+	static Vec4 load(const float *p) { return { { p[0], p[1], p[2], p[3] } }; }
+	Vec4 operator+(const Vec4& o) const { return { { v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3] } }; }
+	Vec4 operator*(const Vec4& o) const { return { { v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3] } }; }
+	int gt(const Vec4& o) const { return (v[0] > o.v[0]) | ((v[1] > o.v[1]) << 1) | ((v[2] > o.v[2]) << 2) | ((v[3] > o.v[3]) << 3); }
+	int ge(const Vec4& o) const { return (v[0] >= o.v[0]) | ((v[1] >= o.v[1]) << 1) | ((v[2] >= o.v[2]) << 2) | ((v[3] >= o.v[3]) << 3); }
+	int eq(const Vec4& o) const { return (v[0] == o.v[0]) | ((v[1] == o.v[1]) << 1) | ((v[2] == o.v[2]) << 2) | ((v[3] == o.v[3]) << 3); }
+	float operator[](int i) const { return v[i]; }
+#endif
+};
+
+class SoftTexture final : public BaseTextureCacheData
+{
+public:
+	SoftTexture(TSP tsp = {}, TCW tcw = {}, int area = 0) : BaseTextureCacheData(tsp, tcw, area) {}
+	SoftTexture(SoftTexture&& other) : BaseTextureCacheData(std::move(other)) {
+		std::swap(pixels, other.pixels);
+		texWidth = other.texWidth;
+		texHeight = other.texHeight;
+		bpp = other.bpp;
+	}
+
+	std::string GetId() override {
+		char s[20];
+		snprintf(s, sizeof(s), "%p", this);
+		return s;
+	}
+	void UploadToGPU(int width, int height, const u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) override;
+	// Only sample decoded RGBA8888 pixels or palette indices
+	bool Force32BitTexture(TextureType type) const override { return type != TextureType::_8; }
+	bool Delete() override
+	{
+		if (!BaseTextureCacheData::Delete())
+			return false;
+		pixels.clear();
+		pixels.shrink_to_fit();
+		return true;
+	}
+
+	// Returns the RGBA8888 color of the given texel, which must be in range
+	u32 texel(int x, int y) const
+	{
+		if (bpp == 1)
+		{
+			u32 paletteBase = tcw.PixelFmt == PixelPal4 ? tcw.PalSelect << 4 : (tcw.PalSelect >> 4) << 8;
+			return palette32_ram[paletteBase + pixels[y * texWidth + x]];
+		}
+		return *(const u32 *)&pixels[(y * texWidth + x) * 4];
+	}
+
+	std::vector<u8> pixels;
+	int texWidth = 0;
+	int texHeight = 0;
+	int bpp = 4;
+};
+
+void SoftTexture::UploadToGPU(int width, int height, const u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded)
+{
+	bpp = tex_type == TextureType::_8 ? 1 : 4;
+	if (mipmapsIncluded)
+	{
+		// Only the largest mipmap level is used. Smaller levels come first.
+		for (int dim = 1; dim < width; dim *= 2)
+			temp_tex_buffer += dim * dim * (tex_type == TextureType::_8888 || tex_type == TextureType::_8 ? bpp : 2);
+	}
+	texWidth = width;
+	texHeight = height;
+	pixels.resize(width * height * bpp);
+	const u16 *src16 = (const u16 *)temp_tex_buffer;
+	u32 *dst = (u32 *)pixels.data();
+	switch (tex_type)
+	{
+	case TextureType::_8888:
+	case TextureType::_8:
+		memcpy(pixels.data(), temp_tex_buffer, pixels.size());
+		break;
+	// 16-bit textures shouldn't happen since they're forced to 32-bit, but custom textures could change this
+	case TextureType::_565:
+		for (int i = 0; i < width * height; i++)
+			dst[i] = ((src16[i] >> 11) * 255 / 31) | (((src16[i] >> 5) & 63) * 255 / 63) << 8
+					| ((src16[i] & 31) * 255 / 31) << 16 | 0xff000000;
+		break;
+	case TextureType::_5551:
+		for (int i = 0; i < width * height; i++)
+			dst[i] = ((src16[i] >> 11) * 255 / 31) | (((src16[i] >> 6) & 31) * 255 / 31) << 8
+					| (((src16[i] >> 1) & 31) * 255 / 31) << 16 | ((src16[i] & 1) ? 0xff000000 : 0);
+		break;
+	case TextureType::_4444:
+		for (int i = 0; i < width * height; i++)
+			dst[i] = ((src16[i] >> 12) * 17) | (((src16[i] >> 8) & 15) * 17) << 8
+					| (((src16[i] >> 4) & 15) * 17) << 16 | ((src16[i] & 15) * 17) << 24;
+		break;
+	default:
+		pixels.clear();
+		texWidth = texHeight = 0;
+		break;
+	}
+}
+
+class SoftTextureCache final : public BaseTextureCache<SoftTexture>
+{
+public:
+	SoftTextureCache() {
+		SoftTexture::SetDirectXColorOrder(false);
+	}
+	~SoftTextureCache() {
+		Clear();
+	}
+	void Cleanup() {
+		CollectCleanup();
+	}
+};
+
+struct SoftRenderer final : public Renderer
+{
+	bool Init() override;
+	void Term() override;
+	void Process(TA_context* ctx) override;
+	bool Render() override;
+	void RenderFramebuffer(const FramebufferInfo& info) override;
+	bool RenderLastFrame() override {
+		return !clearLastFrame && !frame.empty();
+	}
+	bool GetLastFrame(std::vector<u8>& data, int& width, int& height) override;
+	BaseTextureCacheData *GetTexture(TSP tsp, TCW tcw, int area) override;
+
+private:
+	static constexpr int TILE_SIZE = 32;
+
+	// Linear function of the pixel coordinates, evaluated at pixel centers
+	struct Plane
+	{
+		float a, b, c;
+		float at(float x, float y) const { return a * x + b * y + c; }
+	};
+
+	enum class PrimType : u8 {
+		Opaque,
+		PunchThrough,
+		Translucent,
+		ModVol,			// Or/Xor the volume into stencil bit 1
+		ModVolSum,		// Combine stencil bit 1 into bit 0 (inclusion or exclusion)
+		ShadowResolve,	// Apply the shadow to pixels in stencil bit 0
+	};
+
+	struct Triangle
+	{
+		Plane edges[3];
+		Plane z;
+		Plane u, v;
+		Plane base[4];
+		Plane offset[4];
+		int minX, minY, maxX, maxY;
+		const PolyParam *pp;
+		SoftTexture *texture;
+		PrimType type;
+		u8 topLeft;		// bit i is set if edge i is a top or left edge
+		u8 depthFunc;
+		u8 mode;		// modifier volume mode
+		bool zWrite;
+		bool gouraud;
+		bool bilinear;
+		bool clipInside;
+		int clipRect[4];
+	};
+
+	struct TileBuffer
+	{
+		float depth[TILE_SIZE * TILE_SIZE];
+		u8 stencil[TILE_SIZE * TILE_SIZE];
+	};
+
+	struct ClipState
+	{
+		TileClipping mode;
+		int rect[4];
+	};
+
+	ClipState getTileClip(u32 tileclip) const;
+	bool setupTriangle(Triangle& tri, const float *p0, const float *p1, const float *p2, int cullMode, const ClipState& clip);
+	void addPoly(const PolyParam& pp, PrimType type, const u32 *indices, u32 count, bool strip, bool sorted);
+	void addModVols(int first, int count);
+	void addPrimitive(const Triangle& tri);
+	void setupPrimitives();
+	void renderTile(int tile, TileBuffer& buffer);
+	void rasterize(const Triangle& tri, int tileX, int tileY, TileBuffer& buffer);
+	void shadePixel(const Triangle& tri, int x, int y, float z, float& depth, u8& stencil, u32& color);
+	void sampleTexture(const Triangle& tri, float u, float v, float rgba[4]) const;
+	float fogFactor(float z) const;
+	void renderFrame(int width, int height);
+	void loadFogTable();
+
+	SoftTextureCache texCache;
+	std::vector<std::unique_ptr<WorkerThread>> workers;
+	std::vector<Triangle> prims;
+	std::vector<std::vector<u32>> bins;
+	int tilesX = 0;
+	int tilesY = 0;
+	glm::mat4 viewport;
+
+	std::vector<u32> colorBuffer;
+	int bufferWidth = 0;
+	int bufferHeight = 0;
+
+	// Last frame displayed
+	std::vector<u32> frame;
+	int frameWidth = 0;
+	int frameHeight = 0;
+	float aspectRatio = 4.f / 3.f;
+
+	float fogTable[256] {};
+	float fogDensity = 0;
+	float fogColRam[3] {};
+	float fogColVert[3] {};
+	float fogClampMin[4] {};
+	float fogClampMax[4] {};
+	float alphaRef = 0;
+	float shadowScale = 1;
+};
+
+bool SoftRenderer::Init()
+{
+	unsigned threads = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+	for (unsigned i = 1; i < threads; i++)
+		workers.push_back(std::make_unique<WorkerThread>("SoftRenderer"));
+	INFO_LOG(RENDERER, "Software renderer initialized with %d threads", threads);
+
+	return true;
+}
+
+void SoftRenderer::Term()
+{
+	workers.clear();
+	texCache.Clear();
+	prims.clear();
+	bins.clear();
+	colorBuffer.clear();
+	frame.clear();
+}
+
+BaseTextureCacheData *SoftRenderer::GetTexture(TSP tsp, TCW tcw, int area)
+{
+	SoftTexture* tf = texCache.getTextureCacheData(tsp, tcw, area);
+
+	if (tf->NeedsUpdate())
+	{
+		if (!tf->Update())
+			tf = nullptr;
+	}
+	return tf;
+}
+
+void SoftRenderer::Process(TA_context* ctx)
+{
+	if (settings.platform.isNaomi2())
+		throw FlycastException("The software renderer doesn't support Naomi 2 games");
+
+	if (resetTextureCache) {
+		texCache.Clear();
+		resetTextureCache = false;
+	}
+	texCache.Cleanup();
+
+	ta_parse(ctx, false);
+}
+
+void SoftRenderer::loadFogTable()
+{
+	const u8 *table = (const u8 *)FOG_TABLE;
+	for (int i = 0; i < 128; i++)
+	{
+		fogTable[i * 2] = table[i * 4] / 255.f;
+		fogTable[i * 2 + 1] = table[i * 4 + 1] / 255.f;
+	}
+}
+
+// Same as the fog_mode2 shader function
+float SoftRenderer::fogFactor(float z) const
+{
+	float fz = std::clamp(fogDensity * z, 1.f, 255.9999f);
+	int exp = std::ilogb(fz);
+	float m = fz * 16.f / (float)(1 << exp) - 16.f;
+	int idx = std::min((int)m + exp * 16, 127);
+	float frac = m - std::floor(m);
+	return fogTable[idx * 2 + 1] * (1.f - frac) + fogTable[idx * 2] * frac;
+}
+
+SoftRenderer::ClipState SoftRenderer::getTileClip(u32 tileclip) const
+{
+	ClipState clip;
+	clip.mode = GetTileClip(tileclip, viewport, clip.rect);
+	if (clip.mode != TileClipping::Off && pvrrc.isRTT && !config::RenderToTextureBuffer)
+	{
+		// Render to texture is always done at native resolution
+		float scale = 480.f / config::RenderResolution;
+		for (int& v : clip.rect)
+			v = (int)lroundf(v * scale);
+	}
+	return clip;
+}
+
+//
+// Compute the edge functions and attribute planes of a triangle in screen space.
+// Returns false if the triangle is culled or doesn't cover any pixel.
+//
+bool SoftRenderer::setupTriangle(Triangle& tri, const float *p0, const float *p1, const float *p2, int cullMode, const ClipState& clip)
+{
+	float x[3], y[3];
+	const float *p[3] { p0, p1, p2 };
+	for (int i = 0; i < 3; i++)
+	{
+		if (!std::isfinite(p[i][0]) || !std::isfinite(p[i][1]) || !std::isfinite(p[i][2]))
+			return false;
+		x[i] = viewport[0][0] * p[i][0] + viewport[3][0];
+		y[i] = viewport[1][1] * p[i][1] + viewport[3][1];
+	}
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0.f || !std::isfinite(area)
+			|| (cullMode == 2 && area < 0.f)
+			|| (cullMode == 3 && area > 0.f))
+		return false;
+
+	// Pixel bounds
+	int minX = 0, minY = 0;
+	int maxX = bufferWidth - 1;
+	int maxY = bufferHeight - 1;
+	if (clip.mode == TileClipping::Outside)
+	{
+		minX = std::max(minX, clip.rect[0]);
+		minY = std::max(minY, clip.rect[1]);
+		maxX = std::min(maxX, clip.rect[0] + clip.rect[2] - 1);
+		maxY = std::min(maxY, clip.rect[1] + clip.rect[3] - 1);
+	}
+	// Pixel centers are at +0.5
+	float fminX = std::ceil(std::min({ x[0], x[1], x[2] }) - 0.5f);
+	float fmaxX = std::floor(std::max({ x[0], x[1], x[2] }) - 0.5f);
+	float fminY = std::ceil(std::min({ y[0], y[1], y[2] }) - 0.5f);
+	float fmaxY = std::floor(std::max({ y[0], y[1], y[2] }) - 0.5f);
+	tri.minX = std::max(minX, (int)std::max(fminX, -1.f));
+	tri.maxX = std::min(maxX, (int)std::min(fmaxX, (float)bufferWidth));
+	tri.minY = std::max(minY, (int)std::max(fminY, -1.f));
+	tri.maxY = std::min(maxY, (int)std::min(fmaxY, (float)bufferHeight));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return false;
+
+	// Make the edge functions positive inside
+	int i1 = 1, i2 = 2;
+	if (area < 0.f)
+	{
+		std::swap(i1, i2);
+		area = -area;
+	}
+	const int order[3] { 0, i1, i2 };
+	float invArea = 1.f / area;
+	tri.topLeft = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		// edge i is opposite to vertex i
+		int a = order[(i + 1) % 3];
+		int b = order[(i + 2) % 3];
+		float dx = x[b] - x[a];
+		float dy = y[b] - y[a];
+		Plane& e = tri.edges[i];
+		e.a = -dy;
+		e.b = dx;
+		e.c = dy * x[a] - dx * y[a] + 0.5f * (e.a + e.b);
+		if (dy < 0.f || (dy == 0.f && dx > 0.f))
+			tri.topLeft |= 1 << i;
+	}
+	auto setPlane = [&](Plane& plane, float v0, float v1, float v2) {
+		const float v[3] { v0, v1, v2 };
+		plane.a = plane.b = plane.c = 0.f;
+		for (int i = 0; i < 3; i++)
+		{
+			float f = v[order[i]] * invArea;
+			plane.a += tri.edges[i].a * f;
+			plane.b += tri.edges[i].b * f;
+			plane.c += tri.edges[i].c * f;
+		}
+	};
+	setPlane(tri.z, p0[2], p1[2], p2[2]);
+	tri.clipInside = clip.mode == TileClipping::Inside;
+	if (tri.clipInside)
+		memcpy(tri.clipRect, clip.rect, sizeof(tri.clipRect));
+
+	if (tri.pp != nullptr)
+	{
+		const Vertex *v[3] { (const Vertex *)p0, (const Vertex *)p1, (const Vertex *)p2 };
+		// Attributes are interpolated divided by w, i.e. multiplied by z
+		if (tri.texture != nullptr)
+		{
+			setPlane(tri.u, v[0]->u * v[0]->z, v[1]->u * v[1]->z, v[2]->u * v[2]->z);
+			setPlane(tri.v, v[0]->v * v[0]->z, v[1]->v * v[1]->z, v[2]->v * v[2]->z);
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			if (tri.gouraud)
+			{
+				setPlane(tri.base[i], v[0]->col[i] / 255.f * v[0]->z, v[1]->col[i] / 255.f * v[1]->z, v[2]->col[i] / 255.f * v[2]->z);
+				setPlane(tri.offset[i], v[0]->spc[i] / 255.f * v[0]->z, v[1]->spc[i] / 255.f * v[1]->z, v[2]->spc[i] / 255.f * v[2]->z);
+			}
+			else
+			{
+				// Flat shading uses the last vertex
+				tri.base[i] = { 0.f, 0.f, v[2]->col[i] / 255.f };
+				tri.offset[i] = { 0.f, 0.f, v[2]->spc[i] / 255.f };
+			}
+		}
+	}
+	return true;
+}
+
+void SoftRenderer::addPrimitive(const Triangle& tri)
+{
+	u32 index = prims.size();
+	prims.push_back(tri);
+	for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty++)
+		for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx++)
+			bins[ty * tilesX + tx].push_back(index);
+}
+
+void SoftRenderer::addPoly(const PolyParam& pp, PrimType type, const u32 *indices, u32 count, bool strip, bool sorted)
+{
+	if (count < 3)
+		return;
+	// Same as the depth mode and z write logic of the hardware renderers
+	if (!sorted && type != PrimType::PunchThrough && pp.isp.DepthMode == 0)
+		return;
+
+	Triangle tri {};
+	tri.pp = &pp;
+	tri.type = type;
+	tri.mode = 0;
+	tri.texture = pp.pcw.Texture ? (SoftTexture *)pp.texture : nullptr;
+	if (tri.texture != nullptr && tri.texture->pixels.empty())
+		tri.texture = nullptr;
+	tri.gouraud = pp.pcw.Gouraud;
+	tri.bilinear = config::TextureFiltering == 0 ? pp.tsp.FilterMode != 0 : config::TextureFiltering == 2;
+	if (sorted || type == PrimType::PunchThrough)
+		tri.depthFunc = 6;	// GEQ
+	else
+		tri.depthFunc = pp.isp.DepthMode;
+	tri.zWrite = sorted ? false : type == PrimType::PunchThrough ? true : !pp.isp.ZWriteDis;
+	const ClipState clip = getTileClip(pp.tileclip);
+	const int cullMode = pp.isp.CullMode;
+
+	const Vertex *verts = pvrrc.verts.data();
+	if (strip)
+	{
+		for (u32 i = 0; i + 2 < count; i++)
+		{
+			const Vertex *v0 = &verts[indices[i]];
+			const Vertex *v1 = &verts[indices[i + 1]];
+			const Vertex *v2 = &verts[indices[i + 2]];
+			if (v0 == v1 || v1 == v2 || v0 == v2)
+				continue;
+			// Odd triangles have their winding reversed
+			if (i & 1)
+				std::swap(v0, v1);
+			if (setupTriangle(tri, &v0->x, &v1->x, &v2->x, cullMode, clip))
+				addPrimitive(tri);
+		}
+	}
+	else
+	{
+		for (u32 i = 0; i + 2 < count; i += 3)
+		{
+			const Vertex *v0 = &verts[indices[i]];
+			const Vertex *v1 = &verts[indices[i + 1]];
+			const Vertex *v2 = &verts[indices[i + 2]];
+			if (setupTriangle(tri, &v0->x, &v1->x, &v2->x, cullMode, clip))
+				addPrimitive(tri);
+		}
+	}
+}
+
+// Modifier volumes are emulated the same way as the DirectX 9 renderer, using stencil bits
+void SoftRenderer::addModVols(int first, int count)
+{
+	if (count == 0 || pvrrc.modtrig.empty() || !config::ModifierVolumes)
+		return;
+
+	Triangle tri {};
+	int modBase = -1;
+	for (int cmv = first; cmv < first + count; cmv++)
+	{
+		const ModifierVolumeParam& param = pvrrc.global_param_mvo[cmv];
+		if (param.count == 0)
+			continue;
+		u32 mvMode = param.isp.DepthMode;
+		if (modBase == -1)
+			modBase = param.first;
+
+		tri.type = PrimType::ModVol;
+		// 0: Xor (closed volume), 1: Or (open volume or quad)
+		tri.mode = !param.isp.VolumeLast && mvMode > 0;
+		const ClipState clip = getTileClip(param.tileclip);
+		for (u32 i = param.first; i < param.first + param.count; i++)
+		{
+			const ModTriangle& mt = pvrrc.modtrig[i];
+			if (setupTriangle(tri, &mt.x0, &mt.x1, &mt.x2, param.isp.CullMode, clip))
+				addPrimitive(tri);
+		}
+		if (mvMode == 1 || mvMode == 2)
+		{
+			// Sum the area: 1 is inclusion, 2 is exclusion
+			tri.type = PrimType::ModVolSum;
+			tri.mode = mvMode;
+			const ClipState noClip { TileClipping::Off, {} };
+			for (u32 i = modBase; i < param.first + param.count; i++)
+			{
+				const ModTriangle& mt = pvrrc.modtrig[i];
+				if (setupTriangle(tri, &mt.x0, &mt.x1, &mt.x2, 0, noClip))
+					addPrimitive(tri);
+			}
+			modBase = -1;
+		}
+	}
+	Triangle resolve {};
+	resolve.type = PrimType::ShadowResolve;
+	resolve.minX = resolve.minY = 0;
+	resolve.maxX = bufferWidth - 1;
+	resolve.maxY = bufferHeight - 1;
+	addPrimitive(resolve);
+}
+
+void SoftRenderer::setupPrimitives()
+{
+	prims.clear();
+	tilesX = (bufferWidth + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (bufferHeight + TILE_SIZE - 1) / TILE_SIZE;
+	bins.resize(tilesX * tilesY);
+	for (auto& bin : bins)
+		bin.clear();
+
+	const u32 *idx = pvrrc.idx.data();
+	RenderPass previous {};
+	for (const RenderPass& pass : pvrrc.render_passes)
+	{
+		for (u32 i = previous.op_count; i < pass.op_count; i++)
+		{
+			const PolyParam& pp = pvrrc.global_param_op[i];
+			addPoly(pp, PrimType::Opaque, &idx[pp.first], pp.count, true, false);
+		}
+		for (u32 i = previous.pt_count; i < pass.pt_count; i++)
+		{
+			const PolyParam& pp = pvrrc.global_param_pt[i];
+			addPoly(pp, PrimType::PunchThrough, &idx[pp.first], pp.count, true, false);
+		}
+		addModVols(previous.mvo_count, pass.mvo_count - previous.mvo_count);
+		if (pass.autosort && !config::PerStripSorting)
+		{
+			for (u32 i = previous.sorted_tr_count; i < pass.sorted_tr_count; i++)
+			{
+				const SortedTriangle& st = pvrrc.sortedTriangles[i];
+				addPoly(pvrrc.global_param_tr[st.polyIndex], PrimType::Translucent, &idx[st.first], st.count, false, true);
+			}
+		}
+		else
+		{
+			for (u32 i = previous.tr_count; i < pass.tr_count; i++)
+			{
+				const PolyParam& pp = pvrrc.global_param_tr[i];
+				addPoly(pp, PrimType::Translucent, &idx[pp.first], pp.count, true, false);
+			}
+		}
+		previous = pass;
+	}
+}
+
+void SoftRenderer::renderTile(int tile, TileBuffer& buffer)
+{
+	const int tileX = (tile % tilesX) * TILE_SIZE;
+	const int tileY = (tile / tilesX) * TILE_SIZE;
+	std::fill(std::begin(buffer.depth), std::end(buffer.depth), 0.f);
+	memset(buffer.stencil, 0, sizeof(buffer.stencil));
+
+	for (u32 index : bins[tile])
+	{
+		const Triangle& tri = prims[index];
+		if (tri.type != PrimType::ShadowResolve)
+		{
+			rasterize(tri, tileX, tileY, buffer);
+			continue;
+		}
+		const int w = std::min(TILE_SIZE, bufferWidth - tileX);
+		const int h = std::min(TILE_SIZE, bufferHeight - tileY);
+		for (int y = 0; y < h; y++)
+		{
+			u32 *color = &colorBuffer[(tileY + y) * bufferWidth + tileX];
+			u8 *stencil = &buffer.stencil[y * TILE_SIZE];
+			for (int x = 0; x < w; x++)
+			{
+				if ((stencil[x] & 0x81) == 0x81)
+				{
+					u32 c = color[x];
+					u32 r = (u32)((c & 0xff) * shadowScale);
+					u32 g = (u32)(((c >> 8) & 0xff) * shadowScale);
+					u32 b = (u32)(((c >> 16) & 0xff) * shadowScale);
+					color[x] = (c & 0xff000000) | r | (g << 8) | (b << 16);
+				}
+				stencil[x] &= ~3;
+			}
+		}
+	}
+}
+
+void SoftRenderer::rasterize(const Triangle& tri, int tileX, int tileY, TileBuffer& buffer)
+{
+	const int minX = std::max(tri.minX, tileX);
+	const int maxX = std::min(tri.maxX, tileX + TILE_SIZE - 1);
+	const int minY = std::max(tri.minY, tileY);
+	const int maxY = std::min(tri.maxY, tileY + TILE_SIZE - 1);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	const Vec4 zero = Vec4::set(0.f);
+	const Vec4 laneOffsets = Vec4::set(0.f, 1.f, 2.f, 3.f);
+	const Vec4 ea[3] { Vec4::set(tri.edges[0].a), Vec4::set(tri.edges[1].a), Vec4::set(tri.edges[2].a) };
+	const Vec4 za = Vec4::set(tri.z.a);
+	// Groups of 4 pixels are aligned within the tile
+	const int startX = tileX + ((minX - tileX) & ~3);
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		const float fy = (float)y;
+		const Vec4 eRow[3] {
+			Vec4::set(tri.edges[0].b * fy + tri.edges[0].c),
+			Vec4::set(tri.edges[1].b * fy + tri.edges[1].c),
+			Vec4::set(tri.edges[2].b * fy + tri.edges[2].c)
+		};
+		const Vec4 zRow = Vec4::set(tri.z.b * fy + tri.z.c);
+		float *depthRow = &buffer.depth[(y - tileY) * TILE_SIZE - tileX];
+		u8 *stencilRow = &buffer.stencil[(y - tileY) * TILE_SIZE - tileX];
+		u32 *colorRow = &colorBuffer[y * bufferWidth];
+
+		for (int x = startX; x <= maxX; x += 4)
+		{
+			int mask = 0xf;
+			if (x < minX)
+				mask &= 0xf << (minX - x);
+			if (maxX - x < 3)
+				mask &= 0xf >> (3 - (maxX - x));
+			const Vec4 xs = Vec4::set((float)x) + laneOffsets;
+			for (int i = 0; i < 3 && mask != 0; i++)
+			{
+				const Vec4 e = xs * ea[i] + eRow[i];
+				mask &= (tri.topLeft & (1 << i)) ? e.ge(zero) : e.gt(zero);
+			}
+			if (mask == 0)
+				continue;
+
+			const Vec4 z = xs * za + zRow;
+			const Vec4 depth = Vec4::load(&depthRow[x]);
+			switch (tri.type)
+			{
+			case PrimType::ModVol:
+				mask &= z.gt(depth);
+				break;
+			case PrimType::ModVolSum:
+				break;
+			default:
+				switch (tri.depthFunc)
+				{
+				case 0:	// never
+					mask = 0;
+					break;
+				case 1:	// less
+					mask &= depth.gt(z);
+					break;
+				case 2:	// equal
+					mask &= z.eq(depth);
+					break;
+				case 3:	// less or equal
+					mask &= depth.ge(z);
+					break;
+				case 4:	// greater
+					mask &= z.gt(depth);
+					break;
+				case 5:	// not equal
+					mask &= ~z.eq(depth);
+					break;
+				case 6:	// greater or equal
+					mask &= z.ge(depth);
+					break;
+				default: // always
+					break;
+				}
+				break;
+			}
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if ((mask & (1 << lane)) == 0)
+					continue;
+				const int px = x + lane;
+				if (tri.clipInside
+						&& px >= tri.clipRect[0] && px < tri.clipRect[0] + tri.clipRect[2]
+						&& y >= tri.clipRect[1] && y < tri.clipRect[1] + tri.clipRect[3])
+					continue;
+				u8& stencil = stencilRow[px];
+				switch (tri.type)
+				{
+				case PrimType::ModVol:
+					if (tri.mode == 0)
+						stencil ^= 2;
+					else
+						stencil |= 2;
+					break;
+				case PrimType::ModVolSum:
+					if (tri.mode == 1)
+						// inclusion
+						stencil = (stencil & ~3) | ((stencil | (stencil >> 1)) & 1);
+					else
+						// exclusion
+						stencil = (stencil & ~3) | (stencil & ~(stencil >> 1) & 1);
+					break;
+				default:
+					shadePixel(tri, px, y, z[lane], depthRow[px], stencil, colorRow[px]);
+					break;
+				}
+			}
+		}
+	}
+}
+
+void SoftRenderer::sampleTexture(const Triangle& tri, float u, float v, float rgba[4]) const
+{
+	const SoftTexture& tex = *tri.texture;
+	const TSP tsp = tri.pp->tsp;
+	const int w = tex.texWidth;
+	const int h = tex.texHeight;
+	auto wrap = [](int c, int size, bool clamp, bool flip) {
+		if (clamp)
+			return std::clamp(c, 0, size - 1);
+		if (flip)
+		{
+			c %= size * 2;
+			if (c < 0)
+				c += size * 2;
+			return c < size ? c : size * 2 - 1 - c;
+		}
+		c %= size;
+		return c < 0 ? c + size : c;
+	};
+	auto unpack = [](u32 c, float weight, float rgba[4]) {
+		rgba[0] += (c & 0xff) * weight;
+		rgba[1] += ((c >> 8) & 0xff) * weight;
+		rgba[2] += ((c >> 16) & 0xff) * weight;
+		rgba[3] += (c >> 24) * weight;
+	};
+	rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0.f;
+	float fu = u * w;
+	float fv = v * h;
+	if (!tri.bilinear)
+	{
+		int x = wrap((int)std::floor(fu), w, tsp.ClampU, tsp.FlipU);
+		int y = wrap((int)std::floor(fv), h, tsp.ClampV, tsp.FlipV);
+		unpack(tex.texel(x, y), 1.f / 255.f, rgba);
+	}
+	else
+	{
+		fu -= 0.5f;
+		fv -= 0.5f;
+		float flu = std::floor(fu);
+		float flv = std::floor(fv);
+		float fx = fu - flu;
+		float fy = fv - flv;
+		int x0 = wrap((int)flu, w, tsp.ClampU, tsp.FlipU);
+		int x1 = wrap((int)flu + 1, w, tsp.ClampU, tsp.FlipU);
+		int y0 = wrap((int)flv, h, tsp.ClampV, tsp.FlipV);
+		int y1 = wrap((int)flv + 1, h, tsp.ClampV, tsp.FlipV);
+		unpack(tex.texel(x0, y0), (1.f - fx) * (1.f - fy) / 255.f, rgba);
+		unpack(tex.texel(x1, y0), fx * (1.f - fy) / 255.f, rgba);
+		unpack(tex.texel(x0, y1), (1.f - fx) * fy / 255.f, rgba);
+		unpack(tex.texel(x1, y1), fx * fy / 255.f, rgba);
+	}
+}
+
+// Same as the fragment shaders of the hardware renderers
+void SoftRenderer::shadePixel(const Triangle& tri, int x, int y, float z, float& depth, u8& stencil, u32& pixel)
+{
+	const PolyParam& pp = *tri.pp;
+	const TSP tsp = pp.tsp;
+	const float fx = (float)x;
+	const float fy = (float)y;
+	const float w = 1.f / z;
+	float color[4];
+	float offset[4];
+	for (int i = 0; i < 4; i++)
+	{
+		color[i] = tri.base[i].at(fx, fy);
+		offset[i] = tri.offset[i].at(fx, fy);
+		if (tri.gouraud)
+		{
+			color[i] *= w;
+			offset[i] *= w;
+		}
+	}
+	if (!tsp.UseAlpha)
+		color[3] = 1.f;
+	if (tsp.FogCtrl == 3)
+	{
+		memcpy(color, fogColRam, sizeof(fogColRam));
+		color[3] = fogFactor(z);
+	}
+	if (tri.texture != nullptr)
+	{
+		float tex[4];
+		sampleTexture(tri, tri.u.at(fx, fy) * w, tri.v.at(fx, fy) * w, tex);
+		if (tsp.IgnoreTexA || pp.tcw.PixelFmt == Pixel565)
+			tex[3] = 1.f;
+		if (pp.tcw.PixelFmt == PixelBumpMap)
+		{
+			constexpr float PI = 3.14159265f;
+			float s = PI / 2.f * (tex[3] * 15.f * 16.f + tex[0] * 15.f) / 255.f;
+			float r = 2.f * PI * (tex[1] * 15.f * 16.f + tex[2] * 15.f) / 255.f;
+			tex[3] = std::clamp(offset[3] + offset[0] * std::sin(s) + offset[1] * std::cos(s) * std::cos(r - 2.f * PI * offset[2]), 0.f, 1.f);
+			tex[0] = tex[1] = tex[2] = 1.f;
+		}
+		switch (tsp.ShadInstr)
+		{
+		case 0:	// decal
+			memcpy(color, tex, sizeof(tex));
+			break;
+		case 1:	// modulate
+			for (int i = 0; i < 3; i++)
+				color[i] *= tex[i];
+			color[3] = tex[3];
+			break;
+		case 2:	// decal alpha
+			for (int i = 0; i < 3; i++)
+				color[i] = color[i] * (1.f - tex[3]) + tex[i] * tex[3];
+			break;
+		case 3:	// modulate alpha
+			for (int i = 0; i < 4; i++)
+				color[i] *= tex[i];
+			break;
+		}
+		if (pp.pcw.Offset && pp.tcw.PixelFmt != PixelBumpMap)
+			for (int i = 0; i < 3; i++)
+				color[i] += offset[i];
+	}
+	for (int i = 0; i < 4; i++)
+	{
+		if (tsp.ColorClamp)
+			color[i] = std::clamp(color[i], fogClampMin[i], fogClampMax[i]);
+		else
+			color[i] = std::clamp(color[i], 0.f, 1.f);
+	}
+	if (config::Fog)
+	{
+		if (tsp.FogCtrl == 0)
+		{
+			float fog = fogFactor(z);
+			for (int i = 0; i < 3; i++)
+				color[i] = color[i] * (1.f - fog) + fogColRam[i] * fog;
+		}
+		else if (tsp.FogCtrl == 1 && pp.pcw.Offset)
+		{
+			float fog = std::clamp(offset[3], 0.f, 1.f);
+			for (int i = 0; i < 3; i++)
+				color[i] = color[i] * (1.f - fog) + fogColVert[i] * fog;
+		}
+	}
+	if (tri.type == PrimType::PunchThrough && color[3] < alphaRef)
+		return;
+
+	if (tri.type == PrimType::Translucent)
+	{
+		const float dst[4] { (pixel & 0xff) / 255.f, ((pixel >> 8) & 0xff) / 255.f,
+			((pixel >> 16) & 0xff) / 255.f, (pixel >> 24) / 255.f };
+		auto factor = [&](u32 instr, const float *other, int i) {
+			switch (instr)
+			{
+			case 0: return 0.f;
+			case 1: return 1.f;
+			case 2: return other[i];
+			case 3: return 1.f - other[i];
+			case 4: return color[3];
+			case 5: return 1.f - color[3];
+			case 6: return dst[3];
+			default: return 1.f - dst[3];
+			}
+		};
+		float blended[4];
+		for (int i = 0; i < 4; i++)
+			blended[i] = std::min(color[i] * factor(tsp.SrcInstr, dst, i)
+					+ dst[i] * factor(tsp.DstInstr, color, i), 1.f);
+		memcpy(color, blended, sizeof(blended));
+	}
+	pixel = (u32)(color[0] * 255.f + 0.5f)
+			| ((u32)(color[1] * 255.f + 0.5f) << 8)
+			| ((u32)(color[2] * 255.f + 0.5f) << 16)
+			| ((u32)(color[3] * 255.f + 0.5f) << 24);
+	if (tri.zWrite)
+		depth = z;
+	stencil = pp.pcw.Shadow ? 0x80 : 0;
+}
+
+void SoftRenderer::renderFrame(int width, int height)
+{
+	bufferWidth = width;
+	bufferHeight = height;
+	colorBuffer.assign(width * height, 0);
+	viewport = TransformMatrix<COORD_DIRECTX>(pvrrc, width, height).GetViewportMatrix();
+
+	if (updateFogTable)
+	{
+		loadFogTable();
+		updateFogTable = false;
+	}
+	fogDensity = FOG_DENSITY.get();
+	FOG_COL_RAM.getRGBColor(fogColRam);
+	FOG_COL_VERT.getRGBColor(fogColVert);
+	pvrrc.fog_clamp_min.getRGBAColor(fogClampMin);
+	pvrrc.fog_clamp_max.getRGBAColor(fogClampMax);
+	alphaRef = (PT_ALPHA_REF & 0xff) / 255.f;
+	shadowScale = FPU_SHAD_SCALE.scale_factor / 256.f;
+
+	setupPrimitives();
+
+	// Tiles are distributed dynamically since their cost varies a lot
+	std::atomic<int> nextTile { 0 };
+	const int tileCount = tilesX * tilesY;
+	auto work = [this, &nextTile, tileCount]() {
+		TileBuffer buffer;
+		for (int tile = nextTile++; tile < tileCount; tile = nextTile++)
+			renderTile(tile, buffer);
+	};
+	std::vector<std::future<void>> futures;
+	if (prims.size() > 64)
+		for (auto& worker : workers)
+			futures.push_back(worker->runFuture(work));
+	work();
+	for (auto& future : futures)
+		future.get();
+}
+
+// Nearest neighbor scaling of an RGBA8888 image
+static void scaleImage(const u32 *src, int srcWidth, int srcHeight, u32 *dst, int dstWidth, int dstHeight)
+{
+	for (int y = 0; y < dstHeight; y++)
+	{
+		const u32 *srcRow = &src[(y * srcHeight / dstHeight) * srcWidth];
+		for (int x = 0; x < dstWidth; x++)
+			*dst++ = srcRow[x * srcWidth / dstWidth];
+	}
+}
+
+bool SoftRenderer::Render()
+{
+	if (pvrrc.isRTT)
+	{
+		int width = pvrrc.getFramebufferWidth();
+		int height = pvrrc.getFramebufferHeight();
+		renderFrame(width, height);
+		u32 texAddress = pvrrc.fb_W_SOF1 & VRAM_MASK;
+		WriteTextureToVRam(width, height, (const u8 *)colorBuffer.data(), (u16 *)&vram[texAddress],
+				pvrrc.fb_W_CTRL, pvrrc.fb_W_LINESTRIDE * 8);
+		return false;
+	}
+	if (config::EmulateFramebuffer)
+	{
+		int width, height;
+		getTAViewport(pvrrc, width, height);
+		renderFrame(width, height);
+
+		float xscale = pvrrc.scaler_ctl.hscale == 1 ? 0.5f : 1.f;
+		float yscale = 1024.f / pvrrc.scaler_ctl.vscalefactor;
+		if (std::abs(yscale - 1.f) < 0.01)
+			yscale = 1.f;
+		FB_X_CLIP_type xClip = pvrrc.fb_X_CLIP;
+		FB_Y_CLIP_type yClip = pvrrc.fb_Y_CLIP;
+		const u32 *data = colorBuffer.data();
+		std::vector<u32> scaled;
+		if (xscale != 1.f || yscale != 1.f)
+		{
+			int scaledW = width * xscale;
+			int scaledH = height * yscale;
+			scaled.resize(scaledW * scaledH);
+			scaleImage(data, width, height, scaled.data(), scaledW, scaledH);
+			data = scaled.data();
+			width = scaledW;
+			height = scaledH;
+			// FB_Y_CLIP is applied before vscalefactor if > 1, so it must be scaled here
+			if (yscale > 1) {
+				yClip.min = std::round(yClip.min * yscale);
+				yClip.max = std::round(yClip.max * yscale);
+			}
+		}
+		WriteFramebuffer(width, height, (const u8 *)data, pvrrc.fb_W_SOF1 & VRAM_MASK,
+				pvrrc.fb_W_CTRL, pvrrc.fb_W_LINESTRIDE * 8, xClip, yClip);
+		return false;
+	}
+	renderFrame(pvrrc.framebufferWidth, pvrrc.framebufferHeight);
+	std::swap(frame, colorBuffer);
+	frameWidth = bufferWidth;
+	frameHeight = bufferHeight;
+	aspectRatio = getOutputFramebufferAspectRatio();
+	clearLastFrame = false;
+
+	return true;
+}
+
+void SoftRenderer::RenderFramebuffer(const FramebufferInfo& info)
+{
+	PixelBuffer<u32> pb;
+	int width;
+	int height;
+	ReadFramebuffer(info, pb, width, height);
+	if (width == 0 || height == 0)
+		return;
+	frame.resize(width * height);
+	memcpy(frame.data(), pb.data(), frame.size() * sizeof(u32));
+	frameWidth = width;
+	frameHeight = height;
+	aspectRatio = getDCFramebufferAspectRatio();
+	clearLastFrame = false;
+}
+
+bool SoftRenderer::GetLastFrame(std::vector<u8>& data, int& width, int& height)
+{
+	if (frame.empty())
+		return false;
+	if (width != 0)
+		height = width / aspectRatio;
+	else if (height != 0)
+		width = aspectRatio * height;
+	else
+	{
+		width = frameWidth;
+		height = frameHeight;
+		if (aspectRatio > (float)width / height)
+			width = height * aspectRatio;
+		else
+			height = width / aspectRatio;
+	}
+	std::vector<u32> scaled(width * height);
+	scaleImage(frame.data(), frameWidth, frameHeight, scaled.data(), width, height);
+	data.clear();
+	data.reserve(width * height * 3);
+	for (u32 pixel : scaled)
+	{
+		data.push_back(pixel & 0xff);
+		data.push_back((pixel >> 8) & 0xff);
+		data.push_back((pixel >> 16) & 0xff);
+	}
+	return true;
+}
+
+Renderer *rend_softrend() {
+	return new SoftRenderer();
+}
@@ -18,10 +18,20 @@
 #include "cfg/option.h"
 #include "hw/pvr/Renderer_if.h"
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
 #include <xxhash.h>
 
-const u8 *vq_codebook;
-u32 palette_index;
+#if HOST_CPU == CPU_X64
+#include <emmintrin.h>
+#define TEXCONV_SSE2
+#elif HOST_CPU == CPU_ARM64
+#include <arm_neon.h>
+#define TEXCONV_NEON
+#endif
+
+thread_local const u8 *vq_codebook;
+thread_local u32 palette_index;
 u32 palette16_ram[1024];
 u32 palette32_ram[1024];
 u32 pal_hash_256[4];
@@ -339,6 +349,304 @@ struct ConvertTwiddlePal8
 	}
 };
 
+//
+// 4x4 tile convertors
+// The texels of a 4x4 tile are contiguous in twiddled textures, in this order: y0 | x0 << 1 | y1 << 2 | x1 << 3
+// Each tile row is written at once, and the formats below are vectorized.
+//
+static constexpr u32 tileIndex(u32 x, u32 y) {
+	return (y & 1) | ((x & 1) << 1) | ((y & 2) << 1) | ((x & 2) << 2);
+}
+
+#if defined(TEXCONV_SSE2)
+// 4 x u32 or 8 x u16 lanes
+struct Texels
+{
+	__m128i v;
+
+	static Texels load(const void *p) { return { _mm_loadu_si128((const __m128i *)p) }; }
+	static Texels set32(u32 i) { return { _mm_set1_epi32((int)i) }; }
+	Texels operator&(const Texels& o) const { return { _mm_and_si128(v, o.v) }; }
+	Texels operator|(const Texels& o) const { return { _mm_or_si128(v, o.v) }; }
+	Texels operator-(const Texels& o) const { return { _mm_sub_epi32(v, o.v) }; }
+	template<int N> Texels shl32() const { return { _mm_slli_epi32(v, N) }; }
+	template<int N> Texels shr32() const { return { _mm_srli_epi32(v, N) }; }
+	template<int N> Texels shl16() const { return { _mm_slli_epi16(v, N) }; }
+	template<int N> Texels shr16() const { return { _mm_srli_epi16(v, N) }; }
+	// Zero-extend the low and high 4 x u16 to u32
+	Texels low16to32() const { return { _mm_unpacklo_epi16(v, _mm_setzero_si128()) }; }
+	Texels high16to32() const { return { _mm_unpackhi_epi16(v, _mm_setzero_si128()) }; }
+
+	// Write the 4 rows of a tile of 32-bit pixels. lo and hi hold texels 0-7 and 8-15
+	static void storeRows32(u32 *rows[4], const Texels lo[2], const Texels hi[2])
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			__m128i t0 = _mm_unpacklo_epi32(lo[i].v, hi[i].v);
+			__m128i t1 = _mm_unpackhi_epi32(lo[i].v, hi[i].v);
+			_mm_storeu_si128((__m128i *)rows[i * 2], _mm_unpacklo_epi32(t0, t1));
+			_mm_storeu_si128((__m128i *)rows[i * 2 + 1], _mm_unpackhi_epi32(t0, t1));
+		}
+	}
+	// Write the 4 rows of a tile of 16-bit pixels
+	static void storeRows16(u16 *rows[4], const Texels& lo, const Texels& hi)
+	{
+		// texels 0 2 1 3 4 6 5 7
+		__m128i l = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo.v, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+		__m128i h = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi.v, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+		__m128i r01 = _mm_unpacklo_epi32(l, h);
+		__m128i r23 = _mm_unpackhi_epi32(l, h);
+		_mm_storel_epi64((__m128i *)rows[0], r01);
+		_mm_storel_epi64((__m128i *)rows[1], _mm_srli_si128(r01, 8));
+		_mm_storel_epi64((__m128i *)rows[2], r23);
+		_mm_storel_epi64((__m128i *)rows[3], _mm_srli_si128(r23, 8));
+	}
+	// Reorder the 16 x 8-bit texels of a tile in row order
+	static void detileBytes(u8 *dst, const u8 *src)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)src);
+		// even bytes followed by odd bytes
+		__m128i w = _mm_packus_epi16(_mm_and_si128(v, _mm_set1_epi16(0xff)), _mm_srli_epi16(v, 8));
+		// rows 0 2 1 3
+		w = _mm_shufflehi_epi16(_mm_shufflelo_epi16(w, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi32(w, _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	// Expand the 16 x 4-bit texels of a tile to bytes, low nibble first
+	static void expandNibbles(u8 *dst, const u8 *src)
+	{
+		__m128i v = _mm_loadl_epi64((const __m128i *)src);
+		const __m128i mask = _mm_set1_epi8(0xf);
+		__m128i lo = _mm_and_si128(v, mask);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(lo, hi));
+	}
+};
+#elif defined(TEXCONV_NEON)
+// 4 x u32 or 8 x u16 lanes
+struct Texels
+{
+	uint32x4_t v;
+
+	static Texels load(const void *p) { return { vreinterpretq_u32_u8(vld1q_u8((const u8 *)p)) }; }
+	static Texels set32(u32 i) { return { vdupq_n_u32(i) }; }
+	Texels operator&(const Texels& o) const { return { vandq_u32(v, o.v) }; }
+	Texels operator|(const Texels& o) const { return { vorrq_u32(v, o.v) }; }
+	Texels operator-(const Texels& o) const { return { vsubq_u32(v, o.v) }; }
+	template<int N> Texels shl32() const { return { vshlq_n_u32(v, N) }; }
+	template<int N> Texels shr32() const { return { vshrq_n_u32(v, N) }; }
+	template<int N> Texels shl16() const { return { vreinterpretq_u32_u16(vshlq_n_u16(vreinterpretq_u16_u32(v), N)) }; }
+	template<int N> Texels shr16() const { return { vreinterpretq_u32_u16(vshrq_n_u16(vreinterpretq_u16_u32(v), N)) }; }
+	// Zero-extend the low and high 4 x u16 to u32
+	Texels low16to32() const { return { vmovl_u16(vget_low_u16(vreinterpretq_u16_u32(v))) }; }
+	Texels high16to32() const { return { vmovl_u16(vget_high_u16(vreinterpretq_u16_u32(v))) }; }
+
+	// Write the 4 rows of a tile of 32-bit pixels. lo and hi hold texels 0-7 and 8-15
+	static void storeRows32(u32 *rows[4], const Texels lo[2], const Texels hi[2])
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			uint32x4x2_t r = vuzpq_u32(lo[i].v, hi[i].v);
+			vst1q_u32(rows[i * 2], r.val[0]);
+			vst1q_u32(rows[i * 2 + 1], r.val[1]);
+		}
+	}
+	// Write the 4 rows of a tile of 16-bit pixels
+	static void storeRows16(u16 *rows[4], const Texels& lo, const Texels& hi)
+	{
+		// even texels: 0 2 4 6 8 10 12 14, odd texels: 1 3 5 7 9 11 13 15
+		uint16x8x2_t eo = vuzpq_u16(vreinterpretq_u16_u32(lo.v), vreinterpretq_u16_u32(hi.v));
+		for (int i = 0; i < 2; i++)
+		{
+			uint32x4_t t = vreinterpretq_u32_u16(eo.val[i]);
+			uint32x2x2_t r = vzip_u32(vget_low_u32(t), vget_high_u32(t));
+			vst1_u16(rows[i], vreinterpret_u16_u32(r.val[0]));
+			vst1_u16(rows[i + 2], vreinterpret_u16_u32(r.val[1]));
+		}
+	}
+	// Reorder the 16 x 8-bit texels of a tile in row order
+	static void detileBytes(u8 *dst, const u8 *src)
+	{
+		uint8x16_t v = vld1q_u8(src);
+		// even bytes: 0 2 4 6 8 10 12 14, odd bytes: 1 3 5 7 9 11 13 15
+		uint8x8x2_t eo = vuzp_u8(vget_low_u8(v), vget_high_u8(v));
+		// rows 0 and 2, rows 1 and 3
+		uint16x4x2_t r02 = vuzp_u16(vreinterpret_u16_u8(eo.val[0]), vreinterpret_u16_u8(eo.val[0]));
+		uint16x4x2_t r13 = vuzp_u16(vreinterpret_u16_u8(eo.val[1]), vreinterpret_u16_u8(eo.val[1]));
+		uint32x2_t r01 = vzip_u32(vreinterpret_u32_u16(r02.val[0]), vreinterpret_u32_u16(r13.val[0])).val[0];
+		uint32x2_t r23 = vzip_u32(vreinterpret_u32_u16(r02.val[1]), vreinterpret_u32_u16(r13.val[1])).val[0];
+		vst1q_u8(dst, vreinterpretq_u8_u32(vcombine_u32(r01, r23)));
+	}
+	// Expand the 16 x 4-bit texels of a tile to bytes, low nibble first
+	static void expandNibbles(u8 *dst, const u8 *src)
+	{
+		uint8x8_t v = vld1_u8(src);
+		uint8x8x2_t n = vzip_u8(vand_u8(v, vdup_n_u8(0xf)), vshr_n_u8(v, 4));
+		vst1q_u8(dst, vcombine_u8(n.val[0], n.val[1]));
+	}
+};
+#endif
+
+#if defined(TEXCONV_SSE2) || defined(TEXCONV_NEON)
+// Vectorized unpackers. Unpackers without a specialization use the scalar path.
+template<typename Unpacker>
+struct TexelsUnpacker {
+	static constexpr bool enabled = false;
+};
+
+template<>
+struct TexelsUnpacker<UnpackerNop<u16>> {
+	static constexpr bool enabled = true;
+	static Texels unpack(const Texels& t) {
+		return t;
+	}
+};
+
+// ARGB1555 to RGBA5551
+template<>
+struct TexelsUnpacker<Unpacker1555> {
+	static constexpr bool enabled = true;
+	static Texels unpack(const Texels& t) {
+		return t.shl16<1>() | t.shr16<15>();
+	}
+};
+
+// ARGB4444 to RGBA4444
+template<>
+struct TexelsUnpacker<Unpacker4444> {
+	static constexpr bool enabled = true;
+	static Texels unpack(const Texels& t) {
+		return t.shl16<4>() | t.shr16<12>();
+	}
+};
+
+template<typename Packer>
+static Texels packTexels(const Texels& r, const Texels& g, const Texels& b, const Texels& a)
+{
+	if constexpr (std::is_same_v<Packer, RGBAPacker>)
+		return r | g.shl32<8>() | b.shl32<16>() | a.shl32<24>();
+	else
+		return b | g.shl32<8>() | r.shl32<16>() | a.shl32<24>();
+}
+
+// 32-bit unpackers take zero-extended 16-bit texels
+template<typename Packer>
+struct TexelsUnpacker<Unpacker565_32<Packer>> {
+	static constexpr bool enabled = true;
+	static Texels unpack(const Texels& t) {
+		const Texels mask5 = Texels::set32(0x1f);
+		Texels r = t.shr32<11>() & mask5;
+		Texels g = t.shr32<5>() & Texels::set32(0x3f);
+		Texels b = t & mask5;
+		return packTexels<Packer>(r.shl32<3>() | r.shr32<2>(), g.shl32<2>() | g.shr32<4>(), b.shl32<3>() | b.shr32<2>(),
+				Texels::set32(0xff));
+	}
+};
+
+template<typename Packer>
+struct TexelsUnpacker<Unpacker1555_32<Packer>> {
+	static constexpr bool enabled = true;
+	static Texels unpack(const Texels& t) {
+		const Texels mask5 = Texels::set32(0x1f);
+		Texels r = t.shr32<10>() & mask5;
+		Texels g = t.shr32<5>() & mask5;
+		Texels b = t & mask5;
+		Texels a = t.shr32<15>();
+		return packTexels<Packer>(r.shl32<3>() | r.shr32<2>(), g.shl32<3>() | g.shr32<2>(), b.shl32<3>() | b.shr32<2>(),
+				a.shl32<8>() - a);
+	}
+};
+
+template<typename Packer>
+struct TexelsUnpacker<Unpacker4444_32<Packer>> {
+	static constexpr bool enabled = true;
+	static Texels unpack(const Texels& t) {
+		const Texels mask4 = Texels::set32(0xf);
+		Texels r = t.shr32<8>() & mask4;
+		Texels g = t.shr32<4>() & mask4;
+		Texels b = t & mask4;
+		Texels a = t.shr32<12>();
+		return packTexels<Packer>(r.shl32<4>() | r, g.shl32<4>() | g, b.shl32<4>() | b, a.shl32<4>() | a);
+	}
+};
+#endif
+
+// 4x4 tile of 16-bit texels
+template<typename Unpacker>
+struct ConvertTwiddleTile
+{
+	using unpacked_type = typename Unpacker::unpacked_type;
+	static constexpr u32 xpp = 4;
+	static constexpr u32 ypp = 4;
+	static constexpr u32 bpp = 16;
+	static void Convert(PixelBuffer<unpacked_type> *pb, const u8 *data)
+	{
+		unpacked_type *rows[4] { pb->pline(0), pb->pline(1), pb->pline(2), pb->pline(3) };
+#if defined(TEXCONV_SSE2) || defined(TEXCONV_NEON)
+		if constexpr (TexelsUnpacker<Unpacker>::enabled)
+		{
+			Texels lo = Texels::load(data);
+			Texels hi = Texels::load(data + 16);
+			if constexpr (sizeof(unpacked_type) == 2)
+			{
+				Texels::storeRows16(rows, TexelsUnpacker<Unpacker>::unpack(lo), TexelsUnpacker<Unpacker>::unpack(hi));
+			}
+			else
+			{
+				const Texels lo32[2] { TexelsUnpacker<Unpacker>::unpack(lo.low16to32()), TexelsUnpacker<Unpacker>::unpack(lo.high16to32()) };
+				const Texels hi32[2] { TexelsUnpacker<Unpacker>::unpack(hi.low16to32()), TexelsUnpacker<Unpacker>::unpack(hi.high16to32()) };
+				Texels::storeRows32(rows, lo32, hi32);
+			}
+			return;
+		}
+#endif
+		const u16 *p_in = (const u16 *)data;
+		for (u32 y = 0; y < 4; y++)
+			for (u32 x = 0; x < 4; x++)
+				rows[y][x] = Unpacker::unpack(p_in[tileIndex(x, y)]);
+	}
+};
+
+// 4x4 tile of 4-bit or 8-bit palette indices
+template<typename Unpacker, u32 Bpp>
+struct ConvertTwiddlePalTile
+{
+	using unpacked_type = typename Unpacker::unpacked_type;
+	static constexpr u32 xpp = 4;
+	static constexpr u32 ypp = 4;
+	static constexpr u32 bpp = Bpp;
+	static void Convert(PixelBuffer<unpacked_type> *pb, const u8 *data)
+	{
+		alignas(16) u8 indices[16];
+#if defined(TEXCONV_SSE2) || defined(TEXCONV_NEON)
+		if constexpr (Bpp == 4)
+		{
+			Texels::expandNibbles(indices, data);
+			Texels::detileBytes(indices, indices);
+		}
+		else
+		{
+			Texels::detileBytes(indices, data);
+		}
+#else
+		for (u32 y = 0; y < 4; y++)
+			for (u32 x = 0; x < 4; x++)
+			{
+				const u32 i = tileIndex(x, y);
+				indices[y * 4 + x] = Bpp == 4 ? (data[i / 2] >> ((i & 1) * 4)) & 0xf : data[i];
+			}
+#endif
+		for (u32 y = 0; y < 4; y++)
+		{
+			unpacked_type *row = pb->pline(y);
+			if constexpr (std::is_same_v<Unpacker, UnpackerNop<u8>>)
+				memcpy(row, &indices[y * 4], 4);
+			else
+				for (u32 x = 0; x < 4; x++)
+					row[x] = Unpacker::unpack(indices[y * 4 + x]);
+		}
+	}
+};
+
 //handler functions
 template<typename PixelConvertor>
 void texture_PL(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const u8* p_in, u32 width, u32 height)
@@ -427,17 +735,82 @@ void texture_VQ(PixelBuffer<typename PixelConvertor::unpacked_type>* pb, const u
 	}
 }
 
+// Twiddled textures converted by 4x4 tiles. Smaller mipmaps use the Fallback convertor.
+template<typename Tile, typename Fallback>
+void texture_TW_tiled(PixelBuffer<typename Tile::unpacked_type>* pb, const u8* p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		texture_TW<Fallback>(pb, p_in, width, height);
+		return;
+	}
+	pb->amove(0, 0);
+
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+
+	for (u32 y = 0; y < height; y += 4)
+	{
+		for (u32 x = 0; x < width; x += 4)
+		{
+			Tile::Convert(pb, &p_in[twop(x, y, bcx, bcy) * Tile::bpp / 8]);
+			pb->rmovex(4);
+		}
+		pb->rmovey(4);
+	}
+}
+
+// VQ textures converted by 4x4 tiles. Each tile uses 4 codebook entries.
+template<typename Tile, typename Fallback>
+void texture_VQ_tiled(PixelBuffer<typename Tile::unpacked_type>* pb, const u8* p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		texture_VQ<Fallback>(pb, p_in, width, height);
+		return;
+	}
+	pb->amove(0, 0);
+
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	alignas(16) u8 tile[32];
+
+	for (u32 y = 0; y < height; y += 4)
+	{
+		for (u32 x = 0; x < width; x += 4)
+		{
+			const u8 *idx = &p_in[twop(x, y, bcx, bcy) / 4];
+			memcpy(&tile[0], &vq_codebook[idx[0] * 8], 8);
+			memcpy(&tile[8], &vq_codebook[idx[1] * 8], 8);
+			memcpy(&tile[16], &vq_codebook[idx[2] * 8], 8);
+			memcpy(&tile[24], &vq_codebook[idx[3] * 8], 8);
+			Tile::Convert(pb, tile);
+			pb->rmovex(4);
+		}
+		pb->rmovey(4);
+	}
+}
+
+template<typename Unpacker>
+constexpr auto texture_TW16 = texture_TW_tiled<ConvertTwiddleTile<Unpacker>, ConvertTwiddle<Unpacker>>;
+template<typename Unpacker>
+constexpr auto texture_VQ16 = texture_VQ_tiled<ConvertTwiddleTile<Unpacker>, ConvertTwiddle<Unpacker>>;
+template<typename Unpacker>
+constexpr auto texture_TWPal4 = texture_TW_tiled<ConvertTwiddlePalTile<Unpacker, 4>, ConvertTwiddlePal4<Unpacker>>;
+template<typename Unpacker>
+constexpr auto texture_TWPal8 = texture_TW_tiled<ConvertTwiddlePalTile<Unpacker, 8>, ConvertTwiddlePal8<Unpacker>>;
+
 //Twiddle
-const TexConvFP tex565_TW = texture_TW<ConvertTwiddle<UnpackerNop<u16>>>;
+const TexConvFP tex565_TW = texture_TW16<UnpackerNop<u16>>;
 // Palette
-const TexConvFP texPAL4_TW = texture_TW<ConvertTwiddlePal4<UnpackerPalToRgb<u16>>>;
-const TexConvFP texPAL8_TW = texture_TW<ConvertTwiddlePal8<UnpackerPalToRgb<u16>>>;
-const TexConvFP32 texPAL4_TW32 = texture_TW<ConvertTwiddlePal4<UnpackerPalToRgb<u32>>>;
-const TexConvFP32 texPAL8_TW32 = texture_TW<ConvertTwiddlePal8<UnpackerPalToRgb<u32>>>;
-const TexConvFP8 texPAL4PT_TW = texture_TW<ConvertTwiddlePal4<UnpackerNop<u8>>>;
-const TexConvFP8 texPAL8PT_TW = texture_TW<ConvertTwiddlePal8<UnpackerNop<u8>>>;
+const TexConvFP texPAL4_TW = texture_TWPal4<UnpackerPalToRgb<u16>>;
+const TexConvFP texPAL8_TW = texture_TWPal8<UnpackerPalToRgb<u16>>;
+const TexConvFP32 texPAL4_TW32 = texture_TWPal4<UnpackerPalToRgb<u32>>;
+const TexConvFP32 texPAL8_TW32 = texture_TWPal8<UnpackerPalToRgb<u32>>;
+const TexConvFP8 texPAL4PT_TW = texture_TWPal4<UnpackerNop<u8>>;
+const TexConvFP8 texPAL8PT_TW = texture_TWPal8<UnpackerNop<u8>>;
 //VQ
-const TexConvFP tex565_VQ = texture_VQ<ConvertTwiddle<UnpackerNop<u16>>>;
+const TexConvFP tex565_VQ = texture_VQ16<UnpackerNop<u16>>;
 // According to the documentation, a texture cannot be compressed and use
 // a palette at the same time. However the hardware displays them
 // just fine.
@@ -461,24 +834,24 @@ const TexConvFP32 tex1555_PLVQ32 = texture_PLVQ<ConvertPlanar<Unpacker1555_32<RG
 const TexConvFP32 tex4444_PLVQ32 = texture_PLVQ<ConvertPlanar<Unpacker4444_32<RGBAPacker>>>;
 
 //Twiddle
-const TexConvFP tex1555_TW = texture_TW<ConvertTwiddle<Unpacker1555>>;
-const TexConvFP tex4444_TW = texture_TW<ConvertTwiddle<Unpacker4444>>;
+const TexConvFP tex1555_TW = texture_TW16<Unpacker1555>;
+const TexConvFP tex4444_TW = texture_TW16<Unpacker4444>;
 const TexConvFP texBMP_TW = tex4444_TW;
 const TexConvFP32 texYUV422_TW = texture_TW<ConvertTwiddleYUV<RGBAPacker>>;
 
-const TexConvFP32 tex565_TW32 = texture_TW<ConvertTwiddle<Unpacker565_32<RGBAPacker>>>;
-const TexConvFP32 tex1555_TW32 = texture_TW<ConvertTwiddle<Unpacker1555_32<RGBAPacker>>>;
-const TexConvFP32 tex4444_TW32 = texture_TW<ConvertTwiddle<Unpacker4444_32<RGBAPacker>>>;
+const TexConvFP32 tex565_TW32 = texture_TW16<Unpacker565_32<RGBAPacker>>;
+const TexConvFP32 tex1555_TW32 = texture_TW16<Unpacker1555_32<RGBAPacker>>;
+const TexConvFP32 tex4444_TW32 = texture_TW16<Unpacker4444_32<RGBAPacker>>;
 
 //VQ
-const TexConvFP tex1555_VQ = texture_VQ<ConvertTwiddle<Unpacker1555>>;
-const TexConvFP tex4444_VQ = texture_VQ<ConvertTwiddle<Unpacker4444>>;
+const TexConvFP tex1555_VQ = texture_VQ16<Unpacker1555>;
+const TexConvFP tex4444_VQ = texture_VQ16<Unpacker4444>;
 const TexConvFP texBMP_VQ = tex4444_VQ;
 const TexConvFP32 texYUV422_VQ = texture_VQ<ConvertTwiddleYUV<RGBAPacker>>;
 
-const TexConvFP32 tex565_VQ32 = texture_VQ<ConvertTwiddle<Unpacker565_32<RGBAPacker>>>;
-const TexConvFP32 tex1555_VQ32 = texture_VQ<ConvertTwiddle<Unpacker1555_32<RGBAPacker>>>;
-const TexConvFP32 tex4444_VQ32 = texture_VQ<ConvertTwiddle<Unpacker4444_32<RGBAPacker>>>;
+const TexConvFP32 tex565_VQ32 = texture_VQ16<Unpacker565_32<RGBAPacker>>;
+const TexConvFP32 tex1555_VQ32 = texture_VQ16<Unpacker1555_32<RGBAPacker>>;
+const TexConvFP32 tex4444_VQ32 = texture_VQ16<Unpacker4444_32<RGBAPacker>>;
 }
 
 namespace directx {
@@ -496,24 +869,24 @@ const TexConvFP32 tex1555_PLVQ32 = texture_PLVQ<ConvertPlanar<Unpacker1555_32<BG
 const TexConvFP32 tex4444_PLVQ32 = texture_PLVQ<ConvertPlanar<Unpacker4444_32<BGRAPacker>>>;
 
 //Twiddle
-const TexConvFP tex1555_TW = texture_TW<ConvertTwiddle<UnpackerNop<u16>>>;
-const TexConvFP tex4444_TW = texture_TW<ConvertTwiddle<UnpackerNop<u16>>>;
+const TexConvFP tex1555_TW = texture_TW16<UnpackerNop<u16>>;
+const TexConvFP tex4444_TW = texture_TW16<UnpackerNop<u16>>;
 const TexConvFP texBMP_TW = tex4444_TW;
 const TexConvFP32 texYUV422_TW = texture_TW<ConvertTwiddleYUV<BGRAPacker>>;
 
-const TexConvFP32 tex565_TW32 = texture_TW<ConvertTwiddle<Unpacker565_32<BGRAPacker>>>;
-const TexConvFP32 tex1555_TW32 = texture_TW<ConvertTwiddle<Unpacker1555_32<BGRAPacker>>>;
-const TexConvFP32 tex4444_TW32 = texture_TW<ConvertTwiddle<Unpacker4444_32<BGRAPacker>>>;
+const TexConvFP32 tex565_TW32 = texture_TW16<Unpacker565_32<BGRAPacker>>;
+const TexConvFP32 tex1555_TW32 = texture_TW16<Unpacker1555_32<BGRAPacker>>;
+const TexConvFP32 tex4444_TW32 = texture_TW16<Unpacker4444_32<BGRAPacker>>;
 
 //VQ
-const TexConvFP tex1555_VQ = texture_VQ<ConvertTwiddle<UnpackerNop<u16>>>;
-const TexConvFP tex4444_VQ = texture_VQ<ConvertTwiddle<UnpackerNop<u16>>>;
+const TexConvFP tex1555_VQ = texture_VQ16<UnpackerNop<u16>>;
+const TexConvFP tex4444_VQ = texture_VQ16<UnpackerNop<u16>>;
 const TexConvFP texBMP_VQ = tex4444_VQ;
 const TexConvFP32 texYUV422_VQ = texture_VQ<ConvertTwiddleYUV<BGRAPacker>>;
 
-const TexConvFP32 tex565_VQ32 = texture_VQ<ConvertTwiddle<Unpacker565_32<BGRAPacker>>>;
-const TexConvFP32 tex1555_VQ32 = texture_VQ<ConvertTwiddle<Unpacker1555_32<BGRAPacker>>>;
-const TexConvFP32 tex4444_VQ32 = texture_VQ<ConvertTwiddle<Unpacker4444_32<BGRAPacker>>>;
+const TexConvFP32 tex565_VQ32 = texture_VQ16<Unpacker565_32<BGRAPacker>>;
+const TexConvFP32 tex1555_VQ32 = texture_VQ16<Unpacker1555_32<BGRAPacker>>;
+const TexConvFP32 tex4444_VQ32 = texture_VQ16<Unpacker4444_32<BGRAPacker>>;
 }
 
 #define TEX_CONV_TABLE \
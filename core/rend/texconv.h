@@ -18,8 +18,9 @@
 #include "types.h"
 
 constexpr int VQ_CODEBOOK_SIZE = 256 * 8;
-extern const u8 *vq_codebook;
-extern u32 palette_index;
+// Thread local so that textures can be decoded on worker threads
+extern thread_local const u8 *vq_codebook;
+extern thread_local u32 palette_index;
 extern u32 palette16_ram[1024];
 extern u32 palette32_ram[1024];
 extern u32 pal_hash_256[4];
@@ -108,6 +109,12 @@ public:
 		p_current_pixel[y * pixels_per_line + x] = value;
 	}
 
+	// Pointer to the current pixel, y lines below
+	Pixel *pline(u32 y)
+	{
+		return p_current_pixel + y * pixels_per_line;
+	}
+
 	void rmovex(u32 value)
 	{
 		p_current_pixel += value;
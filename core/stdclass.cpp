@@ -7,6 +7,7 @@
 
 #include <chrono>
 #include <cstring>
+#include <string_view>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <vector>
@@ -141,6 +142,16 @@ std::string get_game_save_prefix()
 	return get_writable_data_path(settings.content.fileName);
 }
 
+std::string get_game_id_file_name(const std::string& gameId)
+{
+	constexpr std::string_view INVALID_CHARS { " /\\:*?|<>\"" };
+	std::string name = gameId;
+	for (char &c: name)
+		if (INVALID_CHARS.find(c) != INVALID_CHARS.npos)
+			c = '_';
+	return name;
+}
+
 bool make_directory(const std::string& path)
 {
 	return flycast::mkdir(path.c_str(), 0755) == 0;
@@ -80,6 +80,8 @@ bool make_directory(const std::string& path);
 
 // returns a prefix for a game save file, for example: ~/.local/share/flycast/mvsc2.zip
 std::string get_game_save_prefix();
+// returns the game id with the characters that aren't valid in file names replaced by '_'
+std::string get_game_id_file_name(const std::string& gameId);
 // returns the position of the last path separator, or string::npos if none
 size_t get_last_slash_pos(const std::string& path);
 
@@ -102,6 +102,7 @@ enum class RenderType {
 	DirectX9 = 1,
 	DirectX11 = 2,
 	DirectX11_OIT = 6,
+	Software = 7,	// headless builds only
 };
 
 static inline bool isOpenGL(RenderType renderType)  {
@@ -27,6 +27,9 @@
 #ifdef GDB_SERVER
 #include "hw/mem/addrspace.h"
 #endif
+#if FEAT_SHREC != DYNAREC_NONE
+#include "hw/sh4/dyna/blockmanager.h"
+#endif
 
 #if defined(USE_DREAMLINK_DEVICES)
 #include "sdl/dreamlink.h"
@@ -48,6 +51,10 @@ static void gui_settings_advanced()
 		OptionSlider("SH4 Clock", config::Sh4Clock, 100, 300,
 				"Over/Underclock the main SH4 CPU. Default is 200 MHz. Other values may crash, freeze or trigger unexpected nuclear reactions.",
 				"%d MHz");
+		OptionCheckbox("Persistent Block Cache", config::DynarecPersistentCache,
+				"Save decoded SH4 blocks to disk so that they don't need to be decoded again next time the game is started");
+		OptionCheckbox("Background Block Decoding", config::DynarecBackgroundDecoding,
+				"Decode upcoming SH4 blocks on a separate thread to reduce compilation stutter");
     }
 #ifdef GDB_SERVER
 	ImGui::Spacing();
@@ -117,6 +124,8 @@ static void gui_settings_advanced()
 					"Always dump textures that are already replaced by custom textures");
 		}
 		ImGui::Unindent();
+        OptionCheckbox("Dump Display Lists", config::DumpDisplayLists,
+        		"Capture the display lists of each frame into data/tacapture/<game id> for offline replay");
         bool logToFile = cfgLoadBool("log", "LogToFile", false);
 		if (ImGui::Checkbox("Log to File", &logToFile))
 			cfgSaveBool("log", "LogToFile", logToFile);
@@ -175,6 +184,49 @@ static void gui_debug_tab()
         ImGui::SameLine();
         ShowHelpMarker("Log to this hostname[:port] with UDP. Default port is 31667.");
 	}
+#if FEAT_SHREC != DYNAREC_NONE
+	ImGui::Spacing();
+	header("Dynarec Block Profiler");
+	{
+		OptionCheckbox("Count Block Executions", config::DynarecBlockProfiler,
+				"Count the number of times each dynarec block is executed. Only applies to blocks compiled after it's enabled.");
+		if (config::DynarecBlockProfiler && game_started)
+		{
+			if (ImGui::Button("Write Block Map"))
+				bm_WriteBlockMap(get_writable_data_path("blockmap.txt"));
+			ImGui::SameLine();
+			ShowHelpMarker("Save the hot blocks and the code of all blocks to blockmap.txt in the data folder");
+			if (ImGui::BeginTable("hotBlocks", 6, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_NoSavedSettings))
+			{
+				ImGui::TableSetupColumn("Address");
+				ImGui::TableSetupColumn("Runs");
+				ImGui::TableSetupColumn("Cycles");
+				ImGui::TableSetupColumn("Host Size");
+				ImGui::TableSetupColumn("Opcodes");
+				ImGui::TableSetupColumn("SMC");
+				ImGui::TableHeadersRow();
+
+				for (const BlockProfile& profile : bm_GetHotBlocks(20))
+				{
+					ImGui::TableNextRow();
+					ImGui::TableSetColumnIndex(0);
+					ImGui::Text("%08X", profile.addr);
+					ImGui::TableSetColumnIndex(1);
+					ImGui::Text("%llu", (unsigned long long)profile.runs);
+					ImGui::TableSetColumnIndex(2);
+					ImGui::Text("%llu", (unsigned long long)profile.cycles);
+					ImGui::TableSetColumnIndex(3);
+					ImGui::Text("%d", profile.host_code_size);
+					ImGui::TableSetColumnIndex(4);
+					ImGui::Text("%d", profile.guest_opcodes);
+					ImGui::TableSetColumnIndex(5);
+					ImGui::Text("%d", profile.smc_invalidations);
+				}
+				ImGui::EndTable();
+			}
+		}
+	}
+#endif
 #if FC_PROFILER
 	ImGui::Spacing();
 	header("Profiling");
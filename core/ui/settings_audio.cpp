@@ -25,6 +25,11 @@ void gui_settings_audio()
 	OptionCheckbox("Enable DSP", config::DSPEnabled,
 			"Enable the Dreamcast Digital Sound Processor. Only recommended on fast platforms");
     OptionCheckbox("Enable VMU Sounds", config::VmuSound, "Play VMU beeps when enabled.");
+	{
+		DisabledScope scope(game_started);
+		OptionCheckbox("Threaded Sound Generation", config::ThreadedAudio,
+				"Generate sound on a separate thread. Faster on multi-core CPUs but slightly less accurate");
+	}
 
 	if (OptionSlider("Volume Level", config::AudioVolume, 0, 100, "Adjust the emulator's audio level", "%d%%"))
 	{
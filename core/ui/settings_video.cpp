@@ -313,6 +313,17 @@ void gui_settings_video()
     	OptionCheckbox("Shadows", config::ModifierVolumes,
     			"Enable modifier volumes, usually used for shadows");
     	OptionCheckbox("Fog", config::Fog, "Enable fog effects");
+    	OptionCheckbox("Asynchronous Texture Decoding", config::AsyncTextureDecode,
+    			"Decode and upscale updated textures on a background thread. The previous version of a texture is used until the new one is ready");
+    	OptionSlider("Decoded Texture Cache", config::DecodedTextureCacheSize, 0, 256,
+    			"Keep decoded and upscaled textures in memory to reuse them when the same texture is loaded again. 0 to disable", "%d MB");
+    	OptionCheckbox("Save Upscaled Textures", config::UpscaledTextureDiskCache,
+    			"Save upscaled textures to disk and reuse them in the next sessions. Uses up to 1 GB of disk space per game");
+    	{
+    		DisabledScope scope(!config::UpscaledTextureDiskCache);
+    		OptionSlider("Preloaded Textures", config::TextureDiskCachePreloadSize, 0, 1024,
+    				"Amount of saved textures loaded in memory when a game starts", "%d MB");
+    	}
     }
     ImGui::Spacing();
 	header("Advanced");
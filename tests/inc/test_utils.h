@@ -1,4 +1,11 @@
 #pragma once
+#include "gtest/gtest.h"
+#include <cstdlib>
+
+// Benchmarks only run when the FLYCAST_BENCHMARK environment variable is set
+#define SKIP_UNLESS_BENCHMARK() \
+	if (std::getenv("FLYCAST_BENCHMARK") == nullptr) \
+		GTEST_SKIP() << "FLYCAST_BENCHMARK not set"
 
 #if defined(_WIN32)
 
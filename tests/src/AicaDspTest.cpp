@@ -0,0 +1,199 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/addrspace.h"
+#include "hw/aica/aica.h"
+#include "hw/aica/aica_mem.h"
+#include "hw/aica/dsp.h"
+#include "archive/rzip.h"
+#include "oslib/directory.h"
+#include "serialize.h"
+#include "stdclass.h"
+#include "emulator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+using namespace aica;
+
+class AicaDspTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		if (!addrspace::reserve())
+			die("addrspace::reserve failed");
+		emu.init();
+		emu.dc_reset(true);
+	}
+
+	void writeInstruction(u32 step, u16 w0, u16 w1, u16 w2, u16 w3)
+	{
+		const u16 words[] { w0, w1, w2, w3 };
+		for (u32 i = 0; i < 4; i++)
+			writeRegInternal<u16>(0x3400 + (step * 4 + i) * 4, words[i]);
+	}
+
+	// EFREG[0] = EXTS[0] * COEF[0]
+	void writeProgram()
+	{
+		// ACC = INPUTS(EXTS[0]) * COEF[0]
+		writeInstruction(0, 0, 0x8000 | (1 << 13) | (0x30 << 7), 2, 0);
+		// EFREG[0] = SHIFTED
+		writeInstruction(1, 0, 0, 0x1000, 0);
+		// FRC_REG is never used
+		writeInstruction(2, 0, 0, 0x40, 0);
+		// MEMVAL is never used
+		writeInstruction(3, 0, 0, 0x2000, 0);
+		writeRegInternal<u16>(0x3000, 0x4000);	// COEF[0] = 0.5
+		DSPData->EXTS[0] = 0x1000;
+	}
+
+	// Savestates start with a header and a png screenshot, followed by the compressed state
+	static bool loadState(const std::string& path, std::vector<u8>& data)
+	{
+		FILE *f = nowide::fopen(path.c_str(), "rb");
+		if (f == nullptr)
+			return false;
+		struct {
+			char magic[8];
+			u64 creationDate;
+			u32 version;
+			u32 pngSize;
+		} header;
+		if (std::fread(&header, sizeof(header), 1, f) == 1 && !memcmp(header.magic, "FLYSAVE1", sizeof(header.magic)))
+			std::fseek(f, header.pngSize, SEEK_CUR);
+		else
+			std::fseek(f, 0, SEEK_SET);
+		RZipFile zipFile;
+		if (!zipFile.Open(f, false))
+		{
+			std::fclose(f);
+			return false;
+		}
+		data.resize(zipFile.Size());
+		return zipFile.Read(data.data(), data.size()) == data.size();
+	}
+};
+
+TEST_F(AicaDspTest, DeadSteps)
+{
+	writeProgram();
+	dsp::step();
+	ASSERT_EQ(0x800u, DSPData->EFREG[0]);
+
+	ASSERT_EQ(2, dsp::program.liveSteps);
+	const dsp::StepInfo& step0 = dsp::program.steps[0];
+	ASSERT_TRUE(step0.live);
+	ASSERT_TRUE(step0.acc);
+	ASSERT_TRUE(step0.inputs);
+	ASSERT_FALSE(step0.shifter);
+	const dsp::StepInfo& step1 = dsp::program.steps[1];
+	ASSERT_TRUE(step1.live);
+	ASSERT_TRUE(step1.shifter);
+	ASSERT_FALSE(step1.acc);
+	ASSERT_FALSE(step1.inputs);
+	for (int step = 2; step < 128; step++)
+		ASSERT_FALSE(dsp::program.steps[step].live);
+}
+
+TEST_F(AicaDspTest, ConstantCoef)
+{
+	writeProgram();
+	dsp::step();
+	ASSERT_TRUE(dsp::program.constCoef[0]);
+	ASSERT_FALSE(dsp::program.constCoef[1]);
+
+	// Writing the same value doesn't recompile
+	writeRegInternal<u16>(0x3000, 0x4000);
+	ASSERT_FALSE(dsp::state.dirty);
+
+	// A new value is recompiled as a constant
+	writeRegInternal<u16>(0x3000, 0x2000);
+	ASSERT_TRUE(dsp::state.dirty);
+	dsp::step();
+	ASSERT_EQ(0x400u, DSPData->EFREG[0]);
+	ASSERT_TRUE(dsp::program.constCoef[0]);
+
+	// and is read from memory once it changes again
+	writeRegInternal<u16>(0x3000, 0x4000);
+	dsp::step();
+	ASSERT_EQ(0x800u, DSPData->EFREG[0]);
+	ASSERT_FALSE(dsp::program.constCoef[0]);
+	writeRegInternal<u16>(0x3000, 0x2000);
+	ASSERT_FALSE(dsp::state.dirty);
+	dsp::step();
+	ASSERT_EQ(0x400u, DSPData->EFREG[0]);
+
+	// A new program resets the constants
+	writeInstruction(4, 0, 0, 0, 0x100);
+	dsp::step();
+	ASSERT_TRUE(dsp::program.constCoef[0]);
+}
+
+//
+// Run the DSP program of the savestates found in the FLYCAST_DSP_SAVESTATES directory.
+// Games usually set up their DSP program at boot so any savestate will do.
+//
+TEST_F(AicaDspTest, Benchmark)
+{
+	const char *dirName = std::getenv("FLYCAST_DSP_SAVESTATES");
+	if (dirName == nullptr)
+		GTEST_SKIP() << "FLYCAST_DSP_SAVESTATES not set";
+	DIR *dir = flycast::opendir(dirName);
+	ASSERT_NE(nullptr, dir);
+	std::vector<std::string> files;
+	while (dirent *entry = flycast::readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name.size() > 6 && name.substr(name.size() - 6) == ".state")
+			files.push_back(name);
+	}
+	flycast::closedir(dir);
+	std::sort(files.begin(), files.end());
+
+	constexpr int SAMPLES = 44100 * 10;
+	using the_clock = std::chrono::high_resolution_clock;
+	for (const std::string& file : files)
+	{
+		std::vector<u8> data;
+		if (!loadState(std::string(dirName) + "/" + file, data))
+			continue;
+		try {
+			Deserializer deser(data.data(), data.size());
+			dc_deserialize(deser);
+		} catch (const Deserializer::Exception& e) {
+			printf("%s: %s\n", file.c_str(), e.what());
+			continue;
+		}
+		dsp::step();
+		if (dsp::state.stopped)
+		{
+			printf("%s: no DSP program\n", file.c_str());
+			continue;
+		}
+		auto start = the_clock::now();
+		for (int i = 0; i < SAMPLES; i++)
+			dsp::step();
+		std::chrono::duration<double> time = the_clock::now() - start;
+		printf("%s: %3d live steps, %.2f Msamples/s\n", file.c_str(), dsp::program.liveSteps,
+				SAMPLES / time.count() / 1000000.0);
+	}
+}
@@ -0,0 +1,251 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "test_utils.h"
+#include "types.h"
+#include "cfg/option.h"
+#include "hw/mem/addrspace.h"
+#include "hw/aica/aica.h"
+#include "hw/aica/aica_if.h"
+#include "hw/aica/aica_mem.h"
+#include "hw/aica/sgc_if.h"
+#include "audio/audiostream.h"
+#include "emulator.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace aica;
+
+// Keeps the generated samples
+class CaptureBackend : public AudioBackend
+{
+public:
+	CaptureBackend()
+		: AudioBackend("capture", "Capture") {}
+
+	bool init() override {
+		return true;
+	}
+
+	u32 push(const void *data, u32 frames, bool wait) override
+	{
+		const u32 *p = (const u32 *)data;
+		samples.insert(samples.end(), p, p + frames);
+		return frames;
+	}
+
+	std::vector<u32> samples;
+};
+static CaptureBackend captureBackend;
+
+class AicaSgcTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		if (!addrspace::reserve())
+			die("addrspace::reserve failed");
+		emu.init();
+		emu.dc_reset(true);
+		fillRam();
+		CommonData->MVOL = 15;
+	}
+
+	void TearDown() override
+	{
+		TermAudio();
+		config::AudioBackend.reset();
+		config::DSPEnabled.reset();
+		if (config::ThreadedAudio)
+		{
+			config::ThreadedAudio.reset();
+			sgc::term();
+			sgc::init();
+		}
+	}
+
+	void fillRam()
+	{
+		std::mt19937 rng(42);
+		for (u32 i = 0; i < 0x10000; i++)
+			aica_ram[i] = rng();
+	}
+
+	void writeReg(u32 channel, u32 reg, u16 value)
+	{
+		*(u16 *)&aica_reg[channel * 0x80 + reg] = value;
+		sgc::WriteChannelReg(channel, reg, 2);
+	}
+
+	// Looping 16-bit PCM channel at the native sample rate
+	void setupChannel(u32 channel)
+	{
+		writeReg(channel, 0x00, (1 << 9));		// LPCTL, PCMS=0, SA=0
+		writeReg(channel, 0x04, 0);				// SA
+		writeReg(channel, 0x08, 0);				// LSA
+		writeReg(channel, 0x0C, 0x7000);		// LEA
+		writeReg(channel, 0x10, 31);			// AR
+		writeReg(channel, 0x14, 31);			// RR
+		writeReg(channel, 0x18, 0);				// OCT, FNS
+		writeReg(channel, 0x24, (15 << 8) | (channel & 0x1f));	// DISDL, DIPAN
+		writeReg(channel, 0x28, 0);				// TL, Q
+		for (u32 reg = 0x2C; reg <= 0x3C; reg += 4)
+			writeReg(channel, reg, 0x1FF8);		// FLV0-4
+		writeReg(channel, 0x40, 0);
+		writeReg(channel, 0x44, 0);
+	}
+
+	void keyOn(u32 channel, bool on)
+	{
+		u16 reg0 = *(u16 *)&aica_reg[channel * 0x80] & ~(1 << 14);
+		writeReg(channel, 0x00, reg0 | (on << 14) | (1 << 15));
+	}
+
+	u32 currentAddress(u32 channel)
+	{
+		sgc::sync();
+		CommonData->MSLC = channel;
+		sgc::ReadCommonReg(0x2814, false);
+		return CommonData->CA;
+	}
+
+	void run(int samples)
+	{
+		for (int i = 0; i < samples; i++)
+			sgc::AICA_Sample();
+	}
+
+	void keyOnOff()
+	{
+		setupChannel(5);
+		keyOn(5, true);
+		run(100);
+		u32 ca = currentAddress(5);
+		ASSERT_NE(0u, ca);
+		run(100);
+		ASSERT_LT(ca, currentAddress(5));
+
+		// The channel stops playing once released
+		keyOn(5, false);
+		run(44100);
+		ASSERT_EQ(0u, currentAddress(5));
+		run(100);
+		ASSERT_EQ(0u, currentAddress(5));
+
+		// and starts again at the next key on
+		keyOn(5, true);
+		run(100);
+		ASSERT_NE(0u, currentAddress(5));
+	}
+
+	// Play a channel through a DSP program while the program, COEF and MVOL change
+	std::vector<u32> dspOutput(bool threaded)
+	{
+		config::ThreadedAudio = threaded;
+		aica::reset(true);
+		fillRam();
+		captureBackend.samples.clear();
+
+		writeRegInternal<u16>(0x2800, 15);				// MVOL
+		writeRegInternal<u16>(0x2804, (1 << 13) | 4);	// RBL, RBP
+		writeRegInternal<u16>(0x2000, (15 << 8) | 0);	// EFSDL, EFPAN 0
+		writeRegInternal<u16>(0x2004, (13 << 8) | 0x1f);	// EFSDL, EFPAN 1
+		setupChannel(5);
+		writeReg(5, 0x20, 15 << 4);		// IMXL, ISEL=0
+		writeRegInternal<u16>(0x3000, 0x4000);			// COEF[0]
+		// step 0: MIXS[0] * COEF[0]
+		writeRegInternal<u16>(0x3400 + 4, 0x8000 | (1 << 13) | (0x20 << 7));
+		writeRegInternal<u16>(0x3400 + 8, 2);
+		// step 1: write the result to EFREG[0]
+		writeRegInternal<u16>(0x3410 + 8, 0x1000 | 2);
+		keyOn(5, true);
+		run(1000);
+
+		writeRegInternal<u16>(0x3000, 0xe000);
+		run(777);
+		std::vector<u32> output;
+		output.push_back(readRegInternal<u16>(0x4580));	// EFREG[0]
+
+		writeRegInternal<u16>(0x2800, 8);
+		run(500);
+		// EFREG[1]
+		writeRegInternal<u8>(0x3410 + 9, 0x11);
+		run(333);
+		writeRegInternal<u16>(0x3000, 0x7ff8);
+		writeRegInternal<u16>(0x2000, (10 << 8) | 0x10);
+		writeRegInternal<u16>(0x2800, (1 << 15) | 12);	// Mono
+		// 6144 samples in total, a multiple of SAMPLE_COUNT
+		run(3534);
+		sgc::sync();
+
+		output.insert(output.end(), captureBackend.samples.begin(), captureBackend.samples.end());
+		return output;
+	}
+};
+
+TEST_F(AicaSgcTest, KeyOnOff)
+{
+	keyOnOff();
+}
+
+TEST_F(AicaSgcTest, Threaded)
+{
+	config::ThreadedAudio = true;
+	sgc::term();
+	sgc::init();
+	keyOnOff();
+}
+
+TEST_F(AicaSgcTest, ThreadedDsp)
+{
+	config::DSPEnabled = true;
+	config::AudioBackend = "capture";
+	InitAudio();
+
+	std::vector<u32> expected = dspOutput(false);
+	std::vector<u32> output = dspOutput(true);
+	ASSERT_NE(0u, expected[0]);
+	ASSERT_EQ(expected.size(), output.size());
+	ASSERT_LT(1u + SAMPLE_COUNT, output.size());
+	// The first samples captured may have been generated by a previous test
+	for (size_t i = 1 + SAMPLE_COUNT; i < output.size(); i++)
+		ASSERT_EQ(expected[i], output[i]) << "sample " << i;
+	ASSERT_EQ(expected[0], output[0]);
+}
+
+TEST_F(AicaSgcTest, Benchmark)
+{
+	SKIP_UNLESS_BENCHMARK();
+	using the_clock = std::chrono::high_resolution_clock;
+	constexpr int SAMPLES = 44100;
+
+	for (u32 channel = 0; channel < 64; channel++)
+		setupChannel(channel);
+	u32 playing = 0;
+	for (u32 count : { 0, 1, 8, 16, 32, 64 })
+	{
+		for (; playing < count; playing++)
+			keyOn(playing, true);
+		auto start = the_clock::now();
+		run(SAMPLES);
+		std::chrono::duration<double> time = the_clock::now() - start;
+		printf("%2d channels: %.2f Msamples/s\n", count, SAMPLES / time.count() / 1000000.0);
+	}
+}
@@ -0,0 +1,242 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "test_utils.h"
+#include "types.h"
+#include "hw/mem/addrspace.h"
+#include "emulator.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/dyna/blockmanager.h"
+#include "hw/sh4/dyna/ngen.h"
+#include "cfg/option.h"
+#include <algorithm>
+#include <chrono>
+
+#if FEAT_SHREC != DYNAREC_NONE
+
+// Blocks are never executed so their host code only needs to be addressable
+static u8 fakeCode[1_MB];
+constexpr u32 HOST_SIZE = 64;
+constexpr u32 BASE_ADDR = 0x8c100000;
+
+class BlockManagerTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		if (!addrspace::reserve())
+			die("addrspace::reserve failed");
+		emu.init();
+		mem_map_default();
+		emu.dc_reset(true);
+		bm_ResetCache();
+	}
+
+	void TearDown() override
+	{
+		bm_ResetCache();
+		bm_Reset();
+	}
+
+	RuntimeBlockInfo *addBlock(u32 index, u32 addr, u32 sh4Size = 32, u32 hostSize = HOST_SIZE)
+	{
+		RuntimeBlockInfo *block = new RuntimeBlockInfo();
+		block->addr = block->vaddr = addr;
+		block->code = (DynarecCodeEntryPtr)&fakeCode[index * HOST_SIZE];
+		block->host_code_size = hostSize;
+		block->sh4_code_size = sh4Size;
+		block->BranchBlock = NullAddress;
+		block->NextBlock = NullAddress;
+		block->SetProtectedFlags();
+		bm_AddBlock(block);
+		return block;
+	}
+};
+
+TEST_F(BlockManagerTest, Lookup)
+{
+	RuntimeBlockInfo *b0 = addBlock(0, BASE_ADDR);
+	RuntimeBlockInfo *b1 = addBlock(1, BASE_ADDR + 0x100);
+	RuntimeBlockInfo *b2 = addBlock(3, BASE_ADDR + 0x200);
+
+	ASSERT_EQ(b0, bm_GetBlock(&fakeCode[0]).get());
+	ASSERT_EQ(b0, bm_GetBlock(&fakeCode[HOST_SIZE - 1]).get());
+	ASSERT_EQ(b1, bm_GetBlock(&fakeCode[HOST_SIZE]).get());
+	// gap between b1 and b2
+	ASSERT_EQ(nullptr, bm_GetBlock(&fakeCode[2 * HOST_SIZE]).get());
+	ASSERT_EQ(b2, bm_GetBlock(&fakeCode[3 * HOST_SIZE + 10]).get());
+	ASSERT_EQ(nullptr, bm_GetBlock(&fakeCode[4 * HOST_SIZE]).get());
+	ASSERT_EQ(b1, bm_GetBlock(BASE_ADDR + 0x100).get());
+
+	bm_DiscardBlock(b1);
+	ASSERT_EQ(nullptr, bm_GetBlock(&fakeCode[HOST_SIZE]).get());
+	ASSERT_EQ(nullptr, bm_GetBlock(BASE_ADDR + 0x100).get());
+	ASSERT_EQ(b1, bm_GetStaleBlock(&fakeCode[HOST_SIZE]).get());
+	ASSERT_EQ(b0, bm_GetBlock(&fakeCode[0]).get());
+	ASSERT_EQ(b2, bm_GetBlock(&fakeCode[3 * HOST_SIZE]).get());
+
+	// insert out of order
+	RuntimeBlockInfo *b3 = addBlock(2, BASE_ADDR + 0x300);
+	ASSERT_EQ(b3, bm_GetBlock(&fakeCode[2 * HOST_SIZE + 1]).get());
+	ASSERT_EQ(b2, bm_GetBlock(&fakeCode[3 * HOST_SIZE]).get());
+}
+
+TEST_F(BlockManagerTest, DiscardCode)
+{
+	RuntimeBlockInfo *b0 = addBlock(0, BASE_ADDR);
+	addBlock(1, BASE_ADDR + 0x100);
+	addBlock(2, BASE_ADDR + 0x200);
+	RuntimeBlockInfo *b3 = addBlock(3, BASE_ADDR + 0x300);
+
+	ASSERT_EQ(2u, bm_DiscardCode(&fakeCode[HOST_SIZE], &fakeCode[3 * HOST_SIZE]));
+	ASSERT_EQ(b0, bm_GetBlock(BASE_ADDR).get());
+	ASSERT_EQ(nullptr, bm_GetBlock(BASE_ADDR + 0x100).get());
+	ASSERT_EQ(nullptr, bm_GetBlock(BASE_ADDR + 0x200).get());
+	ASSERT_EQ(b3, bm_GetBlock(&fakeCode[3 * HOST_SIZE]).get());
+
+	// reuse the code area
+	RuntimeBlockInfo *b4 = addBlock(1, BASE_ADDR + 0x400);
+	ASSERT_EQ(b4, bm_GetBlock(&fakeCode[HOST_SIZE]).get());
+	ASSERT_EQ(0u, bm_DiscardCode(&fakeCode[2 * HOST_SIZE], &fakeCode[3 * HOST_SIZE]));
+
+	// a larger block covering several discarded ones
+	ASSERT_EQ(2u, bm_DiscardCode(&fakeCode[HOST_SIZE], &fakeCode[4 * HOST_SIZE]));
+	RuntimeBlockInfo *b5 = addBlock(1, BASE_ADDR + 0x500, 32, 3 * HOST_SIZE);
+	ASSERT_EQ(b5, bm_GetBlock(&fakeCode[HOST_SIZE]).get());
+	ASSERT_EQ(b5, bm_GetBlock(&fakeCode[2 * HOST_SIZE + 1]).get());
+	ASSERT_EQ(b5, bm_GetBlock(&fakeCode[4 * HOST_SIZE - 1]).get());
+	ASSERT_EQ(b0, bm_GetBlock(&fakeCode[0]).get());
+	ASSERT_EQ(nullptr, bm_GetBlock(&fakeCode[4 * HOST_SIZE]).get());
+}
+
+TEST_F(BlockManagerTest, RamWriteAccess)
+{
+	RuntimeBlockInfo *b0 = addBlock(0, BASE_ADDR);
+	// spans two pages
+	RuntimeBlockInfo *b1 = addBlock(1, BASE_ADDR + PAGE_SIZE - 0x10);
+	RuntimeBlockInfo *b2 = addBlock(2, BASE_ADDR + PAGE_SIZE + 0x100);
+	RuntimeBlockInfo *b3 = addBlock(3, BASE_ADDR + 2 * PAGE_SIZE);
+	ASSERT_TRUE(b0->read_only && b1->read_only && b2->read_only && b3->read_only);
+
+	bm_RamWriteAccess(BASE_ADDR + PAGE_SIZE + 4);
+	ASSERT_EQ(b0, bm_GetBlock(BASE_ADDR).get());
+	ASSERT_EQ(nullptr, bm_GetBlock(BASE_ADDR + PAGE_SIZE - 0x10).get());
+	ASSERT_EQ(nullptr, bm_GetBlock(BASE_ADDR + PAGE_SIZE + 0x100).get());
+	ASSERT_EQ(b3, bm_GetBlock(BASE_ADDR + 2 * PAGE_SIZE).get());
+	ASSERT_FALSE(bm_IsRamPageProtected(BASE_ADDR + PAGE_SIZE));
+	ASSERT_TRUE(bm_IsRamPageProtected(BASE_ADDR));
+
+	// b1 must have been removed from the first page list as well
+	bm_RamWriteAccess(BASE_ADDR);
+	ASSERT_EQ(nullptr, bm_GetBlock(BASE_ADDR).get());
+	ASSERT_EQ(b3, bm_GetBlock(BASE_ADDR + 2 * PAGE_SIZE).get());
+}
+
+TEST_F(BlockManagerTest, HotBlocks)
+{
+	config::DynarecBlockProfiler = true;
+	RuntimeBlockInfo *b0 = addBlock(0, BASE_ADDR);
+	RuntimeBlockInfo *b1 = addBlock(1, BASE_ADDR + 0x100);
+	RuntimeBlockInfo *b2 = addBlock(2, BASE_ADDR + PAGE_SIZE);
+	addBlock(3, BASE_ADDR + 0x200);
+	b0->guest_cycles = 10;
+	b0->runs = 5;
+	b1->guest_cycles = 2;
+	b1->runs = 100;
+	b2->guest_cycles = 1;
+	b2->runs = 1;
+
+	std::vector<BlockProfile> hot = bm_GetHotBlocks(2);
+	ASSERT_EQ(2u, hot.size());
+	ASSERT_EQ(b1->addr, hot[0].addr);
+	ASSERT_EQ(200u, hot[0].cycles);
+	ASSERT_EQ(b0->addr, hot[1].addr);
+	// blocks never executed aren't reported
+	ASSERT_EQ(3u, bm_GetHotBlocks(10).size());
+
+	bm_RamWriteAccess(BASE_ADDR);
+	b0 = addBlock(4, BASE_ADDR);
+	b0->runs = 1;
+	hot = bm_GetHotBlocks(10);
+	auto it = std::find_if(hot.begin(), hot.end(), [](const BlockProfile& p) { return p.addr == BASE_ADDR; });
+	ASSERT_NE(hot.end(), it);
+	ASSERT_EQ(1u, it->smc_invalidations);
+	config::DynarecBlockProfiler = false;
+}
+
+TEST_F(BlockManagerTest, MemSiteFeedback)
+{
+	RuntimeBlockInfo *b0 = addBlock(0, BASE_ADDR);
+	shil_opcode read{};
+	read.guest_offs = 4;
+	shil_opcode write{};
+	write.guest_offs = 6;
+	b0->AddMemSite(8, read, false);
+	b0->AddMemSite(16, write, true);
+
+	u32 area;
+	ASSERT_FALSE(bm_GetMemSiteFeedback(b0, write, true, area));
+	bm_SetMemSiteFeedback(&fakeCode[16], 0xE0000020);
+	ASSERT_TRUE(bm_GetMemSiteFeedback(b0, write, true, area));
+	ASSERT_EQ(0x38u, area);
+	ASSERT_FALSE(bm_GetMemSiteFeedback(b0, read, false, area));
+	// Same guest address but different access type
+	ASSERT_FALSE(bm_GetMemSiteFeedback(b0, write, false, area));
+
+	// Feedback survives the block
+	bm_RamWriteAccess(BASE_ADDR);
+	RuntimeBlockInfo *b1 = addBlock(1, BASE_ADDR);
+	ASSERT_TRUE(bm_GetMemSiteFeedback(b1, write, true, area));
+}
+
+TEST_F(BlockManagerTest, Benchmark)
+{
+	SKIP_UNLESS_BENCHMARK();
+	constexpr u32 BLOCK_COUNT = sizeof(fakeCode) / HOST_SIZE;
+	constexpr u32 BLOCKS_PER_PAGE = 16;
+	using the_clock = std::chrono::high_resolution_clock;
+
+	for (u32 i = 0; i < BLOCK_COUNT; i++)
+		addBlock(i, BASE_ADDR + (i / BLOCKS_PER_PAGE) * PAGE_SIZE + (i % BLOCKS_PER_PAGE) * 0x40);
+
+	constexpr u32 LOOKUPS = 1'000'000;
+	u32 found = 0;
+	auto start = the_clock::now();
+	for (u32 i = 0; i < LOOKUPS; i++)
+	{
+		u32 offset = (i * 2654435761u) % sizeof(fakeCode);
+		if (bm_GetBlock(&fakeCode[offset]) != nullptr)
+			found++;
+	}
+	auto lookupTime = the_clock::now() - start;
+	ASSERT_EQ(LOOKUPS, found);
+
+	start = the_clock::now();
+	for (u32 page = 0; page < BLOCK_COUNT / BLOCKS_PER_PAGE; page++)
+		bm_RamWriteAccess(BASE_ADDR + page * PAGE_SIZE);
+	auto invalidationTime = the_clock::now() - start;
+	ASSERT_EQ(nullptr, bm_GetBlock(&fakeCode[0]).get());
+
+	printf("bm_GetBlock(void*): %.1f ns/lookup\n",
+			std::chrono::duration<double, std::nano>(lookupTime).count() / LOOKUPS);
+	printf("bm_RamWriteAccess: %.1f ns/block\n",
+			std::chrono::duration<double, std::nano>(invalidationTime).count() / BLOCK_COUNT);
+}
+
+#endif
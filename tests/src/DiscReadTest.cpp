@@ -0,0 +1,159 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "types.h"
+#include "imgread/common.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Raw track file that can only be read one sector at a time
+struct SectorTrackFile final : TrackFile
+{
+	RawTrackFile raw;
+
+	SectorTrackFile(FILE *file, u32 firstFad, u32 sectorSize) : raw(file, 0, firstFad, sectorSize) {}
+
+	bool Read(u32 FAD, u8 *dst, SectorFormat *sector_type, u8 *subcode, SubcodeFormat *subcode_type) override {
+		return raw.Read(FAD, dst, sector_type, subcode, subcode_type);
+	}
+};
+
+class DiscReadTest : public ::testing::Test
+{
+protected:
+	struct TrackDef
+	{
+		u32 startFad;
+		u32 endFad;
+		u32 sectorSize;
+		u32 fileSectors;	// less than the track length for a truncated file
+	};
+
+	void SetUp() override
+	{
+		const TrackDef defs[] {
+			{ 150, 299, 2048, 150 },
+			{ 300, 449, 2352, 150 },
+			// gap between 450 and 499
+			{ 500, 649, 2448, 150 },
+			// truncated
+			{ 650, 799, 2352, 100 },
+		};
+		u32 seed = 1;
+		for (const TrackDef& def : defs)
+		{
+			std::vector<u8> data(def.sectorSize * def.fileSectors);
+			for (u8& b : data)
+			{
+				seed = seed * 1103515245 + 12345;
+				b = seed >> 16;
+			}
+			if (def.sectorSize != 2048)
+				// Alternate mode 1 and mode 2 sectors
+				for (u32 i = 0; i < def.fileSectors; i++)
+					data[i * def.sectorSize + 15] = 1 + i % 2;
+
+			Track track;
+			track.StartFAD = def.startFad;
+			track.EndFAD = def.endFad;
+			track.CTRL = 4;
+			track.file = new RawTrackFile(makeFile(data), 0, def.startFad, def.sectorSize);
+			ranged.tracks.push_back(track);
+			track.file = new SectorTrackFile(makeFile(data), def.startFad, def.sectorSize);
+			perSector.tracks.push_back(track);
+		}
+	}
+
+	FILE *makeFile(const std::vector<u8>& data)
+	{
+		FILE *f = std::tmpfile();
+		if (f == nullptr || std::fwrite(data.data(), 1, data.size(), f) != data.size())
+			die("Can't create temporary file");
+		return f;
+	}
+
+	// Read with both discs and compare the results
+	void compare(u32 fad, u32 count, u32 fmt, bool stopOnMiss, u32 expectedCount)
+	{
+		SCOPED_TRACE("fad " + std::to_string(fad) + " count " + std::to_string(count) + " fmt " + std::to_string(fmt));
+		std::vector<u8> perSectorData(count * fmt, 0xcc);
+		ASSERT_EQ(expectedCount, perSector.ReadSectors(fad, count, perSectorData.data(), fmt, stopOnMiss));
+		u8 perSectorQ[96];
+		libGDR_ReadSubChannel(perSectorQ, sizeof(perSectorQ));
+
+		std::vector<u8> rangedData(count * fmt, 0xcc);
+		ASSERT_EQ(expectedCount, ranged.ReadSectors(fad, count, rangedData.data(), fmt, stopOnMiss));
+		u8 rangedQ[96];
+		libGDR_ReadSubChannel(rangedQ, sizeof(rangedQ));
+
+		ASSERT_EQ(perSectorData, rangedData);
+		ASSERT_EQ(0, memcmp(perSectorQ, rangedQ, sizeof(perSectorQ)));
+	}
+
+	Disc ranged;
+	Disc perSector;
+};
+
+TEST_F(DiscReadTest, SingleTrack)
+{
+	for (u32 fmt : { 2048, 2352 })
+	{
+		compare(150, 1, fmt, false, 1);
+		compare(160, 100, fmt, false, 100);
+		compare(300, 150, fmt, false, 150);
+		compare(510, 20, fmt, false, 20);
+	}
+}
+
+TEST_F(DiscReadTest, TrackBoundary)
+{
+	for (u32 fmt : { 2048, 2352 })
+	{
+		compare(290, 20, fmt, false, 20);
+		compare(150, 300, fmt, false, 300);
+		compare(640, 20, fmt, false, 20);
+	}
+}
+
+TEST_F(DiscReadTest, ShortRead)
+{
+	// The file of the last track ends at 749
+	for (u32 fmt : { 2048, 2352 })
+	{
+		compare(740, 20, fmt, false, 20);
+		compare(740, 20, fmt, true, 10);
+	}
+}
+
+TEST_F(DiscReadTest, StopOnMiss)
+{
+	for (u32 fmt : { 2048, 2352 })
+	{
+		// Runs into the gap
+		compare(440, 20, fmt, true, 10);
+		compare(440, 20, fmt, false, 20);
+		// Starts in the gap
+		compare(460, 10, fmt, true, 0);
+		// Past the last track
+		compare(795, 10, fmt, true, 0);
+		compare(790, 20, fmt, false, 20);
+	}
+}
@@ -0,0 +1,154 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "types.h"
+#include "imgread/hunk_cache.h"
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class HunkCacheTest : public ::testing::Test
+{
+protected:
+	static constexpr u32 HUNK_SIZE = 8 * (2352 + 96);
+	static constexpr u32 TOTAL_HUNKS = 50000;
+
+	void TearDown() override {
+		cache.stop();
+	}
+
+	bool read(u32 hunk, u8 *dst)
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		reads.push_back({ hunk, std::this_thread::get_id() == mainThread });
+		memset(dst, (u8)hunk, HUNK_SIZE);
+		return hunk != failingHunk;
+	}
+
+	int readCount(u32 hunk, bool mainThreadOnly = false)
+	{
+		std::lock_guard<std::mutex> _(mutex);
+		int count = 0;
+		for (const Read& read : reads)
+			if (read.hunk == hunk && (read.mainThread || !mainThreadOnly))
+				count++;
+		return count;
+	}
+
+	// Wait for the read-ahead thread to read the given hunk
+	void waitForRead(u32 hunk)
+	{
+		for (int i = 0; i < 1000 && readCount(hunk) == 0; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		ASSERT_NE(0, readCount(hunk));
+	}
+
+	struct Read
+	{
+		u32 hunk;
+		bool mainThread;
+	};
+	std::mutex mutex;
+	std::vector<Read> reads;
+	const std::thread::id mainThread = std::this_thread::get_id();
+	u32 failingHunk = ~0u;
+	HunkCache cache { [this](u32 hunk, u8 *dst) { return read(hunk, dst); } };
+};
+
+TEST_F(HunkCacheTest, Basic)
+{
+	// No read ahead, only the last hunk is kept
+	cache.init(HUNK_SIZE, TOTAL_HUNKS, 0);
+	HunkCache::HunkPtr hunk = cache.get(5);
+	ASSERT_NE(nullptr, hunk);
+	ASSERT_EQ(HUNK_SIZE, hunk->data.size());
+	ASSERT_EQ(5, hunk->data[0]);
+	ASSERT_EQ(5, hunk->data[HUNK_SIZE - 1]);
+	ASSERT_EQ(hunk, cache.get(5));
+	ASSERT_EQ(1, readCount(5));
+
+	// Failed reads are retried
+	failingHunk = 7;
+	ASSERT_EQ(nullptr, cache.get(7));
+	failingHunk = ~0u;
+	ASSERT_NE(nullptr, cache.get(7));
+	ASSERT_EQ(2, readCount(7));
+
+	cache.get(6);
+	ASSERT_EQ(7, cache.get(7)->data[0]);
+	ASSERT_EQ(3, readCount(7));
+	ASSERT_EQ(0, readCount(8));
+}
+
+TEST_F(HunkCacheTest, ReadAhead)
+{
+	cache.init(HUNK_SIZE, TOTAL_HUNKS, 16_MB);
+	// A single read doesn't start reading ahead
+	cache.get(10);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	ASSERT_EQ(0, readCount(11));
+
+	cache.get(11);
+	ASSERT_NO_FATAL_FAILURE(waitForRead(11 + HunkCache::READ_AHEAD_HUNKS));
+	for (u32 hunk = 12; hunk < 30; hunk++)
+	{
+		ASSERT_EQ(hunk, cache.get(hunk)->data[0]);
+		ASSERT_NO_FATAL_FAILURE(waitForRead(hunk + HunkCache::READ_AHEAD_HUNKS));
+	}
+	for (u32 hunk = 12; hunk < 30; hunk++)
+	{
+		ASSERT_EQ(1, readCount(hunk));
+		ASSERT_EQ(0, readCount(hunk, true));
+	}
+	// Not read past the end of the disc
+	for (u32 hunk = TOTAL_HUNKS - 3; hunk < TOTAL_HUNKS; hunk++)
+		cache.get(hunk);
+	cache.stop();
+	ASSERT_EQ(0, readCount(TOTAL_HUNKS));
+}
+
+TEST_F(HunkCacheTest, InterleavedStreams)
+{
+	cache.init(HUNK_SIZE, TOTAL_HUNKS, 16_MB);
+	// CDDA playback, streamed data and random seeks, interleaved
+	const u32 cdda = 100;
+	const u32 data = 5000;
+	const u32 seek = 20000;
+	for (u32 i = 0; i < 30; i++)
+	{
+		ASSERT_EQ((u8)(cdda + i), cache.get(cdda + i)->data[0]);
+		ASSERT_EQ((u8)(data + i), cache.get(data + i)->data[0]);
+		ASSERT_EQ((u8)(seek + i * 100), cache.get(seek + i * 100)->data[0]);
+		if (i >= 1)
+		{
+			ASSERT_NO_FATAL_FAILURE(waitForRead(cdda + i + HunkCache::READ_AHEAD_HUNKS));
+			ASSERT_NO_FATAL_FAILURE(waitForRead(data + i + HunkCache::READ_AHEAD_HUNKS));
+		}
+	}
+	// Both streams have been read ahead
+	for (u32 i = 2; i < 30; i++)
+	{
+		ASSERT_EQ(0, readCount(cdda + i, true));
+		ASSERT_EQ(0, readCount(data + i, true));
+	}
+	// but not the random seeks
+	ASSERT_EQ(0, readCount(seek + 1));
+}
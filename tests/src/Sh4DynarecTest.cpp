@@ -0,0 +1,463 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "test_utils.h"
+#include "types.h"
+#include "hw/mem/addrspace.h"
+#include "emulator.h"
+#include "hw/sh4/sh4_if.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/sh4_sched.h"
+#include "hw/sh4/sh4_opcode_list.h"
+#include "cfg/option.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <random>
+
+#if FEAT_SHREC != DYNAREC_NONE
+
+//
+// Differential testing of the dynarec against the interpreter.
+// Random register-only programs are run by both executors from the same random register state
+// and the resulting states are compared. The benchmarks report the throughput of both executors.
+//
+namespace {
+
+enum class Operands { None, Rn, RmRn, RnImm8, Imm8 };
+
+struct OpTemplate
+{
+	const char *name;
+	u16 op;
+	Operands operands;
+};
+
+// Register-only opcodes that behave identically whatever the register state
+const OpTemplate Templates[] = {
+	{ "mov",      0x6003, Operands::RmRn },
+	{ "mov#",     0xe000, Operands::RnImm8 },
+	{ "add",      0x300c, Operands::RmRn },
+	{ "add#",     0x7000, Operands::RnImm8 },
+	{ "addc",     0x300e, Operands::RmRn },
+	{ "addv",     0x300f, Operands::RmRn },
+	{ "sub",      0x3008, Operands::RmRn },
+	{ "subc",     0x300a, Operands::RmRn },
+	{ "subv",     0x300b, Operands::RmRn },
+	{ "and",      0x2009, Operands::RmRn },
+	{ "and#",     0xc900, Operands::Imm8 },
+	{ "or",       0x200b, Operands::RmRn },
+	{ "or#",      0xcb00, Operands::Imm8 },
+	{ "xor",      0x200a, Operands::RmRn },
+	{ "xor#",     0xca00, Operands::Imm8 },
+	{ "tst",      0x2008, Operands::RmRn },
+	{ "tst#",     0xc800, Operands::Imm8 },
+	{ "not",      0x6007, Operands::RmRn },
+	{ "neg",      0x600b, Operands::RmRn },
+	{ "negc",     0x600a, Operands::RmRn },
+	{ "extu.b",   0x600c, Operands::RmRn },
+	{ "extu.w",   0x600d, Operands::RmRn },
+	{ "exts.b",   0x600e, Operands::RmRn },
+	{ "exts.w",   0x600f, Operands::RmRn },
+	{ "swap.b",   0x6008, Operands::RmRn },
+	{ "swap.w",   0x6009, Operands::RmRn },
+	{ "xtrct",    0x200d, Operands::RmRn },
+	{ "cmp/eq",   0x3000, Operands::RmRn },
+	{ "cmp/eq#",  0x8800, Operands::Imm8 },
+	{ "cmp/hs",   0x3002, Operands::RmRn },
+	{ "cmp/ge",   0x3003, Operands::RmRn },
+	{ "cmp/hi",   0x3006, Operands::RmRn },
+	{ "cmp/gt",   0x3007, Operands::RmRn },
+	{ "cmp/str",  0x200c, Operands::RmRn },
+	{ "cmp/pz",   0x4011, Operands::Rn },
+	{ "cmp/pl",   0x4015, Operands::Rn },
+	{ "mul.l",    0x0007, Operands::RmRn },
+	{ "mulu.w",   0x200e, Operands::RmRn },
+	{ "muls.w",   0x200f, Operands::RmRn },
+	{ "dmulu.l",  0x3005, Operands::RmRn },
+	{ "dmuls.l",  0x300d, Operands::RmRn },
+	{ "div0s",    0x2007, Operands::RmRn },
+	{ "div0u",    0x0019, Operands::None },
+	{ "div1",     0x3004, Operands::RmRn },
+	{ "shad",     0x400c, Operands::RmRn },
+	{ "shld",     0x400d, Operands::RmRn },
+	{ "shll",     0x4000, Operands::Rn },
+	{ "shlr",     0x4001, Operands::Rn },
+	{ "shar",     0x4021, Operands::Rn },
+	{ "shll2",    0x4008, Operands::Rn },
+	{ "shlr2",    0x4009, Operands::Rn },
+	{ "shll8",    0x4018, Operands::Rn },
+	{ "shlr8",    0x4019, Operands::Rn },
+	{ "shll16",   0x4028, Operands::Rn },
+	{ "shlr16",   0x4029, Operands::Rn },
+	{ "rotl",     0x4004, Operands::Rn },
+	{ "rotr",     0x4005, Operands::Rn },
+	{ "rotcl",    0x4024, Operands::Rn },
+	{ "rotcr",    0x4025, Operands::Rn },
+	{ "dt",       0x4010, Operands::Rn },
+	{ "movt",     0x0029, Operands::Rn },
+	{ "clrt",     0x0008, Operands::None },
+	{ "sett",     0x0018, Operands::None },
+	{ "clrmac",   0x0028, Operands::None },
+	{ "sts mach", 0x000a, Operands::Rn },
+	{ "sts macl", 0x001a, Operands::Rn },
+	{ "lds mach", 0x400a, Operands::Rn },
+	{ "lds macl", 0x401a, Operands::Rn },
+	{ "sts fpul", 0x005a, Operands::Rn },
+	{ "lds fpul", 0x405a, Operands::Rn },
+	// fpscr.PR = 0. fdiv, fsqrt and fmac are left out since the host may not round or handle NaNs the same way.
+	{ "fmov",     0xf00c, Operands::RmRn },
+	{ "fadd",     0xf000, Operands::RmRn },
+	{ "fsub",     0xf001, Operands::RmRn },
+	{ "fmul",     0xf002, Operands::RmRn },
+	{ "fcmp/eq",  0xf004, Operands::RmRn },
+	{ "fcmp/gt",  0xf005, Operands::RmRn },
+	{ "fneg",     0xf04d, Operands::Rn },
+	{ "fabs",     0xf05d, Operands::Rn },
+	{ "fldi0",    0xf08d, Operands::Rn },
+	{ "fldi1",    0xf09d, Operands::Rn },
+	{ "float",    0xf02d, Operands::Rn },
+	{ "flds",     0xf01d, Operands::Rn },
+	{ "fsts",     0xf00d, Operands::Rn },
+};
+
+// Guest registers compared after each run
+struct RegState
+{
+	u32 r[16];
+	u32 fr[16];
+	u32 xf[16];
+	u64 mac;
+	u32 sr;
+	u32 fpul;
+	u32 gbr;
+	u32 pr;
+	u32 fpscr;
+
+	void save(const Sh4Context& ctx)
+	{
+		memcpy(r, ctx.r, sizeof(r));
+		memcpy(fr, ctx.fr, sizeof(fr));
+		memcpy(xf, ctx.xf, sizeof(xf));
+		mac = ctx.mac.full;
+		sr = ctx.sr.getFull();
+		fpul = ctx.fpul;
+		gbr = ctx.gbr;
+		pr = ctx.pr;
+		fpscr = ctx.fpscr.full;
+	}
+
+	void restore(Sh4Context& ctx) const
+	{
+		memcpy(ctx.r, r, sizeof(r));
+		memcpy(ctx.fr, fr, sizeof(fr));
+		memcpy(ctx.xf, xf, sizeof(xf));
+		ctx.mac.full = mac;
+		ctx.sr.setFull(sr);
+		ctx.fpul = fpul;
+		ctx.gbr = gbr;
+		ctx.pr = pr;
+		ctx.fpscr.full = fpscr;
+	}
+};
+
+bool isNaN(u32 f)
+{
+	return (f & 0x7f800000) == 0x7f800000 && (f & 0x007fffff) != 0;
+}
+
+}
+
+class Sh4DynarecTest : public ::testing::Test
+{
+protected:
+	using the_clock = std::chrono::high_resolution_clock;
+	static constexpr u32 START_PC = 0xAC000000;
+	// Loop counter of the generated programs
+	static constexpr u32 LOOP_REG = 14;
+	// bf can only branch 128 instructions back
+	static constexpr size_t MAX_BODY_SIZE = 120;
+
+	void SetUp() override
+	{
+		if (!addrspace::reserve())
+			die("addrspace::reserve failed");
+		emu.init();
+		mem_map_default();
+		emu.dc_reset(true);
+		ctx = &p_sh4rcb->cntx;
+		dynarecEnabled = config::DynarecEnabled;
+		config::DynarecEnabled = false;
+		interpreter = emu.getSh4Executor();
+		config::DynarecEnabled = true;
+		recompiler = emu.getSh4Executor();
+		schedId = sh4_sched_register(0, &stopCallback, this);
+		rng.seed(42);
+	}
+
+	void TearDown() override
+	{
+		sh4_sched_unregister(schedId);
+		recompiler->ResetCache();
+		config::DynarecEnabled = dynarecEnabled;
+	}
+
+	// Stop the cpu when the end of the program is reached
+	static int stopCallback(int tag, int cycles, int jitter, void *arg)
+	{
+		Sh4DynarecTest *test = (Sh4DynarecTest *)arg;
+		if (test->ctx->pc != test->endPc)
+			return SH4_TIMESLICE;
+		test->running->Stop();
+		return 0;
+	}
+
+	u32 randomReg()
+	{
+		u32 reg = rng() % 15;
+		return reg == LOOP_REG ? 15 : reg;
+	}
+
+	u16 randomOp(const OpTemplate& tmpl)
+	{
+		switch (tmpl.operands)
+		{
+		case Operands::Rn:
+			return tmpl.op | (randomReg() << 8);
+		case Operands::RmRn:
+			return tmpl.op | (randomReg() << 8) | (randomReg() << 4);
+		case Operands::RnImm8:
+			return tmpl.op | (randomReg() << 8) | (u8)rng();
+		case Operands::Imm8:
+			return tmpl.op | (u8)rng();
+		default:
+			return tmpl.op;
+		}
+	}
+
+	// Random opcodes, with forward conditional branches if requested so that the body spans several blocks
+	std::vector<u16> randomBody(size_t size, bool branches)
+	{
+		std::vector<u16> body;
+		while (body.size() < size)
+		{
+			if (branches && rng() % 8 == 0 && body.size() + 2 <= size)
+			{
+				// bt/bf target: pc + 4 + disp * 2, staying within the body
+				u32 maxDisp = std::min<size_t>(3, size - body.size() - 2);
+				body.push_back((rng() % 2 == 0 ? 0x8900 : 0x8b00) | (rng() % (maxDisp + 1)));
+			}
+			else
+			{
+				body.push_back(randomOp(Templates[rng() % std::size(Templates)]));
+			}
+		}
+		return body;
+	}
+
+	// Loop over the body LOOP_REG times, then loop forever at endPc
+	std::vector<u16> makeProgram(const std::vector<u16>& body)
+	{
+		verify(body.size() <= MAX_BODY_SIZE);
+		std::vector<u16> program = body;
+		program.push_back(0x4010 | (LOOP_REG << 8));	// dt r14
+		int disp = -(int)program.size() - 2;
+		program.push_back(0x8b00 | (u8)disp);			// bf START_PC
+		endPc = START_PC + program.size() * 2;
+		program.push_back(0xaffe);						// bra endPc
+		program.push_back(0x0009);						// nop
+		return program;
+	}
+
+	RegState randomState(u32 iterations)
+	{
+		RegState state;
+		for (u32& r : state.r)
+			r = rng();
+		state.r[LOOP_REG] = iterations;
+		std::uniform_real_distribution<float> dist(-100.f, 100.f);
+		for (int i = 0; i < 16; i++)
+		{
+			float f = dist(rng);
+			memcpy(&state.fr[i], &f, sizeof(f));
+			f = dist(rng);
+			memcpy(&state.xf[i], &f, sizeof(f));
+		}
+		state.mac = ((u64)rng() << 32) | rng();
+		// random T, S, Q and M bits
+		state.sr = 0x700000F0 | (rng() & 0x303);
+		state.fpul = rng();
+		state.gbr = rng();
+		state.pr = rng();
+		state.fpscr = 0x00040001;
+		return state;
+	}
+
+	// Run the program until its end is reached. Returns the execution time.
+	the_clock::duration run(Sh4Executor *sh4, const std::vector<u16>& program, const RegState& initial, RegState& final,
+			u32 pc = START_PC)
+	{
+		// Also unprotects the program pages
+		recompiler->ResetCache();
+		for (size_t i = 0; i < program.size(); i++)
+			addrspace::write16(pc + i * 2, program[i]);
+		initial.restore(*ctx);
+		ctx->pc = pc;
+		running = sh4;
+		sh4_sched_request(schedId, SH4_TIMESLICE);
+		sh4->Start();
+		auto start = the_clock::now();
+		sh4->Run();
+		auto duration = the_clock::now() - start;
+		final.save(*ctx);
+		return duration;
+	}
+
+	static std::string disassemble(const std::vector<u16>& program)
+	{
+		std::string s;
+		for (size_t i = 0; i < program.size(); i++)
+		{
+			char text[128];
+			OpDesc[program[i]]->Disassemble(text, START_PC + i * 2, program[i]);
+			s += text;
+			s += '\n';
+		}
+		return s;
+	}
+
+	static void compare(const RegState& expected, const RegState& actual, const std::vector<u16>& program)
+	{
+		for (int i = 0; i < 16; i++)
+			ASSERT_EQ(expected.r[i], actual.r[i]) << "r" << i << " differs\n" << disassemble(program);
+		for (int i = 0; i < 16; i++)
+		{
+			if (!isNaN(expected.fr[i]) || !isNaN(actual.fr[i]))
+				ASSERT_EQ(expected.fr[i], actual.fr[i]) << "fr" << i << " differs\n" << disassemble(program);
+			if (!isNaN(expected.xf[i]) || !isNaN(actual.xf[i]))
+				ASSERT_EQ(expected.xf[i], actual.xf[i]) << "xf" << i << " differs\n" << disassemble(program);
+		}
+		ASSERT_EQ(expected.mac, actual.mac) << "mac differs\n" << disassemble(program);
+		ASSERT_EQ(expected.sr, actual.sr) << "sr differs\n" << disassemble(program);
+		ASSERT_EQ(expected.fpul, actual.fpul) << "fpul differs\n" << disassemble(program);
+		ASSERT_EQ(expected.gbr, actual.gbr);
+		ASSERT_EQ(expected.pr, actual.pr);
+		ASSERT_EQ(expected.fpscr, actual.fpscr);
+	}
+
+	Sh4Context *ctx = nullptr;
+	Sh4Executor *interpreter = nullptr;
+	Sh4Executor *recompiler = nullptr;
+	Sh4Executor *running = nullptr;
+	u32 endPc = 0;
+	int schedId = -1;
+	bool dynarecEnabled = true;
+	std::mt19937 rng;
+};
+
+TEST_F(Sh4DynarecTest, RandomPrograms)
+{
+	for (int i = 0; i < 500; i++)
+	{
+		std::vector<u16> program = makeProgram(randomBody(1 + rng() % MAX_BODY_SIZE, true));
+		RegState initial = randomState(1 + rng() % 3);
+		RegState expected, actual;
+		run(interpreter, program, initial, expected);
+		run(recompiler, program, initial, actual);
+		compare(expected, actual, program);
+	}
+}
+
+// The code following a bra whose delay slot changes fpscr.SZ must be decoded with the new value
+TEST_F(Sh4DynarecTest, FpscrInDelaySlot)
+{
+	// Blocks in the first 64 KB of system ram can't be protected and never become superblocks
+	constexpr u32 PC = 0xAC010000;
+	for (u16 delaySlot : { 0x416a, 0xf3fd })	// lds r1,FPSCR / fschg
+	{
+		const std::vector<u16> program {
+			0xa002,		// bra target
+			delaySlot,
+			0x0009,		// nop
+			0x0009,		// nop
+			0xf42c,		// target: fmov fr2,fr4 (fmov dr2,dr4 if SZ=1)
+			0xaffe,		// bra endPc
+			0x0009,		// nop
+		};
+		endPc = PC + 10;
+		RegState initial = randomState(1);
+		initial.r[1] = 0x00140001;	// SZ=1
+		RegState expected, actual;
+		run(interpreter, program, initial, expected, PC);
+		run(recompiler, program, initial, actual, PC);
+		compare(expected, actual, program);
+		ASSERT_EQ(initial.fr[3], actual.fr[5]);
+	}
+}
+
+TEST_F(Sh4DynarecTest, OpcodeBenchmark)
+{
+	SKIP_UNLESS_BENCHMARK();
+	constexpr size_t BODY_SIZE = 64;
+	constexpr u32 ITERATIONS = 20'000;
+	constexpr double OPS = BODY_SIZE * ITERATIONS;
+
+	printf("%-10s %12s %12s\n", "opcode", "interpreter", "dynarec");
+	for (const OpTemplate& tmpl : Templates)
+	{
+		std::vector<u16> body;
+		for (size_t i = 0; i < BODY_SIZE; i++)
+			body.push_back(randomOp(tmpl));
+		std::vector<u16> program = makeProgram(body);
+		RegState initial = randomState(ITERATIONS);
+		RegState expected, actual;
+		auto interpTime = run(interpreter, program, initial, expected);
+		auto dynaTime = run(recompiler, program, initial, actual);
+		compare(expected, actual, program);
+
+		printf("%-10s %9.2f ns %9.2f ns\n", tmpl.name,
+				std::chrono::duration<double, std::nano>(interpTime).count() / OPS,
+				std::chrono::duration<double, std::nano>(dynaTime).count() / OPS);
+	}
+}
+
+TEST_F(Sh4DynarecTest, BlockBenchmark)
+{
+	SKIP_UNLESS_BENCHMARK();
+	constexpr size_t BODY_SIZE = 32;
+	constexpr u32 ITERATIONS = 100'000;
+
+	// Straight blocks ending with dt + bf, then blocks split by conditional branches
+	for (bool branches : { false, true })
+	{
+		std::vector<u16> program = makeProgram(randomBody(BODY_SIZE, branches));
+		RegState initial = randomState(ITERATIONS);
+		RegState expected, actual;
+		auto interpTime = run(interpreter, program, initial, expected);
+		auto dynaTime = run(recompiler, program, initial, actual);
+		compare(expected, actual, program);
+
+		printf("%s blocks: interpreter %.1f ns/loop dynarec %.1f ns/loop\n", branches ? "Branching" : "Straight",
+				std::chrono::duration<double, std::nano>(interpTime).count() / ITERATIONS,
+				std::chrono::duration<double, std::nano>(dynaTime).count() / ITERATIONS);
+	}
+}
+
+#endif
@@ -0,0 +1,248 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/addrspace.h"
+#include "hw/sh4/sh4_mem.h"
+#include "emulator.h"
+#include "hw/pvr/ta.h"
+#include "hw/pvr/ta_capture.h"
+#include "hw/pvr/pvr_regs.h"
+#include "hw/pvr/pvr_mem.h"
+#include "hw/pvr/Renderer_if.h"
+#include "oslib/directory.h"
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <set>
+
+Renderer *rend_norend();
+Renderer *rend_softrend();
+
+class TaCaptureTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		if (!addrspace::reserve())
+			die("addrspace::reserve failed");
+		emu.init();
+		mem_map_default();
+		emu.dc_reset(true);
+	}
+
+	void TearDown() override
+	{
+		delete renderer;
+		renderer = nullptr;
+	}
+};
+
+// Untextured opaque triangle strip
+static std::vector<u8> makeStrip()
+{
+	std::vector<u32> data(8 * 5);
+	PCW pcw{};
+	pcw.ParaType = ParamType_Polygon_or_Modifier_Volume;
+	pcw.ListType = ListType_Opaque;
+	pcw.Gouraud = 1;
+	data[0] = pcw.full;
+	ISP_TSP isp{};
+	isp.DepthMode = 7;
+	data[1] = isp.full;
+
+	const float coords[3][2] { { 10.f, 10.f }, { 100.f, 10.f }, { 10.f, 100.f } };
+	for (int i = 0; i < 3; i++)
+	{
+		u32 *vtx = &data[8 * (i + 1)];
+		pcw.full = 0;
+		pcw.ParaType = ParamType_Vertex_Parameter;
+		pcw.EndOfStrip = i == 2;
+		vtx[0] = pcw.full;
+		memcpy(&vtx[1], &coords[i][0], 4);
+		memcpy(&vtx[2], &coords[i][1], 4);
+		float z = 1.f;
+		memcpy(&vtx[3], &z, 4);
+		vtx[6] = 0xff00ff00;
+	}
+	// End of list
+	data[8 * 4] = 0;
+
+	return std::vector<u8>((const u8 *)data.data(), (const u8 *)(data.data() + data.size()));
+}
+
+TEST_F(TaCaptureTest, RoundTrip)
+{
+	// Single region with no tile clipping
+	REGION_BASE = 0x100000;
+	RegionArrayTile tile{};
+	tile.LastRegion = 1;
+	pvr_write32p<u32>(REGION_BASE, tile.full);
+
+	tacapture::Capture capture;
+	capture.platform = settings.platform.system;
+	capture.state.fb_X_CLIP = FB_X_CLIP.full;
+	capture.state.fb_Y_CLIP = FB_Y_CLIP.full;
+	capture.pvrRegs.assign(pvr_regs, pvr_regs + pvr_RegSize);
+	capture.taData.push_back(makeStrip());
+	const u32 page = pvr_map32(REGION_BASE) / tacapture::VRAM_PAGE_SIZE;
+	capture.vramPages.push_back(page);
+	capture.vramData.assign(&vram[page * tacapture::VRAM_PAGE_SIZE], &vram[(page + 1) * tacapture::VRAM_PAGE_SIZE]);
+	ASSERT_TRUE(capture.save("test.tac"));
+
+	tacapture::Capture loaded;
+	ASSERT_TRUE(loaded.load("test.tac"));
+	remove("test.tac");
+	ASSERT_EQ(capture.taData, loaded.taData);
+	ASSERT_EQ(capture.vramPages, loaded.vramPages);
+	ASSERT_EQ(capture.vramData, loaded.vramData);
+
+	// Restore must overwrite the current state
+	REGION_BASE = 0;
+	vram.zero();
+	TA_context *ctx = loaded.restore();
+	ASSERT_NE(nullptr, ctx);
+	ASSERT_EQ(0x100000u, REGION_BASE);
+	ta_parse(ctx, false);
+
+	const rend_context& rc = ctx->rend;
+	ASSERT_EQ(1u, rc.render_passes.size());
+	// background + strip
+	ASSERT_EQ(2u, rc.global_param_op.size());
+	ASSERT_EQ(0u, rc.global_param_tr.size());
+	ASSERT_EQ(7u, rc.verts.size());
+	ASSERT_EQ(100.f, rc.verts[5].x);
+	ASSERT_EQ(100.f, rc.verts[6].y);
+	tacapture::freeContext(ctx);
+}
+
+//
+// Replay the captures found in the FLYCAST_TA_CAPTURES directory and time each stage.
+// Captures are dumped into data/tacapture/<game id> when the rend.DumpDisplayLists option is enabled.
+//
+TEST_F(TaCaptureTest, Benchmark)
+{
+	const char *dirName = std::getenv("FLYCAST_TA_CAPTURES");
+	if (dirName == nullptr)
+		GTEST_SKIP() << "FLYCAST_TA_CAPTURES not set";
+	DIR *dir = flycast::opendir(dirName);
+	ASSERT_NE(nullptr, dir);
+	std::vector<std::string> files;
+	while (dirent *entry = flycast::readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name.size() > 4 && name.substr(name.size() - 4) == ".tac")
+			files.push_back(std::string(dirName) + "/" + name);
+	}
+	flycast::closedir(dir);
+	std::sort(files.begin(), files.end());
+
+	constexpr int ITERATIONS = 10;
+	using the_clock = std::chrono::high_resolution_clock;
+	using ms = std::chrono::duration<double, std::milli>;
+	for (const std::string& file : files)
+	{
+		tacapture::Capture capture;
+		if (!capture.load(file))
+			continue;
+		ms parseTime{};
+		ms sortTime{};
+		ms indexTime{};
+		ms textureTime{};
+		ms renderTime{};
+		size_t polyCount = 0;
+		size_t vertexCount = 0;
+		size_t textureCount = 0;
+		for (int i = 0; i < ITERATIONS; i++)
+		{
+			// Vertex decoding
+			renderer = rend_norend();
+			TA_context *ctx = capture.restore();
+			if (ctx == nullptr)
+				break;
+			auto start = the_clock::now();
+			ta_parse_vertices(ctx);
+			parseTime += the_clock::now() - start;
+			vertexCount = ctx->rend.verts.size();
+
+			// Triangle sorting and index building
+			rend_context rc = ctx->rend;
+			polyCount = rc.global_param_op.size() + rc.global_param_pt.size() + rc.global_param_tr.size();
+			RenderPass previousPass{};
+			for (RenderPass& pass : rc.render_passes)
+			{
+				pass.sorted_tr_count = previousPass.sorted_tr_count;
+				start = the_clock::now();
+				makeIndex(rc.global_param_op, previousPass.op_count, pass.op_count, true, rc);
+				makeIndex(rc.global_param_pt, previousPass.pt_count, pass.pt_count, true, rc);
+				if (!pass.autosort)
+					makeIndex(rc.global_param_tr, previousPass.tr_count, pass.tr_count, false, rc);
+				indexTime += the_clock::now() - start;
+				if (pass.autosort)
+				{
+					start = the_clock::now();
+					sortTriangles(rc, pass, previousPass);
+					sortTime += the_clock::now() - start;
+				}
+				previousPass = pass;
+			}
+			delete renderer;
+
+			// Texture decoding and upload
+			renderer = rend_softrend();
+			renderer->Init();
+			std::set<std::pair<u32, u32>> textures;
+			for (const auto *list : { &ctx->rend.global_param_op, &ctx->rend.global_param_pt, &ctx->rend.global_param_tr })
+				for (const PolyParam& pp : *list)
+					if (pp.pcw.Texture)
+						textures.emplace(pp.tsp.full, pp.tcw.full);
+			textureCount = textures.size();
+			start = the_clock::now();
+			for (const auto& [tspFull, tcwFull] : textures)
+			{
+				TSP tsp;
+				tsp.full = tspFull;
+				TCW tcw;
+				tcw.full = tcwFull;
+				renderer->GetTexture(tsp, tcw);
+			}
+			textureTime += the_clock::now() - start;
+			renderer->Term();
+			tacapture::freeContext(ctx);
+
+			// Full frame with the software renderer
+			ctx = capture.restore();
+			renderer->Init();
+			_pvrrc = ctx;
+			start = the_clock::now();
+			renderer->Process(ctx);
+			renderer->Render();
+			renderTime += the_clock::now() - start;
+			_pvrrc = nullptr;
+			renderer->Term();
+			delete renderer;
+			renderer = nullptr;
+			tacapture::freeContext(ctx);
+		}
+		printf("%s: %d polys, %d vertices, %d textures\n", file.c_str(), (int)polyCount, (int)vertexCount, (int)textureCount);
+		printf("  parse %.3f ms (%.2f Mvtx/s), sort %.3f ms, index %.3f ms, textures %.3f ms, render %.3f ms\n",
+				parseTime.count() / ITERATIONS, vertexCount * ITERATIONS / parseTime.count() / 1000.0, sortTime.count() / ITERATIONS, indexTime.count() / ITERATIONS,
+				textureTime.count() / ITERATIONS, renderTime.count() / ITERATIONS);
+	}
+}
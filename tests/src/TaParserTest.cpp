@@ -0,0 +1,209 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/addrspace.h"
+#include "hw/sh4/sh4_mem.h"
+#include "emulator.h"
+#include "hw/pvr/ta.h"
+#include "hw/pvr/pvr_regs.h"
+#include "hw/pvr/pvr_mem.h"
+#include "cfg/option.h"
+#include <cstring>
+
+class TaParserTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		if (!addrspace::reserve())
+			die("addrspace::reserve failed");
+		emu.init();
+		mem_map_default();
+		emu.dc_reset(true);
+		config::RendererType = RenderType::OpenGL;
+		// Single region with no tile clipping
+		REGION_BASE = 0x100000;
+		RegionArrayTile tile{};
+		tile.LastRegion = 1;
+		pvr_write32p<u32>(REGION_BASE, tile.full);
+	}
+
+	void TearDown() override
+	{
+		delete ctx;
+		ctx = nullptr;
+	}
+
+	void polyParam(u32 colType)
+	{
+		PCW pcw{};
+		pcw.ParaType = ParamType_Polygon_or_Modifier_Volume;
+		pcw.ListType = ListType_Opaque;
+		pcw.Gouraud = 1;
+		pcw.Col_Type = colType;
+		ISP_TSP isp{};
+		isp.DepthMode = 7;
+		u32 *p = add();
+		p[0] = pcw.full;
+		p[1] = isp.full;
+	}
+
+	u32 *vertex(float x, float y, bool endOfStrip)
+	{
+		PCW pcw{};
+		pcw.ParaType = ParamType_Vertex_Parameter;
+		pcw.EndOfStrip = endOfStrip;
+		u32 *p = add();
+		p[0] = pcw.full;
+		float z = 1.f;
+		memcpy(&p[1], &x, 4);
+		memcpy(&p[2], &y, 4);
+		memcpy(&p[3], &z, 4);
+		return p;
+	}
+
+	void parse()
+	{
+		add();	// end of list
+		ctx = new TA_context();
+		ctx->Alloc();
+		memcpy(ctx->tad.thd_root, data.data(), data.size() * 4);
+		ctx->tad.thd_data = ctx->tad.thd_root + data.size() * 4;
+		FillBGP(ctx);
+		ta_parse(ctx, false);
+	}
+
+	std::vector<u32> data;
+	TA_context *ctx = nullptr;
+
+private:
+	u32 *add()
+	{
+		data.resize(data.size() + 8);
+		return &data[data.size() - 8];
+	}
+};
+
+TEST_F(TaParserTest, Strips)
+{
+	polyParam(0);
+	for (int i = 0; i < 4; i++)
+		vertex(i, 0, i == 3)[6] = 0x80402010 + i;
+	for (int i = 0; i < 3; i++)
+		vertex(i, 1, i == 2)[6] = 0xff000000;
+	parse();
+
+	const rend_context& rc = ctx->rend;
+	// background + 2 strips
+	ASSERT_EQ(3u, rc.global_param_op.size());
+	ASSERT_EQ(4u + 7u, rc.verts.size());
+	for (int i = 0; i < 4; i++)
+	{
+		const Vertex& v = rc.verts[4 + i];
+		ASSERT_EQ((float)i, v.x);
+		ASSERT_EQ(0.f, v.y);
+		ASSERT_EQ(0x40, v.col[0]);
+		ASSERT_EQ(0x20, v.col[1]);
+		ASSERT_EQ(0x10 + i, v.col[2]);
+		ASSERT_EQ(0x80, v.col[3]);
+	}
+	ASSERT_EQ(1.f, rc.verts[10].y);
+	ASSERT_EQ(0xff, rc.verts[10].col[3]);
+}
+
+TEST_F(TaParserTest, FloatColor)
+{
+	// The low 16 bits of colors are ignored and NaN is saturated
+	const u32 values[] { 0x3f000000, 0x3f00ff00, 0xbf800000, 0x7f800000, 0x7fc00000, 0x3f7fffff, 0x3b800000, 0x00000001,
+		0x3f800000, 0x3e800000, 0xff800000, 0x40000000 };
+	constexpr size_t count = std::size(values) / 4;
+	polyParam(1);
+	for (size_t i = 0; i < count; i++)
+	{
+		u32 *p = vertex(0, 0, i == count - 1);
+		memcpy(&p[4], &values[i * 4], 16);
+	}
+	parse();
+
+	auto refColor = [](u32 bits) -> u8 {
+		bits &= 0xffff0000;
+		float f;
+		memcpy(&f, &bits, 4);
+		return (u8)(f == f ? std::min(1.f, std::max(0.f, f)) * 255.f : 255.f);
+	};
+	const rend_context& rc = ctx->rend;
+	ASSERT_EQ(4 + count, rc.verts.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		const Vertex& v = rc.verts[4 + i];
+		ASSERT_EQ(refColor(values[i * 4]), v.col[3]);
+		ASSERT_EQ(refColor(values[i * 4 + 1]), v.col[0]);
+		ASSERT_EQ(refColor(values[i * 4 + 2]), v.col[1]);
+		ASSERT_EQ(refColor(values[i * 4 + 3]), v.col[2]);
+	}
+	ASSERT_EQ(127, rc.verts[4].col[0]);
+}
+
+// Triangles must be sorted by increasing z, keeping their original order when equal
+static void checkSortTriangles(int stripCount)
+{
+	rend_context ctx;
+	for (int s = 0; s < stripCount; s++)
+	{
+		PolyParam pp;
+		pp.init();
+		pp.first = ctx.verts.size();
+		pp.count = 3;
+		pp.tsp.full = s & 1;
+		ctx.global_param_tr.push_back(pp);
+		const float z = (float)((s * 7919) % 50) - 10.f;
+		for (int i = 0; i < 3; i++)
+		{
+			Vertex& v = ctx.verts.emplace_back();
+			v.x = (float)i;
+			v.y = (float)(i & 1);
+			v.z = i == 2 && s % 3 == 0 ? -0.f : z + i;
+		}
+	}
+	RenderPass pass{};
+	pass.tr_count = stripCount;
+	sortTriangles(ctx, pass, RenderPass{});
+
+	ASSERT_EQ(stripCount * 3u, ctx.idx.size());
+	float lastZ = -1e38f;
+	int lastStrip = -1;
+	for (int i = 0; i < stripCount; i++)
+	{
+		const int strip = ctx.idx[i * 3] / 3;
+		const float z = std::min(ctx.verts[strip * 3].z, ctx.verts[strip * 3 + 2].z);
+		ASSERT_LE(lastZ, z);
+		if (z == lastZ)
+			ASSERT_LT(lastStrip, strip);
+		lastZ = z;
+		lastStrip = strip;
+	}
+}
+
+TEST_F(TaParserTest, SortTriangles)
+{
+	checkSortTriangles(100);
+	checkSortTriangles(5000);
+	checkSortTriangles(40000);
+}
@@ -0,0 +1,274 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/addrspace.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/pvr/pvr_mem.h"
+#include "emulator.h"
+#include "rend/TexCache.h"
+#include <chrono>
+#include <thread>
+
+class TestTexture final : public BaseTextureCacheData
+{
+public:
+	TestTexture(TSP tsp = {}, TCW tcw = {}, int area = 0) : BaseTextureCacheData(tsp, tcw, area) {}
+	TestTexture(TestTexture&& other) : BaseTextureCacheData(std::move(other)) {
+		std::swap(pixels, other.pixels);
+		uploads = other.uploads;
+	}
+
+	std::string GetId() override {
+		return "test";
+	}
+	void UploadToGPU(int width, int height, const u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) override
+	{
+		const u32 *p = (const u32 *)temp_tex_buffer;
+		pixels.assign(p, p + width * height);
+		uploads++;
+	}
+	bool Force32BitTexture(TextureType type) const override { return true; }
+
+	std::vector<u32> pixels;
+	int uploads = 0;
+};
+
+class TestTextureCache final : public BaseTextureCache<TestTexture>
+{
+public:
+	~TestTextureCache() {
+		Clear();
+	}
+};
+
+class TexCacheTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		if (!addrspace::reserve())
+			die("addrspace::reserve failed");
+		emu.init();
+		mem_map_default();
+		emu.dc_reset(true);
+		BaseTextureCacheData::SetDirectXColorOrder(false);
+		config::DecodedTextureCacheSize = 0;
+	}
+
+	void TearDown() override
+	{
+		config::AsyncTextureDecode = false;
+		config::DecodedTextureCacheSize.reset();
+	}
+
+	// 8x8 twiddled 565 texture
+	TestTexture *getTexture(u32 address)
+	{
+		TCW tcw{};
+		tcw.TexAddr = address >> 3;
+		tcw.PixelFmt = Pixel565;
+		return cache.getTextureCacheData(TSP{}, tcw, 0);
+	}
+
+	void fillTexture(u32 address, u16 color)
+	{
+		// Unprotect and invalidate the textures using this page
+		VramLockedWriteOffset(address);
+		for (u32 i = 0; i < 8 * 8; i++)
+			pvr_write32p<u16>(address + i * 2, color);
+	}
+
+	TestTextureCache cache;
+};
+
+TEST_F(TexCacheTest, AsyncDecode)
+{
+	config::AsyncTextureDecode = true;
+	const u32 address = 0x200000;
+	fillTexture(address, 0xf800);
+	TestTexture *texture = getTexture(address);
+	ASSERT_TRUE(texture->NeedsUpdate());
+	// The first version is always decoded synchronously
+	ASSERT_TRUE(texture->Update());
+	ASSERT_EQ(1, texture->uploads);
+	const std::vector<u32> red = texture->pixels;
+
+	fillTexture(address, 0x001f);
+	ASSERT_TRUE(texture->NeedsUpdate());
+	ASSERT_TRUE(texture->Update());
+	// Still using the red version
+	ASSERT_EQ(1, texture->uploads);
+	ASSERT_EQ(red, texture->pixels);
+
+	for (int i = 0; i < 1000 && !texture->NeedsUpdate(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ASSERT_TRUE(texture->NeedsUpdate());
+	ASSERT_TRUE(texture->Update());
+	ASSERT_EQ(2, texture->uploads);
+	ASSERT_FALSE(texture->NeedsUpdate());
+
+	// Compare with a synchronous decode
+	config::AsyncTextureDecode = false;
+	fillTexture(address, 0x001f);
+	ASSERT_TRUE(texture->Update());
+	ASSERT_EQ(3, texture->uploads);
+	const std::vector<u32> blue = texture->pixels;
+	ASSERT_NE(red, blue);
+	config::AsyncTextureDecode = true;
+	fillTexture(address, 0xf800);
+	ASSERT_TRUE(texture->Update());
+	for (int i = 0; i < 1000 && !texture->NeedsUpdate(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ASSERT_TRUE(texture->Update());
+	ASSERT_EQ(red, texture->pixels);
+}
+
+TEST_F(TexCacheTest, ModifiedWhileDecoding)
+{
+	config::AsyncTextureDecode = true;
+	const u32 address = 0x200000;
+	fillTexture(address, 0xf800);
+	TestTexture *texture = getTexture(address);
+	ASSERT_TRUE(texture->Update());
+	const std::vector<u32> red = texture->pixels;
+
+	fillTexture(address, 0x07e0);
+	ASSERT_TRUE(texture->Update());
+	// Modified again before the pending version is uploaded
+	fillTexture(address, 0xf800);
+	for (int i = 0; i < 1000 && !(texture->asyncDecode == nullptr || texture->asyncDecode->ready); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	// Upload the green version and start decoding the red one
+	ASSERT_TRUE(texture->Update());
+	ASSERT_EQ(2, texture->uploads);
+	ASSERT_NE(red, texture->pixels);
+	for (int i = 0; i < 1000 && !texture->NeedsUpdate(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	ASSERT_TRUE(texture->Update());
+	ASSERT_EQ(3, texture->uploads);
+	ASSERT_EQ(red, texture->pixels);
+}
+
+TEST_F(TexCacheTest, SharedContent)
+{
+	config::DecodedTextureCacheSize = 64;
+	const DecodedTextureCache& decodedCache = BaseTextureCacheData::decodedCache;
+	fillTexture(0x200000, 0xf800);
+	fillTexture(0x300000, 0xf800);
+	TestTexture *texture1 = getTexture(0x200000);
+	ASSERT_TRUE(texture1->Update());
+	ASSERT_EQ(0u, decodedCache.hits);
+	ASSERT_EQ(1u, decodedCache.misses);
+	const std::vector<u32> red = texture1->pixels;
+
+	// Same content at another address
+	TestTexture *texture2 = getTexture(0x300000);
+	ASSERT_NE(texture1, texture2);
+	ASSERT_TRUE(texture2->Update());
+	ASSERT_EQ(1u, decodedCache.hits);
+	ASSERT_EQ(1, texture2->uploads);
+	ASSERT_EQ(red, texture2->pixels);
+
+	// Different content
+	FrameCount += 10;
+	fillTexture(0x300000, 0x001f);
+	ASSERT_TRUE(texture2->NeedsUpdate());
+	ASSERT_TRUE(texture2->Update());
+	ASSERT_EQ(1u, decodedCache.hits);
+	ASSERT_EQ(2u, decodedCache.misses);
+	ASSERT_NE(red, texture2->pixels);
+
+	// Back to the previous content
+	FrameCount += 10;
+	fillTexture(0x300000, 0xf800);
+	ASSERT_TRUE(texture2->Update());
+	ASSERT_EQ(2u, decodedCache.hits);
+	ASSERT_EQ(red, texture2->pixels);
+}
+
+TEST_F(TexCacheTest, UpdatedEveryFrame)
+{
+	config::DecodedTextureCacheSize = 64;
+	const DecodedTextureCache& decodedCache = BaseTextureCacheData::decodedCache;
+	fillTexture(0x200000, 0xf800);
+	TestTexture *texture = getTexture(0x200000);
+	ASSERT_TRUE(texture->Update());
+	const u64 misses = decodedCache.misses;
+	for (int i = 0; i < 10; i++)
+	{
+		FrameCount++;
+		fillTexture(0x200000, i & 1 ? 0xf800 : 0x001f);
+		ASSERT_TRUE(texture->Update());
+	}
+	// Only the first update on the next frame is looked up
+	ASSERT_EQ(misses + 1, decodedCache.misses + decodedCache.hits);
+
+	// Back to normal once the texture stops changing every frame
+	FrameCount += 10;
+	fillTexture(0x200000, 0xf800);
+	ASSERT_TRUE(texture->Update());
+	ASSERT_EQ(misses + 2, decodedCache.misses + decodedCache.hits);
+}
+
+TEST_F(TexCacheTest, WriteOutsideTexture)
+{
+	// Two 8x8 textures in the same vram page
+	const u32 address1 = 0x200000;
+	const u32 address2 = 0x200400;
+	fillTexture(address1, 0xf800);
+	fillTexture(address2, 0xf800);
+	TestTexture *texture1 = getTexture(address1);
+	TestTexture *texture2 = getTexture(address2);
+	ASSERT_TRUE(texture1->Update());
+	ASSERT_TRUE(texture2->Update());
+
+	fillTexture(address2, 0x001f);
+	ASSERT_TRUE(texture2->NeedsUpdate());
+	// Not modified
+	ASSERT_FALSE(texture1->NeedsUpdate());
+	ASSERT_TRUE(texture2->Update());
+
+	// Modified while the page isn't protected
+	fillTexture(address2, 0x07e0);
+	pvr_write32p<u16>(address1, 0x07e0);
+	ASSERT_TRUE(texture1->NeedsUpdate());
+	ASSERT_TRUE(texture2->NeedsUpdate());
+}
+
+TEST_F(TexCacheTest, UnprotectUnwatched)
+{
+	const u32 address1 = 0x200000;
+	const u32 address2 = 0x200400;
+	fillTexture(address1, 0xf800);
+	fillTexture(address2, 0xf800);
+	TestTexture *texture1 = getTexture(address1);
+	TestTexture *texture2 = getTexture(address2);
+	ASSERT_TRUE(texture1->Update());
+	ASSERT_TRUE(texture2->Update());
+	// texture1 is no longer watched
+	fillTexture(address2, 0x001f);
+
+	// Rendered to texture
+	texture1->dirty = 0;
+	texture1->unprotectVRam();
+	pvr_write32p<u16>(address1, 0x07e0);
+	// The rendered texture must be kept
+	ASSERT_FALSE(texture1->NeedsUpdate());
+}
@@ -0,0 +1,170 @@
+/*
+	Copyright 2025 flyinghead
+
+	This file is part of Flycast.
+
+    Flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    Flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "gtest/gtest.h"
+#include "test_utils.h"
+#include "types.h"
+#include "hw/pvr/ta_structs.h"
+#include "rend/texconv.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+class TexConvTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		std::mt19937 rng(42);
+		src.resize(1024 * 1024 * 2);
+		for (u8& b : src)
+			b = rng();
+		codebook.resize(VQ_CODEBOOK_SIZE);
+		for (u8& b : codebook)
+			b = rng();
+		for (u32& c : palette16_ram)
+			c = rng() & 0xffff;
+		for (u32& c : palette32_ram)
+			c = rng();
+		::vq_codebook = codebook.data();
+		::palette_index = 0;
+	}
+
+	// Index of texel (x, y) in a twiddled texture
+	static u32 twiddle(u32 x, u32 y, u32 width, u32 height)
+	{
+		u32 index = 0;
+		u32 shift = 0;
+		for (u32 w = width >> 1, h = height >> 1; w != 0 || h != 0; )
+		{
+			if (h != 0)
+			{
+				index |= (y & 1) << shift++;
+				y >>= 1;
+				h >>= 1;
+			}
+			if (w != 0)
+			{
+				index |= (x & 1) << shift++;
+				x >>= 1;
+				w >>= 1;
+			}
+		}
+		return index;
+	}
+
+	// Convert a twiddled or VQ texture one texel at a time
+	template<typename Unpacker, int Bpp = 16>
+	std::vector<typename Unpacker::unpacked_type> reference(u32 width, u32 height, bool vq)
+	{
+		std::vector<typename Unpacker::unpacked_type> pixels(width * height);
+		for (u32 y = 0; y < height; y++)
+			for (u32 x = 0; x < width; x++)
+			{
+				u32 i = twiddle(x, y, width, height);
+				if (vq)
+				{
+					const u16 *entry = (const u16 *)&codebook[src[i / 4] * 8];
+					pixels[y * width + x] = Unpacker::unpack(entry[i % 4]);
+				}
+				else if constexpr (Bpp == 16)
+					pixels[y * width + x] = Unpacker::unpack(((const u16 *)src.data())[i]);
+				else if constexpr (Bpp == 8)
+					pixels[y * width + x] = palette32_ram[src[i]];
+				else
+					pixels[y * width + x] = palette32_ram[(src[i / 2] >> (i % 2 * 4)) & 0xf];
+			}
+		return pixels;
+	}
+
+	template<typename Pixel, typename Func>
+	std::vector<Pixel> convert(Func func, u32 width, u32 height)
+	{
+		PixelBuffer<Pixel> pb;
+		pb.init(width, height);
+		func(&pb, src.data(), width, height);
+		return std::vector<Pixel>(pb.data(), pb.data() + width * height);
+	}
+
+	std::vector<u8> src;
+	std::vector<u8> codebook;
+};
+
+TEST_F(TexConvTest, Twiddled)
+{
+	const u32 sizes[][2] { { 8, 8 }, { 16, 8 }, { 8, 64 }, { 128, 128 }, { 1024, 32 } };
+	for (const auto& [w, h] : sizes)
+	{
+		ASSERT_EQ(reference<Unpacker565_32<RGBAPacker>>(w, h, false), convert<u32>(opengl::tex565_TW32, w, h));
+		ASSERT_EQ(reference<Unpacker1555_32<RGBAPacker>>(w, h, false), convert<u32>(opengl::tex1555_TW32, w, h));
+		ASSERT_EQ(reference<Unpacker4444_32<RGBAPacker>>(w, h, false), convert<u32>(opengl::tex4444_TW32, w, h));
+		ASSERT_EQ(reference<Unpacker565_32<BGRAPacker>>(w, h, false), convert<u32>(directx::pvrTexInfo[Pixel565].TW32, w, h));
+		ASSERT_EQ(reference<Unpacker1555_32<BGRAPacker>>(w, h, false), convert<u32>(directx::pvrTexInfo[Pixel1555].TW32, w, h));
+		ASSERT_EQ(reference<Unpacker4444_32<BGRAPacker>>(w, h, false), convert<u32>(directx::pvrTexInfo[Pixel4444].TW32, w, h));
+		ASSERT_EQ(reference<Unpacker1555>(w, h, false), convert<u16>(opengl::pvrTexInfo[Pixel1555].TW, w, h));
+		ASSERT_EQ(reference<Unpacker4444>(w, h, false), convert<u16>(opengl::pvrTexInfo[Pixel4444].TW, w, h));
+		ASSERT_EQ(reference<UnpackerNop<u16>>(w, h, false), convert<u16>(opengl::pvrTexInfo[Pixel565].TW, w, h));
+		ASSERT_EQ((reference<UnpackerNop<u32>, 4>(w, h, false)), convert<u32>(opengl::pvrTexInfo[PixelPal4].TW32, w, h));
+		ASSERT_EQ((reference<UnpackerNop<u32>, 8>(w, h, false)), convert<u32>(opengl::pvrTexInfo[PixelPal8].TW32, w, h));
+	}
+}
+
+TEST_F(TexConvTest, VQ)
+{
+	for (u32 size = 8; size <= 256; size *= 2)
+	{
+		ASSERT_EQ(reference<Unpacker565_32<RGBAPacker>>(size, size, true), convert<u32>(opengl::tex565_VQ32, size, size));
+		ASSERT_EQ(reference<Unpacker1555_32<BGRAPacker>>(size, size, true), convert<u32>(directx::pvrTexInfo[Pixel1555].VQ32, size, size));
+		ASSERT_EQ(reference<Unpacker4444>(size, size, true), convert<u16>(opengl::pvrTexInfo[Pixel4444].VQ, size, size));
+	}
+}
+
+TEST_F(TexConvTest, Benchmark)
+{
+	SKIP_UNLESS_BENCHMARK();
+	using the_clock = std::chrono::high_resolution_clock;
+	constexpr u32 TEXELS = 4 * 1024 * 1024;
+	PixelBuffer<u16> pb16;
+	PixelBuffer<u32> pb32;
+	PixelBuffer<u8> pb8;
+	pb16.init(1024, 1024);
+	pb32.init(1024, 1024);
+	pb8.init(1024, 1024);
+
+	printf("%-8s %-9s %6s %6s %6s %6s %6s %6s %6s  (Mtexel/s)\n", "format", "size", "TW", "VQ", "PL32", "TW32", "VQ32", "PLVQ32", "TW8");
+	for (int fmt = 0; fmt < 7; fmt++)
+	{
+		const PvrTexInfo& info = opengl::pvrTexInfo[fmt];
+		for (u32 size = 8; size <= 1024; size *= 4)
+		{
+			const u32 iterations = TEXELS / (size * size);
+			auto bench = [&](auto func, auto& pb) {
+				if (func == nullptr)
+					return 0.0;
+				auto start = the_clock::now();
+				for (u32 i = 0; i < iterations; i++)
+					func(&pb, src.data(), size, size);
+				std::chrono::duration<double, std::micro> time = the_clock::now() - start;
+				return TEXELS / time.count();
+			};
+			printf("%-8s %4dx%-4d %6.0f %6.0f %6.0f %6.0f %6.0f %6.0f %6.0f\n", info.name, size, size,
+					bench(info.TW, pb16), bench(info.VQ, pb16), bench(info.PL32, pb32), bench(info.TW32, pb32),
+					bench(info.VQ32, pb32), bench(info.PLVQ32, pb32), bench(info.TW8, pb8));
+		}
+	}
+}